@@ -19,6 +19,9 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <functional>
+#include <memory>
+#include <cstdint>
 
 class Triwrap;
 struct triangulateio;
@@ -49,6 +52,45 @@ namespace tpp
       Sweepline
    };
 
+   enum VertexOrdering // OPEN TODO:: forward-decl.
+   {
+      InputOrder,    // the default!
+      Lexicographic, // on X, then on Y coord.
+      Hilbert        // along a Hilbert curve over the bounding box
+   };
+
+   enum SmoothingMethod // OPEN TODO:: forward-decl.
+   {
+      Laplacian,      // move to the centroid of the neighbouring vertices
+      OptimalDelaunay // ODT, move to the area-weighted mean of the triangles' circumcenters, the default!
+   };
+
+
+   /**
+      @brief: A read-only view of a contiguous array, like C++20's std::span<const T>
+
+      Doesn't own the elements, valid as long as the array it was taken from!
+    */
+   template <class T>
+   class ConstSpan
+   {
+   public:
+      ConstSpan() : m_data(nullptr), m_size(0) {}
+      ConstSpan(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+      const T* data() const { return m_data; }
+      size_t size() const { return m_size; }
+      bool empty() const { return m_size == 0; }
+
+      const T& operator[](size_t i) const { return m_data[i]; }
+      const T* begin() const { return m_data; }
+      const T* end() const { return m_data + m_size; }
+
+   private:
+      const T* m_data;
+      size_t m_size;
+   };
+
 
    /**
       @brief: The main Delaunay class that wraps original Triangle (aka TriLib) code by J.R. Shewchuk
@@ -68,6 +110,152 @@ namespace tpp
       typedef reviver::dpoint<double, 2> Point; // OPEN TODO:: decouple from this dependency!
       typedef reviver::dpoint<double, 4> Point4; // OPEN TODO:: decouple from this dependency!
 
+      /**
+         @brief: A background sizing field, i.e. target edge lengths at the nodes of a regular grid
+       */
+      struct SizingField
+      {
+         double originX = 0;   // position of the first (i.e. lower left) grid node
+         double originY = 0;
+         double cellSize = 0;  // distance between neighbouring grid nodes
+         int columns = 0;      // count of grid nodes in X direction
+         int rows = 0;         // count of grid nodes in Y direction
+         std::vector<double> edgeLengths; // target edge lengths, row by row: [row * columns + column]
+      };
+
+      /**
+         @brief: Limits for the refinement phase of quality triangulations
+       */
+      struct RefinementBudget
+      {
+         double maxSeconds = 0;     // wall-clock time limit for the refinement, 0 = none
+         int maxSteinerPoints = -1; // max. count of added Steiner points (TriLib's -S switch), -1 = none
+         int progressInterval = 0;  // call progress() every N added Steiner points, 0 = never
+         bool worstFirst = true;    // split the worst shaped (or most oversized) triangles first 
+
+         // progress callback, return false to cancel the refinement!
+         std::function<bool(int steinerPoints, int badTriangles)> progress;
+      };
+
+      /**
+         @brief: Results of smooth(), triangles counted by their smallest angle in bins of 5 each: 
+                 [0, 5), [5, 10), ... [55, 60]
+       */
+      struct SmoothingResult
+      {
+         int movedVertices = 0;  // count of vertex moves in all iterations
+         std::vector<int> minAngleHistogramBefore;
+         std::vector<int> minAngleHistogramAfter;
+      };
+
+      /**
+         @brief: Changes of the input made by resolveSegmentIntersections()
+       */
+      struct SegmentIntersectionReport
+      {
+         int crossingCount = 0;       // pairs of segments crossing in their interiors
+         int touchingCount = 0;       // segment endpoints lying in the interior of another segment
+         int splitSegmentCount = 0;   // input segments which were split
+         int removedSegmentCount = 0; // duplicate segments and overlapping parts of collinear segments
+         std::vector<int> addedPoints; // indexes of the crossing points appended to the input points
+      };
+
+      /**
+         @brief: Voronoi cells of all vertices of the mesh, as returned by voronoiCells()
+
+         The cell of vertex i is given by the entries offsets[i] to offsets[i + 1] - 1 of the vertices
+         and neighbors lists. Cells of vertices on the boundary of the mesh are unbounded and are closed 
+         by a vertex at infinity.
+       */
+      struct VoronoiCells
+      {
+         std::vector<int> offsets;    // vertexCount + 1 entries
+         std::vector<int> vertices;   // Voronoi vertices counterclockwise (indexes as with vvbegin()), -1 = at infinity
+         std::vector<int> neighbors;  // the vertex across the cell's edge from vertices[j] to the next one
+         std::vector<double> areas;   // infinity for unbounded cells, 0 for vertices not in the mesh
+
+         // only with a clip region, @see setVoronoiClipRegion(); then the areas are the ones of the clipped 
+         // cells, the corners of cell i are clippedPoints[clippedOffsets[i]] to [clippedOffsets[i + 1] - 1]
+         std::vector<int> clippedOffsets;
+         std::vector<Point> clippedPoints; // counterclockwise
+
+         int cellCount() const { return (int)areas.size(); }
+      };
+
+      /**
+         @brief: A Voronoi edge, as indexes of its Voronoi vertices (@see voronoiPoints())
+       */
+      struct VoronoiEdge
+      {
+         int start;
+         int end;   // -1 for an infinite ray, @see voronoiRays()
+      };
+
+      /**
+         @brief: The two vertices whose cells are separated by a Voronoi edge
+       */
+      struct VoronoiEdgeSites
+      {
+         int left;  // seen from the edge's start towards its end (or along the ray)
+         int right;
+      };
+
+      /**
+         @brief: Caller-provided buffers for exportMesh(), e.g. memory-mapped ones
+
+         Vertex i has the coordinates points[2 * i] and points[2 * i + 1], triangle j consists of the 
+         vertices triangles[3 * j] to triangles[3 * j + 2], counterclockwise. The markers and inputIndexes 
+         buffers are optional, i.e. can be null.
+       */
+      struct MeshBuffers
+      {
+         double* points = nullptr;        // 2 * vertexCapacity entries
+         int32_t* triangles = nullptr;    // 3 * triangleCapacity entries
+         int32_t* markers = nullptr;      // 1 for vertices on the mesh's boundary or on a segment, else 0
+         int32_t* inputIndexes = nullptr; // index of the input point, -1 for Steiner points
+         size_t vertexCapacity = 0;
+         size_t triangleCapacity = 0;
+
+         int vertexCount = 0;             // set by exportMesh()
+         int triangleCount = 0;
+      };
+
+      /**
+         @brief: Convergence measures of one iteration of lloyd()
+       */
+      struct LloydIteration
+      {
+         double energy = 0;    // sum of the second moments of the clipped cells about their points, before the move
+         double maxMove = 0;   // the largest distance a point was moved
+         double meanMove = 0;  // mean distance of all the points' moves
+         int flips = 0;        // edge flips restoring the Delaunay property
+         bool rebuilt = false; // the moves tangled the mesh, it was triangulated again
+      };
+
+      /**
+         @brief: Quality measures of the triangulation, as printed by TriLib with the -V switch
+       */
+      struct QualityStats
+      {
+         int triangleCount = 0;
+         double minAngle = 0;          // in degrees
+         double maxAngle = 0;
+         std::vector<int> angleHistogram; // all angles in bins of 10 each: [0, 10), ... [170, 180]
+         double shortestEdge = 0;
+         double longestEdge = 0;
+         double shortestAltitude = 0;
+         double maxAspectRatio = 0;    // longest edge divided by shortest altitude
+         std::vector<double> aspectRatioBounds; // upper bounds of the aspect ratio bins, the last bin is open
+         std::vector<int> aspectRatioHistogram;
+         double minArea = 0;
+         double maxArea = 0;
+
+         // triangles violating the quality constraints used by the last quality triangulation:
+         int smallAngleCount = 0;      // below the min. angle (incl. small input angles which cannot be fixed)
+         int largeAreaCount = 0;       // above the max. area, the region's max. area or the sizing field
+         int userTestFailedCount = 0;  // rejected by the user constraint
+      };
+
       /**
          @brief: constructor
 
@@ -127,6 +315,42 @@ namespace tpp
        */
       void TriangulateConf(DebugOutputLevel traceLvl) { TriangulateConf(false, traceLvl); }
 
+      /**
+        @brief: Refine the current triangulation with tighter quality constraints
+
+        Steiner points are inserted into the existing mesh until the new constraints are met, thus a chain
+        of levels of detail (coarse to fine) can be created without re-triangulating the input for each 
+        level. The constraints are also stored as with setQualityConstraints(). Looser constraints than 
+        the ones of the current mesh don't remove any vertices!
+        If there is no triangulation with segments yet (i.e. a Triangulate(false) of plain points), the 
+        input will be quality-triangulated from scratch.
+        The max. areas of the regions (see setRegionsConstraint()) are kept in the triangles by a quality
+        triangulation and are used by the refinement too, as set for that triangulation. If the current 
+        mesh wasn't quality-triangulated but there are regions with a max. area, the input will be 
+        quality-triangulated from scratch as well.
+
+        @param angle: min. resulting angle, if angle <= 0, the default of 20 will be used
+        @param area:  max. triangle area, if area <= 0, the constraint will be removed
+        @param traceLvl: enable traces
+        @note: a Voronoi diagram of the previous mesh is dropped, it will be rebuilt on next access
+       */
+      void refine(float angle, float area, DebugOutputLevel traceLvl = None);
+
+      /**
+        @brief: Improve the shape of the triangles by moving the Steiner points of the current mesh
+
+        The Steiner points in the interior are moved, input vertices and vertices on segments always stay 
+        in place. Vertices not adjacent to each other are moved concurrently (@see setThreadCount()). A 
+        move is done only if it doesn't decrease the smallest angle around the vertex and doesn't violate 
+        the area constraints, afterwards the mesh is made Delaunay again by edge flips.
+
+        @param iterations: count of smoothing passes over all vertices
+        @param method: where to move the vertices
+        @return: the count of moves and the min. angle histograms before and after smoothing
+        @note: a Voronoi diagram of the previous mesh is dropped, it will be rebuilt on next access
+       */
+      SmoothingResult smooth(int iterations = 3, SmoothingMethod method = OptimalDelaunay);
+
       /**
           @brief: Voronoi tesselate the input points
 
@@ -136,8 +360,70 @@ namespace tpp
 
           @param useConformingDelaunay: use conforming Delaunay triangulation as base for the Voronoi diagram
           @param traceLvl: enable traces
+          @note: the Voronoi diagram of an existing mesh can be also got without re-triangulating, @see vvbegin()
+          @note: with point weights it is a power diagram, @see setPointWeights()
         */
       void Tesselate(bool useConformingDelaunay = false, DebugOutputLevel traceLvl = None);
+
+      /**
+        @brief: Clip the Voronoi cells returned by voronoiCells() to a convex polygon
+
+        The cells are clipped in the same pass which collects them, unbounded cells are closed outside 
+        of the polygon before, thus all the clipped cells are finite, closed polygons. 
+
+        @param convexPolygon: corners of the clip polygon, in clockwise or counterclockwise order, collinear
+                              corners are allowed
+        @return: true if the input is valid, false if the polygon isn't convex (star polygons included), 
+                 has duplicate corners or edges folding back, or has less than 3 corners
+        @note: the Voronoi edges (@see vebegin()) aren't clipped
+       */
+      bool setVoronoiClipRegion(const std::vector<Point>& convexPolygon);
+      bool setVoronoiClipRegion(const Point& minCorner, const Point& maxCorner);
+
+      /**
+        @brief: Remove the clip region of the Voronoi cells
+       */
+      void removeVoronoiClipRegion();
+
+      /**
+        @brief: Set the weights of the input points for a regular (weighted Delaunay) triangulation
+
+        Tesselate() and Triangulate() without quality constraints then create the regular triangulation, 
+        i.e. the lower convex hull of the points lifted to x^2 + y^2 - weight, and the Voronoi diagram 
+        becomes the power diagram of the weighted points. A point whose lifted point lies above the 
+        lifted triangulation is redundant: like a duplicate it has no triangles and an empty Voronoi cell.
+
+        @param weights: one weight per input point, equal weights give the Delaunay triangulation
+        @return: true if the input is valid, false if the count doesn't match the point count
+        @note: as in TriLib, weights are ignored with segments, holes and quality constraints, and the 
+               Incremental algorithm is always used
+       */
+      bool setPointWeights(const std::vector<double>& weights);
+
+      /**
+        @brief: Remove the point weights, back to Delaunay triangulations
+       */
+      void removePointWeights();
+
+      /**
+        @brief: Move the input points towards a centroidal Voronoi tessellation (Lloyd's relaxation)
+
+        In each iteration every point is moved to the centroid of its Voronoi cell clipped to the bounds, 
+        the centroids are computed concurrently (@see setThreadCount()). The current triangulation is 
+        then repaired by edge flips, points whose moves would invert triangles are removed and inserted 
+        again. It's triangulated anew only if the repair fails, e.g. for points moved onto each other. 
+
+        @param iterations: max. count of iterations
+        @param bounds: a convex polygon, as for setVoronoiClipRegion()
+        @param tolerance: stop as soon as no point moved farther
+        @return: the convergence measures of each iteration done, empty on invalid input
+        @note: works on the Delaunay triangulation of the points, i.e. without segments, holes and point 
+               weights; a mesh with Steiner points is replaced by the triangulation of the input points 
+        @note: the points are changed, @see pointAtVertexId(); a Voronoi diagram of the previous mesh is 
+               dropped, it will be rebuilt on next access
+       */
+      std::vector<LloydIteration> lloyd(int iterations, const std::vector<Point>& bounds, double tolerance = 0);
+      std::vector<LloydIteration> lloyd(int iterations, const Point& minCorner, const Point& maxCorner, double tolerance = 0);
     
       /**
         @brief: Enable incremental numbering of vertices in the triangulation while iterating over faces
@@ -151,6 +437,57 @@ namespace tpp
        */
       void setAlgorithm(AlgorithmType alg);
 
+      /**
+        @brief: Change the layout of the vertex records in TriLib's memory pool
+
+        Vertices are copied into the pool in the given spatial order, so that mesh traversals, the merge 
+        step of D&C and the quality refinement touch mostly neighbouring memory. The vertex indexes 
+        reported by the iterators still refer to the input points.
+
+        @note: must be set before Triangulate() was called to take effect
+       */
+      void setVertexOrdering(VertexOrdering order);
+
+      /**
+        @brief: Set the number of threads used by the parallel parts of the triangulation
+
+        Currently the smoothing of the mesh and the search for segment constraints which are already edges of
+        the Delaunay triangulation run in parallel. Only that search is parallel in the segment insertion, 
+        the segments crossing edges are recovered serially, as is the insertion of Steiner points. The 
+        triangles don't depend on the thread count.
+
+        @param threads: 1 = single-threaded (the default), 0 = use all hardware threads
+        @note: a user test function (@see setUserConstraint()) must be thread-safe if threads != 1
+       */
+      void setThreadCount(int threads);
+
+      /**
+        @brief: Keep the Delaunay triangulation of the input points for the next triangulations
+
+        As long as the points, the algorithm and the vertex ordering don't change, further calls of
+        Triangulate(), TriangulateConf() and Tesselate() start from a copy of the cached triangulation and
+        only insert the segments, carve out the holes and refine it. Thus variants with different 
+        constraints can be created without sorting and triangulating the points again. The cache costs
+        a copy of the points plus six integers per triangle, and each triangulation compares the points
+        with the cached ones, thus it's worth it only if the same points are triangulated repeatedly.
+
+        @param enable: disabled by default, disabling it frees the cache
+       */
+      void enableBaseTriangulationCache(bool enable);
+
+      /**
+        @brief: Insert the segment constraints as a batch in spatial order
+
+        The segments are sorted by the position of their midpoints along a Hilbert curve, and the search 
+        for the endpoints of a segment starts at the triangle reached by the previous insertion instead of
+        at randomly sampled triangles. Speeds up large PSLGs whose segments aren't listed in a coherent
+        order. The constrained triangulation is the same, only the segments are stored in another order.
+
+        @param enable: disabled by default
+        @note: must be set before Triangulate() was called to take effect
+       */
+      void enableSegmentBatchInsertion(bool enable);
+
       //---------------------------------
       //  constraints API 
       //---------------------------------
@@ -183,7 +520,8 @@ namespace tpp
 
         @param segments: vector of 2 dimensional points where each consecutive pair of points describes
                          a single segment. Both endpoints of every segment are vertices of the input vector, 
-                         and a segment may intersect other segments and vertices only at its endpoints!
+                         and a segment may intersect other segments and vertices only at its endpoints
+                         (@see resolveSegmentIntersections())!
         @return: true if the input is valid, false otherwise 
        */
       bool setSegmentConstraint(const std::vector<Point>& segments);
@@ -193,6 +531,58 @@ namespace tpp
        */
      bool setSegmentConstraint(const std::vector<int>& segmentPointIndexes, DebugOutputLevel traceLvl = None);
 
+      /**
+        @brief: Add a polyline to the segment constraints
+
+        @param polyline: vertices of the polyline, each consecutive pair of points describes a segment. All 
+                         the points must be vertices of the input vector.
+        @return: true if the input is valid, false otherwise (the segments set before are kept then)
+        @note: the points are looked up in a hash index of the input points, built on first use
+       */
+      bool addPolyline(const std::vector<Point>& polyline);
+
+      /**
+        @brief: Add a closed polygon ring to the segment constraints
+
+        @param ring: vertices of the ring, the last one is connected to the first one, if they differ
+        @return: true if the input is valid, false otherwise (the segments set before are kept then)
+       */
+      bool addRing(const std::vector<Point>& ring);
+
+      /**
+        @brief: Merge duplicate input points, and points closer to each other than a tolerance
+
+        The points are visited in input order, each one is merged into the first kept point within the 
+        tolerance (if any). The list of points is compacted and the segment constraints are renumbered,
+        both in a single pass. Uses a hashed grid, i.e. runs in linear expected time. Segments whose both 
+        endpoints were merged degenerate to a point and are skipped in the triangulation.
+
+        @param tolerance: max. distance of merged points, 0 = exact duplicates only
+        @param traceLvl: enable traces
+        @return: the new index of each input point
+        @note: holes and regions are given by their coordinates, thus they aren't changed
+        @note: point weights (@see setPointWeights()) are compacted too, a merged point keeps the weight of 
+               the first kept point
+       */
+      std::vector<int> mergeDuplicatePoints(double tolerance = 0, DebugOutputLevel traceLvl = None);
+
+      /**
+        @brief: Split the segment constraints at their intersections
+
+        Finds all pairs of intersecting segments with a uniform grid, splits the segments at the crossing
+        points and at the endpoints of other segments lying on them, and removes the overlapping parts 
+        of collinear segments. The crossing points are appended to the input points. Thus TriLib needn't
+        resolve the intersections one by one while inserting the segments. 
+        The grid cells are as large as the median segment, segments much longer than that are walked 
+        along the occupied cells only.
+
+        @param traceLvl: enable traces
+        @return: the changes made
+        @note: call after setSegmentConstraint(), uses floating-point orientation tests
+        @note: with point weights (@see setPointWeights()) the crossing points get the weight 0
+       */
+      SegmentIntersectionReport resolveSegmentIntersections(DebugOutputLevel traceLvl = None);
+
      /**
        @brief: Use convex hull with constraining segments
 
@@ -210,6 +600,24 @@ namespace tpp
       */
      bool setHolesConstraint(const std::vector<Point>& holes);
 
+     /**
+       @brief: Add a hole given by the polygon ring bounding it
+
+       The ring's edges are added as constraints. After the segments were inserted TriLib removes all the
+       triangles enclosed by an odd number of hole rings in a single flood fill pass, thus no points inside 
+       of the holes are needed, and nested rings give islands. Can be combined with setHolesConstraint().
+
+       @param ring: vertices of the ring (at least 3), all of them must be vertices of the input vector
+       @return: true if the input is valid, false otherwise
+       @note: rings sharing an edge must share its endpoints, overlapping edges aren't counted as shared
+      */
+     bool addHoleRing(const std::vector<Point>& ring);
+
+     /**
+       @brief: Remove all hole rings
+      */
+     void clearHoleRings();
+
      /**
        @brief: Set region constraints for the triangulation
 
@@ -217,6 +625,8 @@ namespace tpp
                        triangles around in until it sees a segment
        @param areas:  max. triangle area for the region with the same index in the regions vector
        @return: true if the input is valid, false otherwise
+       @note: the areas are used in quality triangulations only, the triangles are labelled with their region
+              in all segment-constrained triangulations (@see FaceIterator::regionId())
       */
      bool setRegionsConstraint(const std::vector<Point>& regions, const std::vector<float>& areas);
 
@@ -226,10 +636,85 @@ namespace tpp
      bool setRegionsConstraint(const std::vector<Point4>& regionConstr); // OPEN TODO::: remove???
 
      /**
-        @brief:  Set a user test function for the triangulation
-                 OPEN TODO::: NYI!!!
+       @brief: Set a sizing field to constrain the triangle sizes in quality triangulations
+
+       The target edge length h is interpolated bilinearly at a triangle's centroid and the triangle 
+       is refined if its area exceeds the area of an equilateral triangle with edges h. Points outside
+       of the grid use the values at its border. Works in addition to the other area constraints.
+
+       @param field: grid of target edge lengths
+       @return: true if the input is valid, false otherwise
+      */
+     bool setSizingField(const SizingField& field);
+
+     /**
+       @brief: Set a sizing field given by a coarse background triangulation
+
+       The background points are Delaunay triangulated and the target edge lengths are interpolated
+       linearly inside its triangles, then sampled into a regular grid (@see above). Outside of the 
+       background triangulation the edge length of the nearest grid node inside is used (counted in grid 
+       steps), resp. of the nearest background point if the grid is coarser than the triangles.
+
+       @param points: points of the background triangulation
+       @param edgeLengths: target edge lengths at the background points
+       @param cellSize: distance of the grid nodes used for sampling
+       @return: true if the input is valid, false otherwise
+      */
+     bool setSizingField(const std::vector<Point>& points, const std::vector<double>& edgeLengths, double cellSize);
+
+     /**
+       @brief: Remove the sizing field
+      */
+     void removeSizingField();
+
+     /**
+       @brief: Limit the time and the Steiner points spent in the refinement of quality triangulations
+
+       The refinement stops between two Steiner point insertions, thus the result is always a valid mesh, 
+       but it may still contain bad triangles (@see refinementCompleted()). With worstFirst set, the 
+       triangles with the smallest angles (or the largest area excess) are split first, otherwise TriLib 
+       splits the triangles with the shortest edges first.
+
+       @param budget: the limits and an optional progress callback
+      */
+     void setRefinementBudget(const RefinementBudget& budget);
+
+     /**
+       @brief: Remove the refinement budget
+      */
+     void removeRefinementBudget();
+
+     /**
+        @brief:  Set a user test function for the quality triangulation
+
+        The test is called for each triangle with its origin, destination, apex and area, and returns true 
+        if the triangle must be refined (i.e. it's "unsuitable"). It's used in addition to the angle and area
+        constraints, but only in quality triangulations! Example:
+
+          d.setUserConstraint([&](const Point& org, const Point& dest, const Point& apex, double area) 
+                              { return area > maxAreaAt(org, dest, apex); });
+
+        The test is inlined into a single function called directly by TriLib, thus no further indirections
+        are added to the quality test of a triangle.
+
+        @param test: a function object or function pointer, bool(const Point&, const Point&, const Point&, double)
+        @note: must be thread-safe if more than one thread is used, @see setThreadCount()
+      */
+     template <class UserTest>
+     void setUserConstraint(UserTest test)
+     {
+        setUserTest(&callUserTest<UserTest>, std::make_shared<UserTest>(std::move(test)));
+     }
+
+     /**
+        @brief:  Same as above, for a std::function (with the additional overhead of std::function!)
       */
-     void setUserConstraint(bool (*f)()) { /* NYI !!!!! */ }
+     void setUserConstraint(const std::function<bool(const Point&, const Point&, const Point&, double)>& test);
+
+     /**
+        @brief:  Remove the user test function
+      */
+     void removeUserConstraint();
 
       /**
         @brief: Are the quality constraints acceptable?
@@ -264,6 +749,19 @@ namespace tpp
        */
       bool hasTriangulation() const;
 
+      /**
+        @brief: Were all quality constraints met, i.e. the refinement not stopped early?
+       */
+      bool refinementCompleted() const;
+
+      /**
+        @brief: Measure the quality of the triangulation in one (parallel) pass over the triangles
+
+        @note: uses the thread count set with setThreadCount(). With a user constraint the violations are
+               counted using the user test, which thus must be thread-safe if threads != 1
+       */
+      QualityStats qualityStats() const;
+
       /**
         @brief: Triangulation results, counts of entities:
        */
@@ -289,20 +787,84 @@ namespace tpp
       FacesList faces();
       VertexList vertices();
 
+      /**
+        @brief: Call func() for each face resp. vertex, concurrently
+
+        Each worker thread gets a contiguous range of TriLib's memory blocks, thus of the faces resp. 
+        vertices in iteration order. The iterators passed to func() point to a single element only, they 
+        cannot be incremented.
+
+        @param func: called with the face resp. vertex and the number of the worker (0 to threads - 1), 
+                     e.g. for per-thread results
+        @param threads: count of worker threads, 0 = use all hardware threads
+        @note: func() must be thread-safe, and must not change the mesh. Mesh indexes (@see FaceIterator::Org()) 
+               are assigned on first access, i.e. must not be used here!
+       */
+      void parallelForEachFace(const std::function<void(const FaceIterator& face, int worker)>& func, int threads = 0);
+      void parallelForEachVertex(const std::function<void(const VertexIterator& vertex, int worker)>& func, int threads = 0);
+
+      /**
+        @brief: Write the mesh into flat arrays, without going through the iterators
+
+        The vertices are numbered as with VertexIterator::vertexId(), i.e. the input points keep their 
+        indexes and the Steiner points follow them. Vertices and triangles are written concurrently 
+        (@see setThreadCount()), directly from TriLib's memory.
+
+        @param buffers: the buffers must have room for verticeCount() vertices and triangleCount() triangles
+        @return: false if there's no triangulation or the buffers are too small
+       */
+      bool exportMesh(MeshBuffers& buffers);
+
       /**
         @brief: Tesselation results, counts of entities:
+
+        @note: are valid also before the Voronoi diagram was built, as it's always the dual of the mesh
        */
       int voronoiPointCount() const;
       int voronoiEdgeCount() const;
 
       /**
         @brief: Iterate over Voronoi vertices and edges
+
+        On first access after a Triangulate(), refine() or smooth(), the Voronoi diagram is built from 
+        the current mesh (the circumcenters of the triangles and the dual edges), without re-triangulating 
+        the input. The triangles are processed concurrently (@see setThreadCount()). With segments or holes
+        this is the dual of the constrained triangulation, i.e. not a true Voronoi diagram!
+        Without a triangulation the begin iterators are equal to the end iterators.
        */
       VoronoiVertexIterator vvbegin();
       VoronoiVertexIterator vvend();
       VoronoiEdgeIterator vebegin();
       VoronoiEdgeIterator veend();
 
+      /**
+        @brief: Access the Voronoi diagram as contiguous arrays, e.g. for vectorized processing
+
+        The Voronoi diagram is built if needed, as with vvbegin(). Element i of the spans is the i-th 
+        Voronoi vertex resp. edge of the iterators, the ray directions and sites are given per edge.
+
+        @return: empty spans without a triangulation
+        @note: the spans are valid until the mesh is changed, e.g. by Triangulate() or smooth()
+        @note: the sites are the indexes of the vertices (input points, then Steiner points)
+       */
+      ConstSpan<Point> voronoiPoints();
+      ConstSpan<VoronoiEdge> voronoiEdges();
+      ConstSpan<Point> voronoiRays();               // the outward normal of the hull edge for rays, else (0, 0)
+      ConstSpan<VoronoiEdgeSites> voronoiEdgeSites();
+
+      /**
+        @brief: Get the Voronoi cell of each vertex as a polygon, with its area and neighbor vertices
+
+        The cells are the duals of the triangles around each vertex, they are collected concurrently 
+        (@see setThreadCount()) from the current mesh, the Voronoi diagram itself isn't needed. 
+        Vertex i is the i-th input point, Steiner points follow the input points.
+
+        @return: the cells in CSR form, empty without a triangulation
+        @note: with segments or holes these are cells of the dual of the constrained triangulation, the 
+               cells of vertices on segments or hole boundaries aren't true Voronoi cells!
+       */
+      VoronoiCells voronoiCells();
+
       /**
         @brief: Get a class for operations on oriented triangles (faces)
        */
@@ -382,12 +944,43 @@ namespace tpp
          bool operator() (const Point& lhs, const Point& rhs) const;
       };
 
+   private:
+      typedef int (*UserTestCall)(double* org, double* dest, double* apex, double area, void* userTest);
+
+      template <class UserTest>
+      static int callUserTest(double* org, double* dest, double* apex, double area, void* userTest)
+      {
+         const UserTest& test = *static_cast<const UserTest*>(userTest);
+         return test(Point(org[0], org[1]), Point(dest[0], dest[1]), Point(apex[0], apex[1]), area) ? 1 : 0;
+      }
+
+      void setUserTest(UserTestCall call, std::shared_ptr<void> userTest);
+      void enforceQualityConstraints();
+
+      // the unconstrained Delaunay triangulation of the input points, in TriLib's pool order
+      struct BaseTriangulation
+      {
+         std::vector<Point> points;
+         std::vector<double> weights;    // only if regular
+         AlgorithmType algorithm;
+         VertexOrdering ordering;
+         std::vector<int> corners;       // org, dest, apex of each triangle
+         std::vector<int> neighbors;     // oriented neighbor triangles (3 * triangle + orient), -1 on hull
+         std::vector<int> undeadVertices; // duplicates, not present in the mesh
+         int hullStart;
+         long hullSize;
+      };
+
+      long triangulateInputPoints();
+
    private:
       void invokeTriLib(std::string& triswitches);
       void setQualityOptions(std::string& options, bool quality);
       void setDebugLevelOption(std::string& options, DebugOutputLevel traceLvl);
-      void sanitizeInputData(std::unordered_map<int, int> duplicatePointsMap, DebugOutputLevel traceLvl = None);
+      void applyPointRemap(const std::vector<int>& pointRemap, DebugOutputLevel traceLvl = None);
       void freeTriangleDataStructs();
+      bool buildVoronoi();
+      void freeVoronoi();
       void initTriangleDataForPoints();
       void initTriangleInputData(triangulateio* pin, const std::vector<Point>& points);
       void readPointsFromMesh(std::vector<Point>& points) const;
@@ -396,8 +989,16 @@ namespace tpp
 
       bool readSegmentsFromFile(char* polyfileName, FILE* polyfile, std::vector<int>& segmentEndpoints);
       void readHolesFromFile(char* polyfileName, FILE* polyfile, std::vector<Point>& holeMarkers, std::vector<Point4>& regionConstr) const;
-      std::unordered_map<int, int> checkForDuplicatePoints() const;   
+      int findDuplicatePoints(double tolerance, std::vector<int>& pointRemap) const;
+      bool appendPolyline(const std::vector<Point>& polyline, bool closed, std::vector<int>& segments);
+      int findPointIndex(const Point& pt);
+      size_t findPointSlot(const Point& pt) const;
+      void updatePointIndex();
+      void invalidatePointIndex() { m_indexedPointCount = 0; }
       int GetFirstIndexNumber() const;
+      void computeVertexPermutation();
+      std::vector<int> skeletonSegments(std::vector<int>& segmentMarkers) const;
+      void remapInputVertexMarks();
 
       friend class VertexIterator;
       friend class FaceIterator;
@@ -413,18 +1014,42 @@ namespace tpp
       void* m_pbehavior;      
       void* m_vorout;  // pointer to TriLib's Voronoi output
 
+      std::vector<Point> m_voronoiPoints; // the Voronoi output, converted from TriLib's lists
+      std::vector<VoronoiEdge> m_voronoiEdges;
+      std::vector<Point> m_voronoiRays;
+      std::vector<VoronoiEdgeSites> m_voronoiEdgeSites;
+
       AlgorithmType m_triAlgorithm;
+      VertexOrdering m_vertexOrdering;
+      int m_threadCount;
+      UserTestCall m_userTestCall;
+      std::shared_ptr<void> m_userTest;
+      SizingField m_sizingField;
+      std::vector<double> m_sizingFieldAreas; // max. triangle areas at the grid nodes
+      RefinementBudget m_refinementBudget;
+      bool m_hasRefinementBudget;
+      BaseTriangulation m_baseTriangulation;
+      bool m_cacheBaseTriangulation;
+      bool m_segmentBatchInsertion;
       float m_minAngle;
       float m_maxArea;
       bool m_convexHullWithSegments;   
       bool m_extraVertexAttr;
+      bool m_weightedMesh;  // a regular triangulation, the point weights are TriLib's first vertex attribute
       bool m_triangulated;
 
       std::vector<Point> m_pointList;
       std::vector<int> m_segmentList;
       std::vector<Point> m_holesList;
+      std::vector<int> m_holeRingSegments; // endpoint indexes of the hole rings' edges
       std::vector<double> m_defaultExtraAttrs;
       std::vector<Point4> m_regionsConstrList;
+      std::vector<double> m_regionLabelList; // regions as passed to TriLib, @see FaceIterator::regionId()
+      std::vector<double> m_voronoiClipRegion; // x, y of the corners, counterclockwise
+      std::vector<double> m_pointWeights;
+      std::vector<int> m_vertexPermutation; // pool position -> input point index
+      std::vector<int> m_pointIndex;   // hashed coordinates -> first input point index, -1 = free slot
+      size_t m_indexedPointCount;
    }; 
 
 }
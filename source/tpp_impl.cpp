@@ -43,31 +43,20 @@
 
 // 2. the wrapper itself (TrianglePP)
 #include "tpp_interface.hpp"
+#include "tpp_parallel.hpp"
 
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <chrono>
 
 // helper macros
 #include "tpp_triangle_macros.hpp"
 
 
-// custom specialization of std::hash for Delaunay::Points
-namespace std 
-{
-    template <>
-    struct hash<tpp::Delaunay::Point>
-    {
-        std::size_t operator()(const tpp::Delaunay::Point& p) const
-        {
-            std::size_t h1 = std::hash<double>{}(p[0]);
-            std::size_t h2 = std::hash<double>{}(p[1]);
-            return h1 ^ (h2 << 1); // combine hashes
-        }
-    };
-}
-
-
 namespace tpp {
 
    // trace support
@@ -77,6 +66,113 @@ namespace tpp {
    // impl. constant
    const char* c_trppFileComment =  "\n# Generated by Triangle++" ;
 
+   // impl. helpers
+   namespace 
+   {
+      // position of (x, y) along a Hilbert curve on a 2^16 x 2^16 grid (@see Wikipedia: "Hilbert curve")
+      uint64_t hilbertKey(double x, double y, double minX, double minY, double extent)
+      {
+         const uint32_t gridSize = 1u << 16;
+         const double scale = (extent > 0) ? (gridSize - 1) / extent : 0.0;
+
+         uint32_t hx = (uint32_t)((x - minX) * scale);
+         uint32_t hy = (uint32_t)((y - minY) * scale);
+         uint64_t key = 0;
+
+         for (uint32_t s = gridSize / 2; s > 0; s /= 2)
+         {
+            uint32_t rx = (hx & s) > 0;
+            uint32_t ry = (hy & s) > 0;
+            key += (uint64_t)s * s * ((3 * rx) ^ ry);
+
+            // rotate the quadrant
+            if (ry == 0)
+            {
+               if (rx == 1)
+               {
+                  hx = gridSize - 1 - hx;
+                  hy = gridSize - 1 - hy;
+               }
+               std::swap(hx, hy);
+            }
+         }
+
+         return key;
+      }
+
+      // scrambles the bits of a hash key (the finalizer of the SplitMix64 generator)
+      uint64_t mixBits(uint64_t x)
+      {
+         x ^= x >> 30;
+         x *= 0xbf58476d1ce4e5b9ull;
+         x ^= x >> 27;
+         x *= 0x94d049bb133111ebull;
+         x ^= x >> 31;
+         return x;
+      }
+
+      // bit pattern of a coordinate for exact hashing, no negative zero
+      uint64_t coordinateBits(double coord)
+      {
+         coord += 0.0;
+         uint64_t bits;
+         memcpy(&bits, &coord, sizeof(coord));
+         return bits;
+      }
+
+      // marker of the hole rings' segments in TriLib, @see infectholerings()
+      const int HoleRingMarker = -1;
+
+      // lower left corner and side length of the square enclosing all points, for hilbertKey()
+      void boundingSquare(const std::vector<Delaunay::Point>& points, double& minX, double& minY, double& extent)
+      {
+         double maxX = points[0][0], maxY = points[0][1];
+         minX = maxX;
+         minY = maxY;
+
+         for (const auto& pt : points)
+         {
+            minX = std::min(minX, pt[0]);
+            minY = std::min(minY, pt[1]);
+            maxX = std::max(maxX, pt[0]);
+            maxY = std::max(maxY, pt[1]);
+         }
+
+         extent = std::max(maxX - minX, maxY - minY);
+      }
+
+      // TriLib's callback for checking the refinement budget
+      struct RefinementBudgetCheck
+      {
+         const Delaunay::RefinementBudget* budget;
+         std::chrono::steady_clock::time_point deadline;
+         long nextProgress;
+
+         static int check(long steinerPoints, long badTriangles, void* context)
+         {
+            RefinementBudgetCheck* self = static_cast<RefinementBudgetCheck*>(context);
+            const Delaunay::RefinementBudget& budget = *self->budget;
+
+            if (budget.maxSeconds > 0 && std::chrono::steady_clock::now() >= self->deadline)
+            {
+               return 0;
+            }
+
+            if (budget.progressInterval > 0 && budget.progress && steinerPoints >= self->nextProgress)
+            {
+               self->nextProgress = steinerPoints + budget.progressInterval;
+
+               if (!budget.progress((int)steinerPoints, (int)badTriangles))
+               {
+                  return 0; // cancelled
+               }
+            }
+
+            return 1;
+         }
+      };
+   }
+
 
 // public methods
 
@@ -87,11 +183,19 @@ Delaunay::Delaunay(const std::vector<Point>& points, bool enableMeshIndexing)
      m_pbehavior(nullptr),
      m_vorout(nullptr),
      m_triAlgorithm(DivideConquer),
+     m_vertexOrdering(InputOrder),
+     m_threadCount(1),
+     m_userTestCall(nullptr),
+     m_hasRefinementBudget(false),
+     m_cacheBaseTriangulation(false),
+     m_segmentBatchInsertion(false),
      m_minAngle(0.0f),
      m_maxArea(0.0f),
      m_convexHullWithSegments(false),
      m_extraVertexAttr(enableMeshIndexing),
-     m_triangulated(false)
+     m_weightedMesh(false),
+     m_triangulated(false),
+     m_indexedPointCount(0)
 {
    m_pointList.assign(points.begin(), points.end());
 }
@@ -126,6 +230,110 @@ void Delaunay::TriangulateConf(bool quality, DebugOutputLevel traceLvl)
 }
 
 
+void Delaunay::refine(float angle, float area, DebugOutputLevel traceLvl)
+{
+   setQualityConstraints(angle, area);
+
+   TP_MESH_BEHAVIOR_WRAP();
+
+   if (!m_triangulated || !tpbehavior->usesegments || tpmesh->triangles.items == 0)
+   {
+      // nothing to refine, TriLib needs the subsegments for the encroachment checks!
+      Triangulate(true, traceLvl);
+      return;
+   }
+
+   bool regionAreas = std::any_of(m_regionsConstrList.begin(), m_regionsConstrList.end(), 
+                                  [](const Point4& r) { return r[3] > 0; });
+   if (regionAreas && !tpbehavior->vararea)
+   {
+      // no area bounds stored in the triangles, the regions must be spread once more!
+      Triangulate(true, traceLvl);
+      return;
+   }
+
+   INIT_TRACE("triangle.out.txt");
+   TRACE("refine ->");
+
+   // the Voronoi diagram will be rebuilt from the refined mesh on next access
+   freeVoronoi();
+
+   // the pools of the last quality run were sized for its switches 
+   pTriangleWrap->qualitydeinit(tpmesh, tpbehavior);
+
+   tpbehavior->quality = 1;
+   tpbehavior->minangle = m_minAngle > 0 ? m_minAngle : 20.0; // as with the -q switch
+   pTriangleWrap->qualityconstants(tpbehavior);
+
+   tpbehavior->fixedarea = m_maxArea > 0 ? 1 : 0;
+   tpbehavior->maxarea = m_maxArea > 0 ? m_maxArea : -1.0;
+
+   tpbehavior->usertest = m_userTestCall ? 1 : 0;
+   tpbehavior->usertestfunc = m_userTestCall;
+   tpbehavior->usertestcontext = m_userTest.get();
+
+   tpbehavior->sizingfield.areas = nullptr;
+   if (!m_sizingFieldAreas.empty())
+   {
+      tpbehavior->sizingfield.xmin = m_sizingField.originX;
+      tpbehavior->sizingfield.ymin = m_sizingField.originY;
+      tpbehavior->sizingfield.cellsize = m_sizingField.cellSize;
+      tpbehavior->sizingfield.columns = m_sizingField.columns;
+      tpbehavior->sizingfield.rows = m_sizingField.rows;
+      tpbehavior->sizingfield.areas = m_sizingFieldAreas.data();
+   }
+
+   tpbehavior->threads = resolveThreadCount(m_threadCount);
+   tpbehavior->quiet = (traceLvl == None) ? 1 : 0;
+   tpbehavior->verbose = (traceLvl == Info) ? 1 : (traceLvl == Vertex) ? 2 : (traceLvl == Debug) ? 4 : 0;
+
+   tpbehavior->steiner = (m_hasRefinementBudget && m_refinementBudget.maxSteinerPoints >= 0) ? 
+                            m_refinementBudget.maxSteinerPoints : -1;
+   tpmesh->steinerleft = tpbehavior->steiner;
+   tpmesh->refinementstopped = 0;
+
+   enforceQualityConstraints();
+
+   tpmesh->edges = (3l * tpmesh->triangles.items + tpmesh->hullsize) / 2l;
+
+   pTriangleWrap->numbernodes(tpmesh, tpbehavior);
+   // the input vertices are still in the first slots of the vertex pool, only Steiner points were added
+   remapInputVertexMarks();
+
+   TRACE2i("<- refine: triangles= ", tpmesh->triangles.items);
+   END_TRACE("triangle.out.txt");
+}
+
+
+Delaunay::SmoothingResult Delaunay::smooth(int iterations, SmoothingMethod method)
+{
+   SmoothingResult result;
+
+   if (!m_triangulated)
+   {
+      return result;
+   }
+
+   TP_MESH_BEHAVIOR_WRAP();
+   tpbehavior->threads = resolveThreadCount(m_threadCount);
+
+   freeVoronoi(); // circumcenters will move
+
+   const int binCount = 12; // i.e. 5 degrees wide
+   std::vector<long> bins(binCount);
+
+   pTriangleWrap->minanglehistogram(tpmesh, tpbehavior, bins.data(), binCount);
+   result.minAngleHistogramBefore.assign(bins.begin(), bins.end());
+
+   result.movedVertices = (int)pTriangleWrap->smoothmesh(tpmesh, tpbehavior, iterations, method == OptimalDelaunay);
+
+   pTriangleWrap->minanglehistogram(tpmesh, tpbehavior, bins.data(), binCount);
+   result.minAngleHistogramAfter.assign(bins.begin(), bins.end());
+
+   return result;
+}
+
+
 void Delaunay::Tesselate(bool useConformingDelaunay, DebugOutputLevel traceLvl) 
 {
    std::string options = "nz";  // n: need neighbors, z: index from 0
@@ -147,37 +355,224 @@ void Delaunay::Tesselate(bool useConformingDelaunay, DebugOutputLevel traceLvl)
    invokeTriLib(options);
 
    // now use the triangulation for a Voronoi diagram
-   TP_MESH_BEHAVIOR_WRAP();
+   buildVoronoi();
+}
 
-   // OPEN TODO::: check those preconditions??
-   if (tpmesh->holes != 0)
+
+bool Delaunay::setVoronoiClipRegion(const std::vector<Point>& convexPolygon)
+{
+   if (convexPolygon.size() < 3)
    {
-       /* ............ */
+      std::cerr << "ERROR: Voronoi clip region needs at least 3 corners!\n";
+      return false;
    }
 
-   m_vorout = new triangulateio;
-   TP_VOROUT();
+   // all turns must have the same sense and add up to a single full turn (i.e. no star polygons), 
+   // no edge may be of zero length or fold back onto the previous one
+   size_t n = convexPolygon.size();
+   double orientation = 0;
+   double totalTurn = 0;
 
-   tpvorout->numberofpoints = tpmesh->triangles.items;
-   tpvorout->numberofpointattributes = tpmesh->nextras;
-   tpvorout->numberofedges = tpmesh->edges;
+   for (size_t i = 0; i < n; ++i)
+   {
+      const Point& a = convexPolygon[i];
+      const Point& b = convexPolygon[(i + 1) % n];
+      const Point& c = convexPolygon[(i + 2) % n];
+      double turn = (b[0] - a[0]) * (c[1] - b[1]) - (b[1] - a[1]) * (c[0] - b[0]);
+      double ahead = (b[0] - a[0]) * (c[0] - b[0]) + (b[1] - a[1]) * (c[1] - b[1]);
 
-   tpvorout->pointlist = nullptr;
-   tpvorout->pointattributelist = nullptr;
-   tpvorout->pointmarkerlist = nullptr;
-   tpvorout->numberofsegments = 0;
-   tpvorout->numberofholes = 0;
-   tpvorout->numberofregions = 0;
-   tpvorout->regionlist = nullptr;
-   tpvorout->edgelist = nullptr;
-   tpvorout->edgemarkerlist = nullptr;
-   tpvorout->normlist = nullptr;
+      if ((a[0] == b[0] && a[1] == b[1]) || (turn == 0 && ahead <= 0))
+      {
+         std::cerr << "ERROR: Voronoi clip region is degenerated!\n";
+         return false;
+      }
+      if (turn * orientation < 0)
+      {
+         std::cerr << "ERROR: Voronoi clip region isn't convex!\n";
+         return false;
+      }
+      if (turn != 0)
+      {
+         orientation = turn;
+      }
+
+      totalTurn += std::atan2(turn, ahead);
+   }
+
+   if (orientation == 0)
+   {
+      std::cerr << "ERROR: Voronoi clip region is degenerated!\n";
+      return false;
+   }
+
+   if (std::abs(std::abs(totalTurn) - 2 * std::acos(-1.0)) > 1e-6)
+   {
+      std::cerr << "ERROR: Voronoi clip region isn't convex!\n";
+      return false;
+   }
+
+   m_voronoiClipRegion.clear();
+   m_voronoiClipRegion.reserve(2 * n);
+
+   for (size_t i = 0; i < n; ++i)
+   {
+      const Point& corner = convexPolygon[orientation > 0 ? i : n - 1 - i];
+      m_voronoiClipRegion.push_back(corner[0]);
+      m_voronoiClipRegion.push_back(corner[1]);
+   }
+
+   return true;
+}
+
+
+bool Delaunay::setVoronoiClipRegion(const Point& minCorner, const Point& maxCorner)
+{
+   return setVoronoiClipRegion({ minCorner, Point(maxCorner[0], minCorner[1]), maxCorner, Point(minCorner[0], maxCorner[1]) });
+}
+
+
+void Delaunay::removeVoronoiClipRegion()
+{
+   m_voronoiClipRegion.clear();
+}
+
+
+bool Delaunay::setPointWeights(const std::vector<double>& weights)
+{
+   if (weights.size() != m_pointList.size())
+   {
+      std::cerr << "ERROR: the count of point weights doesn't match the count of points!\n";
+      return false;
+   }
+
+   m_pointWeights = weights;
+   return true;
+}
+
+
+void Delaunay::removePointWeights()
+{
+   m_pointWeights.clear();
+}
+
+
+std::vector<Delaunay::LloydIteration> Delaunay::lloyd(int iterations, const std::vector<Point>& bounds, double tolerance)
+{
+   std::vector<LloydIteration> stats;
+
+   if (!m_segmentList.empty() || !m_holesList.empty() || !m_holeRingSegments.empty() || !m_pointWeights.empty())
+   {
+      std::cerr << "ERROR: Lloyd's relaxation needs points without segments, holes and weights!\n";
+      return stats;
+   }
+
+   // the cells are clipped to the bounds, the user's clip region is kept
+   std::vector<double> clipRegion = m_voronoiClipRegion;
+
+   if (!setVoronoiClipRegion(bounds))
+   {
+      return stats;
+   }
+
+   auto triangulatesInputPoints = [this]()
+   {
+      TP_MESH_BEHAVIOR();
+      return m_triangulated && !tpbehavior->usesegments && tpmesh->vertices.items == (long)m_pointList.size();
+   };
+
+   if (!triangulatesInputPoints())
+   {
+      Triangulate();
+   }
+
+   int threadCount = resolveThreadCount(m_threadCount);
+
+   for (int iteration = 0; iteration < iterations && m_triangulated; ++iteration)
+   {
+      // 1. centroids of the clipped cells, computed in parallel; the cells are indexed like the input points
+      TP_MESH_BEHAVIOR_WRAP();
+      tpbehavior->threads = threadCount;
+
+      long cellCount = (long)m_pointList.size();
+      std::vector<double> newCoords(2 * cellCount);
+      std::vector<double> moments(cellCount);
+
+      for (long cell = 0; cell < cellCount; ++cell)
+      {
+         newCoords[2 * cell] = m_pointList[cell][0]; // stays if the cell is empty (outside of the bounds, a duplicate)
+         newCoords[2 * cell + 1] = m_pointList[cell][1];
+      }
+
+      pTriangleWrap->buildcellcentroids(tpmesh, tpbehavior, m_voronoiClipRegion.data(), (int)m_voronoiClipRegion.size() / 2, 
+                                        newCoords.data(), moments.data());
+      LloydIteration stat;
+
+      for (long cell = 0; cell < cellCount; ++cell)
+      {
+         double move = std::hypot(newCoords[2 * cell] - m_pointList[cell][0], newCoords[2 * cell + 1] - m_pointList[cell][1]);
+
+         stat.energy += moments[cell];
+         stat.maxMove = std::max(stat.maxMove, move);
+         stat.meanMove += move / cellCount;
+
+         m_pointList[cell] = Point(newCoords[2 * cell], newCoords[2 * cell + 1]);
+      }
+
+      // 2. move the mesh vertices and repair the triangulation
+      freeVoronoi();
+      invalidatePointIndex();
+
+      long flips = pTriangleWrap->relocatevertices(tpmesh, tpbehavior, newCoords.data());
+
+      if (flips < 0)
+      {
+         Triangulate();
+         stat.rebuilt = true;
+      }
+      else
+      {
+         // the hull repair may have changed the hull size, thus the edge count
+         tpmesh->edges = (3l * tpmesh->triangles.items + tpmesh->hullsize) / 2l;
+         stat.flips = (int)flips;
+      }
+
+      stats.push_back(stat);
+
+      if (stat.maxMove <= tolerance)
+      {
+         break;
+      }
+   }
+
+   m_voronoiClipRegion.swap(clipRegion);
+   return stats;
+}
+
+
+std::vector<Delaunay::LloydIteration> Delaunay::lloyd(int iterations, const Point& minCorner, const Point& maxCorner, double tolerance)
+{
+   return lloyd(iterations, { minCorner, Point(maxCorner[0], minCorner[1]), maxCorner, Point(minCorner[0], maxCorner[1]) }, 
+                tolerance);
+}
 
-   pTriangleWrap->writevoronoi(
-         tpmesh, tpbehavior,
-         &tpvorout->pointlist, &tpvorout->pointattributelist,
-         &tpvorout->pointmarkerlist, &tpvorout->edgelist,
-         &tpvorout->edgemarkerlist, &tpvorout->normlist);
+
+void Delaunay::setUserConstraint(const std::function<bool(const Point&, const Point&, const Point&, double)>& test)
+{
+   typedef std::function<bool(const Point&, const Point&, const Point&, double)> UserTestFunction;
+
+   if (!test)
+   {
+      removeUserConstraint();
+      return;
+   }
+
+   setUserTest(&callUserTest<UserTestFunction>, std::make_shared<UserTestFunction>(test));
+}
+
+
+void Delaunay::removeUserConstraint()
+{
+   setUserTest(nullptr, nullptr);
 }
 
 
@@ -239,23 +634,21 @@ bool Delaunay::setSegmentConstraint(const std::vector<Point>& segments)
    m_segmentList.clear();
    m_segmentList.reserve(segments.size());
 
-   // OPEN TODO::: optimize - unquadrat it...
    for (size_t i = 0; i < segments.size(); ++i)
    {
-      const std::vector<Point>::iterator it = std::find(m_pointList.begin(), m_pointList.end(), segments[i]);
-      if (it == m_pointList.end())
+      int pointIdx = findPointIndex(segments[i]);
+      if (pointIdx < 0)
       {
          m_segmentList.clear();
          return false;
       }
       else
       {
-         m_segmentList.push_back(std::distance(m_pointList.begin(), it));  // OPEN TODO:: warning !!!
+         m_segmentList.push_back(pointIdx);
       }
    }
 
-   // OPEN TODO::: check for intersections ???
-   //  - seems to be not needed, re-read what the documentiation of TriLibrary says!!!!
+   // intersections: TriLib splits the segments while inserting them, @see resolveSegmentIntersections()
 
    return true;
 }
@@ -281,87 +674,923 @@ bool Delaunay::setSegmentConstraint(const std::vector<int>& segmentPointIndexes,
       }
    }
 
-   // OPEN TODO::: check for intersections ???
-   //  - seems to be not needed (???), re-read what the documentiation of TriLibrary says!!!!
+   // intersections: TriLib splits the segments while inserting them, @see resolveSegmentIntersections()
 
    // sanitize inputs
-   std::unordered_map<int, int> duplicates = checkForDuplicatePoints();
+   mergeDuplicatePoints(0, traceLvl);
+
+   return true;
+}
+
+
+bool Delaunay::addPolyline(const std::vector<Point>& polyline)
+{
+   return appendPolyline(polyline, false, m_segmentList);
+}
+
+
+bool Delaunay::addRing(const std::vector<Point>& ring)
+{
+   return appendPolyline(ring, true, m_segmentList);
+}
+
+
+std::vector<int> Delaunay::mergeDuplicatePoints(double tolerance, DebugOutputLevel traceLvl)
+{
+   Assert(tolerance >= 0, "tolerance cannot be negative");
+
+   std::vector<int> pointRemap;
+   int duplicates = findDuplicatePoints(tolerance, pointRemap);
 
-   if (!duplicates.empty())
+   if (duplicates > 0)
    {
-       sanitizeInputData(duplicates, traceLvl);
+      if (traceLvl != None)
+      {
+         printf("Warning:  %d duplicate vertexes found - trying to sanitize input data!\n", duplicates);
+      }
+
+      applyPointRemap(pointRemap, traceLvl);
    }
 
-   return true;
+   return pointRemap;
 }
 
 
-void Delaunay::enableMeshIndexGeneration() 
+Delaunay::SegmentIntersectionReport Delaunay::resolveSegmentIntersections(DebugOutputLevel traceLvl)
 {
-   m_extraVertexAttr = true;
-}
+   SegmentIntersectionReport report;
+   int segmentCount = (int)m_segmentList.size() / 2;
+
+   if (segmentCount < 2)
+   {
+      return report;
+   }
+
+   auto orientation = [](const Point& a, const Point& b, const Point& c)
+   {
+      return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+   };
+
+   // 1. register the segments in the cells of a uniform grid which they pass through. The cells are 
+   //    about as large as the median segment, thus a few long segments don't coarsen the grid. Only the 
+   //    occupied cells are stored.
+   double minX = m_pointList[m_segmentList[0]][0], minY = m_pointList[m_segmentList[0]][1];
+   double maxX = minX, maxY = minY;
+
+   for (int pointIdx : m_segmentList)
+   {
+      minX = std::min(minX, m_pointList[pointIdx][0]);
+      minY = std::min(minY, m_pointList[pointIdx][1]);
+      maxX = std::max(maxX, m_pointList[pointIdx][0]);
+      maxY = std::max(maxY, m_pointList[pointIdx][1]);
+   }
+
+   double extent = std::max(maxX - minX, maxY - minY);
+   if (extent <= 0)
+   {
+      return report;
+   }
+
+   std::vector<double> lengths;
+   lengths.reserve(segmentCount);
+
+   for (int s = 0; s < segmentCount; ++s)
+   {
+      const Point& p = m_pointList[m_segmentList[2 * s]];
+      const Point& q = m_pointList[m_segmentList[2 * s + 1]];
+
+      if (p != q)
+      {
+         lengths.push_back(std::hypot(q[0] - p[0], q[1] - p[1]));
+      }
+   }
+
+   double cellSize = extent;
+   if (!lengths.empty())
+   {
+      std::nth_element(lengths.begin(), lengths.begin() + lengths.size() / 2, lengths.end());
+      cellSize = std::min(extent, std::max(lengths[lengths.size() / 2], extent / (1 << 20)));
+   }
+
+   double eps = cellSize * 1e-6; // register the segments near a cell's border in both cells
+   int64_t columns = (int64_t)((maxX - minX) / cellSize) + 1;
+   int64_t rows = (int64_t)((maxY - minY) / cellSize) + 1;
+
+   auto cellIndex = [cellSize](double coord, double minCoord, int64_t cellCount)
+   {
+      int64_t cell = (int64_t)std::floor((coord - minCoord) / cellSize);
+      return std::min(std::max(cell, (int64_t)0), cellCount - 1);
+   };
+
+   // column by column, thus the cells of a column follow each other
+   auto cellOf = [&](const Point& pt)
+   {
+      return cellIndex(pt[0], minX, columns) * rows + cellIndex(pt[1], minY, rows);
+   };
+
+   // segments passing through more cells are registered only where they meet other segments, see below
+   const double maxCellsPerSegment = 32;
+   std::vector<char> isLong(segmentCount, 0);
+   std::vector<int> longSegments;
+
+   // the rows which the part of a segment in a column passes through
+   auto rowsInColumn = [&](const Point& p, const Point& q, int64_t column, int64_t& firstRow, int64_t& lastRow)
+   {
+      double y0 = p[1];
+      double y1 = q[1];
+
+      if (q[0] > p[0])
+      {
+         double x0 = std::max(p[0], minX + column * cellSize);
+         double x1 = std::min(q[0], minX + (column + 1) * cellSize);
+
+         y0 = p[1] + (q[1] - p[1]) * (x0 - p[0]) / (q[0] - p[0]);
+         y1 = p[1] + (q[1] - p[1]) * (x1 - p[0]) / (q[0] - p[0]);
+      }
+
+      firstRow = cellIndex(std::min(y0, y1) - eps, minY, rows);
+      lastRow = cellIndex(std::max(y0, y1) + eps, minY, rows);
+   };
+
+   std::vector<std::pair<int64_t, int>> cellEntries; // (cell, segment)
+   cellEntries.reserve(4 * segmentCount);
+
+   for (int s = 0; s < segmentCount; ++s)
+   {
+      Point p = m_pointList[m_segmentList[2 * s]];
+      Point q = m_pointList[m_segmentList[2 * s + 1]];
+
+      if (std::abs(q[0] - p[0]) + std::abs(q[1] - p[1]) > maxCellsPerSegment * cellSize)
+      {
+         isLong[s] = 1;
+         longSegments.push_back(s);
+         continue;
+      }
+
+      if (p[0] > q[0])
+      {
+         std::swap(p, q);
+      }
+
+      int64_t firstColumn = cellIndex(p[0] - eps, minX, columns);
+      int64_t lastColumn = cellIndex(q[0] + eps, minX, columns);
+
+      for (int64_t column = firstColumn; column <= lastColumn; ++column)
+      {
+         int64_t firstRow, lastRow;
+         rowsInColumn(p, q, column, firstRow, lastRow);
+
+         for (int64_t row = firstRow; row <= lastRow; ++row)
+         {
+            cellEntries.push_back(std::make_pair(column * rows + row, s));
+         }
+      }
+   }
+
+   std::sort(cellEntries.begin(), cellEntries.end()); // by cells, the segments of a cell stay ordered
+
+   // the tests of a pair of segments, in the same way for the cells and the long segments
+   struct PairTest
+   {
+      bool crosses;
+      double o1, o2, o3, o4; // orientations of the endpoints of one segment to the other one
+      double t1, t2;         // positions of the crossing along the segments
+      Point point;
+   };
+
+   auto testPair = [&](int s1, int s2)
+   {
+      PairTest test;
+      const Point& A0 = m_pointList[m_segmentList[2 * s1]];
+      const Point& A1 = m_pointList[m_segmentList[2 * s1 + 1]];
+      const Point& B0 = m_pointList[m_segmentList[2 * s2]];
+      const Point& B1 = m_pointList[m_segmentList[2 * s2 + 1]];
+
+      test.o1 = orientation(A0, A1, B0);
+      test.o2 = orientation(A0, A1, B1);
+      test.o3 = orientation(B0, B1, A0);
+      test.o4 = orientation(B0, B1, A1);
+      test.crosses = ((test.o1 < 0 && test.o2 > 0) || (test.o1 > 0 && test.o2 < 0)) && 
+                     ((test.o3 < 0 && test.o4 > 0) || (test.o3 > 0 && test.o4 < 0));
+      test.t1 = test.t2 = 0;
+
+      if (test.crosses)
+      {
+         test.t1 = test.o3 / (test.o3 - test.o4);
+         test.t2 = test.o1 / (test.o1 - test.o2);
+         test.point = Point(A0[0] + test.t1 * (A1[0] - A0[0]), A0[1] + test.t1 * (A1[1] - A0[1]));
+      }
+
+      return test;
+   };
+
+   // position of an endpoint lying in the interior of the other segment, else -1
+   auto touchingPosition = [&](const Point& p0, const Point& p1, int pointIdx, double orient)
+   {
+      const Point& pt = m_pointList[pointIdx];
+
+      if (orient != 0 || pt == p0 || pt == p1)
+      {
+         return -1.0;
+      }
+
+      double dx = p1[0] - p0[0];
+      double dy = p1[1] - p0[1];
+      double t = ((pt[0] - p0[0]) * dx + (pt[1] - p0[1]) * dy) / (dx * dx + dy * dy);
+
+      return (t > 0 && t < 1) ? t : -1.0;
+   };
+
+   // the cells in which the pair will be reported below: the one of the crossing point, or the ones of 
+   // the endpoints touching the other segment
+   auto meetingCells = [&](int s1, int s2, int64_t* cells)
+   {
+      int a0 = m_segmentList[2 * s1], a1 = m_segmentList[2 * s1 + 1];
+      int b0 = m_segmentList[2 * s2], b1 = m_segmentList[2 * s2 + 1];
+      const Point& A0 = m_pointList[a0];
+      const Point& A1 = m_pointList[a1];
+      const Point& B0 = m_pointList[b0];
+      const Point& B1 = m_pointList[b1];
+      int cellCt = 0;
+
+      if (A0 == A1 || B0 == B1)
+      {
+         return cellCt;
+      }
+
+      PairTest test = testPair(s1, s2);
+
+      if (test.crosses)
+      {
+         cells[cellCt++] = cellOf(test.point);
+      }
+      else
+      {
+         if (touchingPosition(A0, A1, b0, test.o1) > 0) cells[cellCt++] = cellOf(B0);
+         if (touchingPosition(A0, A1, b1, test.o2) > 0) cells[cellCt++] = cellOf(B1);
+         if (touchingPosition(B0, B1, a0, test.o3) > 0) cells[cellCt++] = cellOf(A0);
+         if (touchingPosition(B0, B1, a1, test.o4) > 0) cells[cellCt++] = cellOf(A1);
+      }
+
+      return cellCt;
+   };
+
+   // register the long segments only in their endpoints' cells and in the cells where they meet other 
+   // segments: walk along them over the occupied columns and cells of the grid, and sweep over the long 
+   // segments' bounding boxes sorted by their left side
+   if (!longSegments.empty())
+   {
+      std::vector<int64_t> occupiedColumns;
+      std::vector<size_t> columnStart; // first entry of each occupied column
+
+      for (size_t i = 0; i < cellEntries.size(); ++i)
+      {
+         int64_t column = cellEntries[i].first / rows;
+
+         if (occupiedColumns.empty() || occupiedColumns.back() != column)
+         {
+            occupiedColumns.push_back(column);
+            columnStart.push_back(i);
+         }
+      }
+      columnStart.push_back(cellEntries.size());
+
+      std::vector<double> boxes(4 * longSegments.size()); // minX, maxX, minY, maxY
+      std::vector<int> byLeft(longSegments.size());
+
+      for (size_t i = 0; i < longSegments.size(); ++i)
+      {
+         const Point& p = m_pointList[m_segmentList[2 * longSegments[i]]];
+         const Point& q = m_pointList[m_segmentList[2 * longSegments[i] + 1]];
+
+         boxes[4 * i] = std::min(p[0], q[0]);
+         boxes[4 * i + 1] = std::max(p[0], q[0]);
+         boxes[4 * i + 2] = std::min(p[1], q[1]);
+         boxes[4 * i + 3] = std::max(p[1], q[1]);
+         byLeft[i] = (int)i;
+      }
+
+      std::sort(byLeft.begin(), byLeft.end(), [&boxes](int lhs, int rhs) { return boxes[4 * lhs] < boxes[4 * rhs]; });
+
+      int longChunkCount = std::max(1, std::min(4 * resolveThreadCount(m_threadCount), (int)longSegments.size()));
+      std::vector<std::vector<std::pair<int64_t, int>>> longEntries(longChunkCount);
+
+      parallelFor(longChunkCount, resolveThreadCount(m_threadCount), [&](long firstChunk, long lastChunk)
+      {
+         for (long chunk = firstChunk; chunk < lastChunk; ++chunk)
+         {
+            size_t first = byLeft.size() * chunk / longChunkCount;
+            size_t last = byLeft.size() * (chunk + 1) / longChunkCount;
+            std::vector<std::pair<int64_t, int>>& entries = longEntries[chunk];
+            int64_t cells[4];
+
+            for (size_t i = first; i < last; ++i)
+            {
+               int l = longSegments[byLeft[i]];
+               Point p = m_pointList[m_segmentList[2 * l]];
+               Point q = m_pointList[m_segmentList[2 * l + 1]];
+
+               entries.push_back(std::make_pair(cellOf(p), l));
+               entries.push_back(std::make_pair(cellOf(q), l));
+
+               if (p[0] > q[0])
+               {
+                  std::swap(p, q);
+               }
+
+               // the other segments in the occupied cells on the way
+               int64_t lastColumn = cellIndex(q[0] + eps, minX, columns);
+               size_t k = std::lower_bound(occupiedColumns.begin(), occupiedColumns.end(), 
+                                           cellIndex(p[0] - eps, minX, columns)) - occupiedColumns.begin();
+
+               for (; k < occupiedColumns.size() && occupiedColumns[k] <= lastColumn; ++k)
+               {
+                  int64_t column = occupiedColumns[k];
+                  int64_t firstRow, lastRow;
+                  rowsInColumn(p, q, column, firstRow, lastRow);
+
+                  auto entry = std::lower_bound(cellEntries.begin() + columnStart[k], cellEntries.begin() + columnStart[k + 1],
+                                                std::make_pair(column * rows + firstRow, -1));
+
+                  for (; entry != cellEntries.begin() + columnStart[k + 1] && entry->first <= column * rows + lastRow; ++entry)
+                  {
+                     int cellCt = meetingCells(std::min(l, entry->second), std::max(l, entry->second), cells);
+
+                     for (int c = 0; c < cellCt; ++c)
+                     {
+                        entries.push_back(std::make_pair(cells[c], l));
+                     }
+                  }
+               }
+
+               // the other long segments
+               for (size_t j = i + 1; j < byLeft.size() && boxes[4 * byLeft[j]] <= boxes[4 * byLeft[i] + 1]; ++j)
+               {
+                  int other = longSegments[byLeft[j]];
+
+                  if (boxes[4 * byLeft[j] + 3] < boxes[4 * byLeft[i] + 2] || boxes[4 * byLeft[j] + 2] > boxes[4 * byLeft[i] + 3])
+                  {
+                     continue;
+                  }
+
+                  int cellCt = meetingCells(std::min(l, other), std::max(l, other), cells);
+
+                  for (int c = 0; c < cellCt; ++c)
+                  {
+                     entries.push_back(std::make_pair(cells[c], l));
+                     entries.push_back(std::make_pair(cells[c], other));
+                  }
+               }
+            }
+         }
+      });
+
+      for (const auto& entries : longEntries)
+      {
+         cellEntries.insert(cellEntries.end(), entries.begin(), entries.end());
+      }
+
+      std::sort(cellEntries.begin(), cellEntries.end());
+   }
+
+   cellEntries.erase(std::unique(cellEntries.begin(), cellEntries.end()), cellEntries.end());
+
+   std::vector<int64_t> cellIds;
+   std::vector<int> cellStart;
+   std::vector<int> cellSegments(cellEntries.size());
+
+   for (size_t i = 0; i < cellEntries.size(); ++i)
+   {
+      if (i == 0 || cellEntries[i].first != cellEntries[i - 1].first)
+      {
+         cellIds.push_back(cellEntries[i].first);
+         cellStart.push_back((int)i);
+      }
+      cellSegments[i] = cellEntries[i].second;
+   }
+   cellStart.push_back((int)cellEntries.size());
+
+   int cellCount = (int)cellIds.size();
+
+   // 2. test the pairs of segments sharing a cell, in parallel. A pair sharing several cells is only 
+   //    reported in the cell containing the crossing (or touching) point.
+   struct Crossing
+   {
+      int segment1, segment2;
+      double t1, t2; // positions along the segments
+      Point point;
+      int pointIdx;  // an input point at the same position, else -1
+      int sameAs;    // an earlier crossing of the same cell at the same position, else -1
+   };
+
+   struct Touching
+   {
+      int segment;
+      double t;
+      int pointIdx;
+   };
+
+   int chunkCount = std::max(1, std::min(4 * resolveThreadCount(m_threadCount), cellCount));
+   std::vector<std::vector<Crossing>> crossings(chunkCount);
+   std::vector<std::vector<Touching>> touchings(chunkCount);
+
+   parallelFor(chunkCount, resolveThreadCount(m_threadCount), [&](long firstChunk, long lastChunk)
+   {
+      for (long chunk = firstChunk; chunk < lastChunk; ++chunk)
+      {
+         int firstCell = (int)((long)cellCount * chunk / chunkCount);
+         int lastCell = (int)((long)cellCount * (chunk + 1) / chunkCount);
+
+         for (int cell = firstCell; cell < lastCell; ++cell)
+         {
+            size_t cellCrossings = crossings[chunk].size();
+            int64_t cellId = cellIds[cell];
+
+            for (int i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+            {
+               for (int j = i + 1; j < cellStart[cell + 1]; ++j)
+               {
+                  int s1 = cellSegments[i];
+                  int s2 = cellSegments[j];
+                  int a0 = m_segmentList[2 * s1], a1 = m_segmentList[2 * s1 + 1];
+                  int b0 = m_segmentList[2 * s2], b1 = m_segmentList[2 * s2 + 1];
+                  const Point& A0 = m_pointList[a0];
+                  const Point& A1 = m_pointList[a1];
+                  const Point& B0 = m_pointList[b0];
+                  const Point& B1 = m_pointList[b1];
+
+                  if (A0 == A1 || B0 == B1)
+                  {
+                     continue; // reported by TriLib
+                  }
+
+                  PairTest test = testPair(s1, s2);
+
+                  if (test.crosses)
+                  {
+                     if (cellOf(test.point) == cellId)
+                     {
+                        crossings[chunk].push_back({ s1, s2, test.t1, test.t2, test.point, -1, -1 });
+                     }
+                     continue;
+                  }
+
+                  // endpoints lying in the interior of the other segment
+                  auto checkTouching = [&](int segment, const Point& p0, const Point& p1, int pointIdx, double orient)
+                  {
+                     if (cellOf(m_pointList[pointIdx]) != cellId)
+                     {
+                        return;
+                     }
+
+                     double t = touchingPosition(p0, p1, pointIdx, orient);
+
+                     if (t > 0)
+                     {
+                        touchings[chunk].push_back({ segment, t, pointIdx });
+                     }
+                  };
+
+                  checkTouching(s1, A0, A1, b0, test.o1);
+                  checkTouching(s1, A0, A1, b1, test.o2);
+                  checkTouching(s2, B0, B1, a0, test.o3);
+                  checkTouching(s2, B0, B1, a1, test.o4);
+               }
+            }
+
+            // several crossings at the same point, or at an endpoint of a segment
+            for (size_t k = cellCrossings; k < crossings[chunk].size(); ++k)
+            {
+               Crossing& crossing = crossings[chunk][k];
+
+               for (size_t l = cellCrossings; l < k && crossing.sameAs < 0; ++l)
+               {
+                  if (crossings[chunk][l].point == crossing.point)
+                  {
+                     crossing.sameAs = (int)l;
+                  }
+               }
+
+               for (int i = cellStart[cell]; i < cellStart[cell + 1] && crossing.sameAs < 0; ++i)
+               {
+                  for (int end = 0; end < 2; ++end)
+                  {
+                     int pointIdx = m_segmentList[2 * cellSegments[i] + end];
+                     if (m_pointList[pointIdx] == crossing.point)
+                     {
+                        crossing.pointIdx = pointIdx;
+                     }
+                  }
+               }
+            }
+         }
+      }
+   });
+
+   // 3. add the crossing points and collect the split points of each segment
+   std::vector<std::vector<std::pair<double, int>>> splits(segmentCount);
+
+   for (int chunk = 0; chunk < chunkCount; ++chunk)
+   {
+      std::vector<int> crossingPoints(crossings[chunk].size());
+
+      for (size_t k = 0; k < crossings[chunk].size(); ++k)
+      {
+         const Crossing& crossing = crossings[chunk][k];
+         int pointIdx = crossing.pointIdx;
+
+         if (crossing.sameAs >= 0)
+         {
+            pointIdx = crossingPoints[crossing.sameAs];
+         }
+         else if (pointIdx < 0)
+         {
+            pointIdx = (int)m_pointList.size();
+            m_pointList.push_back(crossing.point);
+            report.addedPoints.push_back(pointIdx);
+         }
+
+         crossingPoints[k] = pointIdx;
+         splits[crossing.segment1].push_back(std::make_pair(crossing.t1, pointIdx));
+         splits[crossing.segment2].push_back(std::make_pair(crossing.t2, pointIdx));
+         report.crossingCount++;
+      }
+
+      for (const auto& touching : touchings[chunk])
+      {
+         splits[touching.segment].push_back(std::make_pair(touching.t, touching.pointIdx));
+         report.touchingCount++;
+      }
+   }
+
+   if (!report.addedPoints.empty() && !m_pointWeights.empty())
+   {
+      std::cerr << "WARNING: the added crossing points get the weight 0!\n";
+      m_pointWeights.resize(m_pointList.size(), 0.0);
+   }
+
+   // 4. replace the segments by their parts, drop the duplicates
+   std::vector<int> segments;
+   segments.reserve(m_segmentList.size());
+
+   for (int s = 0; s < segmentCount; ++s)
+   {
+      auto& splitPoints = splits[s];
+      int pointIdx = m_segmentList[2 * s];
+
+      if (!splitPoints.empty())
+      {
+         std::sort(splitPoints.begin(), splitPoints.end());
+         report.splitSegmentCount++;
+      }
+
+      for (const auto& split : splitPoints)
+      {
+         if (split.second != pointIdx)
+         {
+            segments.push_back(pointIdx);
+            segments.push_back(split.second);
+            pointIdx = split.second;
+         }
+      }
+
+      if (m_segmentList[2 * s + 1] != pointIdx)
+      {
+         segments.push_back(pointIdx);
+         segments.push_back(m_segmentList[2 * s + 1]);
+      }
+   }
+
+   std::vector<std::pair<uint64_t, int>> keys(segments.size() / 2); // (endpoints, position)
+   for (size_t i = 0; i < keys.size(); ++i)
+   {
+      int from = segments[2 * i];
+      int to = segments[2 * i + 1];
+      keys[i] = std::make_pair(((uint64_t)std::min(from, to) << 32) | (uint64_t)std::max(from, to), (int)i);
+   }
+
+   std::sort(keys.begin(), keys.end());
+   std::vector<char> duplicate(keys.size(), 0);
+
+   for (size_t i = 1; i < keys.size(); ++i)
+   {
+      if (keys[i].first == keys[i - 1].first)
+      {
+         duplicate[keys[i].second] = 1; // keep the first one
+         report.removedSegmentCount++;
+      }
+   }
+
+   size_t kept = 0;
+   for (size_t i = 0; i < duplicate.size(); ++i)
+   {
+      if (!duplicate[i])
+      {
+         segments[2 * kept] = segments[2 * i];
+         segments[2 * kept + 1] = segments[2 * i + 1];
+         ++kept;
+      }
+   }
+   segments.resize(2 * kept);
+
+   m_segmentList.swap(segments);
+
+   if (traceLvl != None)
+   {
+      printf("Info:  %d segment crossings and %d touching segment endpoints resolved, %d segments split, "
+             "%d segments removed, %zd points added.\n", report.crossingCount, report.touchingCount,
+             report.splitSegmentCount, report.removedSegmentCount, report.addedPoints.size());
+   }
+
+   return report;
+}
+
+
+void Delaunay::enableMeshIndexGeneration() 
+{
+   m_extraVertexAttr = true;
+}
+
+
+void Delaunay::setAlgorithm(AlgorithmType alg)
+{
+   m_triAlgorithm = alg;
+}
+
+
+void Delaunay::setVertexOrdering(VertexOrdering order)
+{
+   m_vertexOrdering = order;
+}
+
+
+void Delaunay::setThreadCount(int threads)
+{
+   Assert(threads >= 0, "thread count cannot be negative");
+   m_threadCount = threads;
+}
+
+
+void Delaunay::enableBaseTriangulationCache(bool enable)
+{
+   m_cacheBaseTriangulation = enable;
+
+   if (!enable)
+   {
+      m_baseTriangulation = BaseTriangulation();
+   }
+}
+
+
+void Delaunay::enableSegmentBatchInsertion(bool enable)
+{
+   m_segmentBatchInsertion = enable;
+}
+
+
+void Delaunay::useConvexHullWithSegments(bool useConvexHull)
+{
+#if 0
+    // --> Yejneshwar commented on 26 Feb 22
+    //Hi,
+    //    Thank you for this implementation.
+    //    could you please add support for the D tag ?
+    //    i.e.remove concavities
+    //
+    //    EDIT :
+    //    I have fixed the issue, will be submitting a pull request soon.
+    //    Support for it existed but internally the "c" tag would still be added which caused the concavities to not be removed.
+
+    TriangulateConf(options); //created a new function just for the -D tag, because the -c tag doesn't remove concavities with a boundary defined through the segment list.
+#endif
+
+    m_convexHullWithSegments = useConvexHull; // with/without convex hull (credits Yejneshwar!)
+}
+
+
+bool Delaunay::setHolesConstraint(const std::vector<Point>& holes)
+{
+   m_holesList = holes;
+
+   // OPEN TODO::: check the intersection constraints ... ???
+
+   return true;
+}
+
+
+bool Delaunay::addHoleRing(const std::vector<Point>& ring)
+{
+   if (ring.size() < 3)
+   {
+      return false;
+   }
+
+   return appendPolyline(ring, true, m_holeRingSegments);
+}
+
+
+void Delaunay::clearHoleRings()
+{
+   m_holeRingSegments.clear();
+}
+
+
+bool Delaunay::setRegionsConstraint(const std::vector<Point>& regions, const std::vector<float>& areas)
+{
+   if (regions.size() != areas.size())
+   {
+      return false;
+   }
+
+   m_regionsConstrList.clear();
+    
+   for (size_t i = 0; i < regions.size(); ++i)
+   {
+      auto& r = regions[i];
+      double arr[] = { r[0], r[1], areas[i], areas[i] }; // if no region attr - copy the area therein
+      m_regionsConstrList.emplace_back(Point4(arr));
+   }
+
+   return true;
+}
+
+
+bool Delaunay::setRegionsConstraint(const std::vector<Point4>& regionConstr)
+{
+   m_regionsConstrList = regionConstr;
+   return true; // OPEN TODO::: check something?
+}
+
+
+bool Delaunay::setSizingField(const SizingField& field)
+{
+   if (field.cellSize <= 0 || field.columns <= 0 || field.rows <= 0 ||
+       field.edgeLengths.size() != (size_t)field.columns * field.rows)
+   {
+      std::cerr << "ERROR: Invalid sizing field grid!\n";
+      return false;
+   }
+
+   if (std::any_of(field.edgeLengths.begin(), field.edgeLengths.end(), [](double h) { return !(h > 0); }))
+   {
+      std::cerr << "ERROR: Sizing field edge lengths must be positive!\n";
+      return false;
+   }
+
+   m_sizingField = field;
+   m_sizingFieldAreas.resize(field.edgeLengths.size());
+
+   // target area = area of an equilateral triangle
+   const double sqrt3by4 = 0.4330127018922193;
+
+   for (size_t i = 0; i < field.edgeLengths.size(); ++i)
+   {
+      m_sizingFieldAreas[i] = sqrt3by4 * field.edgeLengths[i] * field.edgeLengths[i];
+   }
+
+   return true;
+}
+
+
+bool Delaunay::setSizingField(const std::vector<Point>& points, const std::vector<double>& edgeLengths, double cellSize)
+{
+   if (points.size() < 3 || points.size() != edgeLengths.size() || !(cellSize > 0))
+   {
+      std::cerr << "ERROR: Invalid background triangulation for the sizing field!\n";
+      return false;
+   }
+
+   double minX = points[0][0], minY = points[0][1];
+   double maxX = minX, maxY = minY;
+
+   for (const auto& pt : points)
+   {
+      minX = std::min(minX, pt[0]);
+      minY = std::min(minY, pt[1]);
+      maxX = std::max(maxX, pt[0]);
+      maxY = std::max(maxY, pt[1]);
+   }
+
+   SizingField field;
+   field.originX = minX;
+   field.originY = minY;
+   field.cellSize = cellSize;
+   field.columns = (int)std::ceil((maxX - minX) / cellSize) + 1;
+   field.rows = (int)std::ceil((maxY - minY) / cellSize) + 1;
+   field.edgeLengths.assign((size_t)field.columns * field.rows, -1.0);
+
+   Delaunay background(points);
+   background.Triangulate();
+
+   // sample the linear interpolation over each background triangle
+   for (const auto& f : background.faces())
+   {
+      int idx[3] = { f.Org(), f.Dest(), f.Apex() };
+      const Point& p0 = points[idx[0]];
+      const Point& p1 = points[idx[1]];
+      const Point& p2 = points[idx[2]];
+
+      double det = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+      if (det == 0)
+      {
+         continue;
+      }
+
+      int colFrom = (int)std::ceil((std::min({ p0[0], p1[0], p2[0] }) - minX) / cellSize);
+      int colTo = (int)std::floor((std::max({ p0[0], p1[0], p2[0] }) - minX) / cellSize);
+      int rowFrom = (int)std::ceil((std::min({ p0[1], p1[1], p2[1] }) - minY) / cellSize);
+      int rowTo = (int)std::floor((std::max({ p0[1], p1[1], p2[1] }) - minY) / cellSize);
+
+      for (int row = std::max(rowFrom, 0); row <= std::min(rowTo, field.rows - 1); ++row)
+      {
+         for (int col = std::max(colFrom, 0); col <= std::min(colTo, field.columns - 1); ++col)
+         {
+            double x = minX + col * cellSize;
+            double y = minY + row * cellSize;
 
+            // barycentric coordinates
+            double w1 = ((x - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (y - p0[1])) / det;
+            double w2 = ((p1[0] - p0[0]) * (y - p0[1]) - (x - p0[0]) * (p1[1] - p0[1])) / det;
+            double w0 = 1 - w1 - w2;
+            const double eps = -1e-12;
 
-void Delaunay::setAlgorithm(AlgorithmType alg)
-{
-   m_triAlgorithm = alg;
-}
+            if (w0 >= eps && w1 >= eps && w2 >= eps)
+            {
+               field.edgeLengths[(size_t)row * field.columns + col] =
+                  w0 * edgeLengths[idx[0]] + w1 * edgeLengths[idx[1]] + w2 * edgeLengths[idx[2]];
+            }
+         }
+      }
+   }
 
+   // outside of the background triangulation (i.e. near the hull), spread the values of the nearest 
+   // grid nodes having one, i.e. breadth-first over the grid. Nodes at the input points always have 
+   // a value, even if the grid is too coarse for any node to lie inside of a triangle
+   std::vector<double>& nodeLengths = field.edgeLengths;
 
-void Delaunay::useConvexHullWithSegments(bool useConvexHull)
-{
-#if 0
-    // --> Yejneshwar commented on 26 Feb 22
-    //Hi,
-    //    Thank you for this implementation.
-    //    could you please add support for the D tag ?
-    //    i.e.remove concavities
-    //
-    //    EDIT :
-    //    I have fixed the issue, will be submitting a pull request soon.
-    //    Support for it existed but internally the "c" tag would still be added which caused the concavities to not be removed.
+   for (size_t i = 0; i < points.size(); ++i)
+   {
+      int col = (int)std::lround((points[i][0] - minX) / cellSize);
+      int row = (int)std::lround((points[i][1] - minY) / cellSize);
+      double& h = nodeLengths[(size_t)row * field.columns + col];
 
-    TriangulateConf(options); //created a new function just for the -D tag, because the -c tag doesn't remove concavities with a boundary defined through the segment list.
-#endif
+      if (h < 0)
+      {
+         h = edgeLengths[i];
+      }
+   }
 
-    m_convexHullWithSegments = useConvexHull; // with/without convex hull (credits Yejneshwar!)
-}
+   std::vector<size_t> front;
+   for (size_t node = 0; node < nodeLengths.size(); ++node)
+   {
+      if (nodeLengths[node] >= 0)
+      {
+         front.push_back(node);
+      }
+   }
 
+   for (size_t next = 0; next < front.size(); ++next)
+   {
+      int row = (int)(front[next] / field.columns);
+      int col = (int)(front[next] % field.columns);
 
-bool Delaunay::setHolesConstraint(const std::vector<Point>& holes)
-{
-   m_holesList = holes;
+      for (int r = std::max(row - 1, 0); r <= std::min(row + 1, field.rows - 1); ++r)
+      {
+         for (int c = std::max(col - 1, 0); c <= std::min(col + 1, field.columns - 1); ++c)
+         {
+            size_t neighbor = (size_t)r * field.columns + c;
 
-   // OPEN TODO::: check the intersection constraints ... ???
+            if (nodeLengths[neighbor] < 0)
+            {
+               nodeLengths[neighbor] = nodeLengths[front[next]];
+               front.push_back(neighbor);
+            }
+         }
+      }
+   }
 
-   return true;
+   return setSizingField(field);
 }
 
 
-bool Delaunay::setRegionsConstraint(const std::vector<Point>& regions, const std::vector<float>& areas)
+void Delaunay::removeSizingField()
 {
-   if (regions.size() != areas.size())
-   {
-      return false;
-   }
+   m_sizingField = SizingField();
+   m_sizingFieldAreas.clear();
+}
 
-   m_regionsConstrList.clear();
-    
-   for (size_t i = 0; i < regions.size(); ++i)
-   {
-      auto& r = regions[i];
-      double arr[] = { r[0], r[1], areas[i], areas[i] }; // if no region attr - copy the area therein
-      m_regionsConstrList.emplace_back(Point4(arr));
-   }
 
-   return true;
+void Delaunay::setRefinementBudget(const RefinementBudget& budget)
+{
+   m_refinementBudget = budget;
+   m_hasRefinementBudget = true;
 }
 
 
-bool Delaunay::setRegionsConstraint(const std::vector<Point4>& regionConstr)
+void Delaunay::removeRefinementBudget()
 {
-   m_regionsConstrList = regionConstr;
-   return true; // OPEN TODO::: check something?
+   m_refinementBudget = RefinementBudget();
+   m_hasRefinementBudget = false;
 }
 
 
@@ -471,6 +1700,9 @@ bool Delaunay::saveSegments(const std::string& filePath)
                                   sizeof(comments)/sizeof(const char*), 
                                   const_cast<char**>(comments));
 
+    // writenodes2file() renumbered the vertices in pool order, restore the input indexes
+    remapInputVertexMarks();
+
     return true;
 }
 
@@ -494,6 +1726,7 @@ bool Delaunay::readPoints(const std::string& filePath, std::vector<Delaunay::Poi
 
     // read points from the mesh data
     readPointsFromMesh(m_pointList);
+    invalidatePointIndex();
        
     points = m_pointList; // OPEN TODO::: make optional parameter?????
     return true;
@@ -528,10 +1761,13 @@ bool Delaunay::readSegments(
 
     // get points from the mesh data
     readPointsFromMesh(m_pointList);
+    invalidatePointIndex();
     points = m_pointList; // OPEN TODO::: make it optional param????
 
-    auto duplicates = checkForDuplicatePoints();
-    if (!duplicates.empty())
+    std::vector<int> pointRemap;
+    int duplicates = findDuplicatePoints(0, pointRemap);
+
+    if (duplicates > 0)
     {
         // read file directly
         //  - Trilib's code doesn't support duplicate points!
@@ -551,7 +1787,12 @@ bool Delaunay::readSegments(
             }
         }
 
-        sanitizeInputData(duplicates, traceLvl);
+        if (traceLvl != None)
+        {
+            printf("Warning:  %d duplicate vertexes found - trying to sanitize input data!\n", duplicates);
+        }
+
+        applyPointRemap(pointRemap, traceLvl);
 
         points = m_pointList; // OPEN TODO::: make it optional param????
         segmentEndpoints = m_segmentList; // OPEN TODO::: make it optional param????
@@ -600,7 +1841,7 @@ bool Delaunay::readSegments(
 
     if (duplicatePointCount)
     {
-       *duplicatePointCount = duplicates.size();
+       *duplicatePointCount = duplicates;
     }
 
     // get hole marker points
@@ -629,6 +1870,60 @@ void Delaunay::enableFileIOTrace(bool enable)
 }
 
 
+bool Delaunay::refinementCompleted() const
+{
+   if (!m_triangulated)
+   {
+      return false;
+   }
+
+   TP_MESH_BEHAVIOR();
+   return !tpbehavior->quality ||
+          (!tpmesh->refinementstopped && tpmesh->badsubsegs.items == 0);
+}
+
+
+Delaunay::QualityStats Delaunay::qualityStats() const
+{
+   QualityStats stats;
+
+   if (!m_triangulated)
+   {
+      return stats;
+   }
+
+   TP_MESH_BEHAVIOR_WRAP();
+
+   Triwrap::qualitystats triStats;
+   pTriangleWrap->computequalitystats(tpmesh, tpbehavior, resolveThreadCount(m_threadCount), &triStats);
+
+   stats.triangleCount = (int)triStats.triangles;
+
+   if (stats.triangleCount == 0)
+   {
+      return stats;
+   }
+
+   stats.minAngle = triStats.smallestangle;
+   stats.maxAngle = triStats.biggestangle;
+   stats.angleHistogram.assign(std::begin(triStats.angletable), std::end(triStats.angletable));
+   stats.shortestEdge = triStats.shortest;
+   stats.longestEdge = triStats.longest;
+   stats.shortestAltitude = triStats.minaltitude;
+   stats.maxAspectRatio = triStats.worstaspect;
+   stats.aspectRatioBounds = { 1.5, 2.0, 2.5, 3.0, 4.0, 6.0, 10.0, 15.0, 25.0, 50.0, 
+                               100.0, 300.0, 1000.0, 10000.0, 100000.0 }; // as in TriLib's quality_statistics()
+   stats.aspectRatioHistogram.assign(std::begin(triStats.aspecttable), std::end(triStats.aspecttable));
+   stats.minArea = triStats.smallestarea;
+   stats.maxArea = triStats.biggestarea;
+   stats.smallAngleCount = (int)triStats.badangles;
+   stats.largeAreaCount = (int)triStats.badareas;
+   stats.userTestFailedCount = (int)triStats.badusertests;
+
+   return stats;
+}
+
+
 int Delaunay::edgeCount() const
 {
     return TP_MESH_PTR()->edges;
@@ -669,8 +1964,13 @@ int Delaunay::voronoiEdgeCount() const
 {
    TP_VOROUT();
 
-   return
-      !tpvorout ? 0 : tpvorout->numberofedges;
+   if (tpvorout)
+   {
+      return tpvorout->numberofedges;
+   }
+
+   // not built yet, but it will be the dual of the current mesh
+   return m_triangulated ? (int)TP_MESH_PTR()->edges : 0;
 }
 
 
@@ -678,8 +1978,12 @@ int Delaunay::voronoiPointCount() const
 {
    TP_VOROUT();
 
-   return
-      !tpvorout ? 0 : tpvorout->numberofpoints;
+   if (tpvorout)
+   {
+      return tpvorout->numberofpoints;
+   }
+
+   return m_triangulated ? (int)TP_MESH_PTR()->triangles.items : 0;
 }
 
 
@@ -759,8 +2063,240 @@ VertexList::VertexListIterator VertexList::end()
 }
 
 
+void Delaunay::parallelForEachFace(const std::function<void(const FaceIterator& face, int worker)>& func, int threads)
+{
+   if (!m_triangulated)
+   {
+      return;
+   }
+
+   TP_MESH_WRAP();
+   typedef Triwrap::triangle triangle; // needed for Triwrap's macro deadtri()
+   int threadCount = resolveThreadCount(threads);
+
+   // one contiguous slice of the pool's blocks per worker
+   pTriangleWrap->traverseparallel(&tpmesh->triangles, threadCount, threadCount, [&](long slice, void* item)
+   {
+      auto tri = (triangle*)item;
+
+      if (deadtri(tri))
+      {
+         return;
+      }
+
+      FaceIterator fit; // without a traversal, ++ would end it
+      fit.m_delaunay = this;
+      fit.floop.tri = (double***)tri;
+      fit.floop.orient = 0;
+
+      func(fit, (int)slice);
+   });
+}
+
+
+void Delaunay::parallelForEachVertex(const std::function<void(const VertexIterator& vertex, int worker)>& func, int threads)
+{
+   if (!m_triangulated)
+   {
+      return;
+   }
+
+   TP_MESH_WRAP();
+   Triwrap::__pmesh* m = tpmesh; // needed for Triwrap's macro vertextype()
+   int threadCount = resolveThreadCount(threads);
+
+   pTriangleWrap->traverseparallel(&tpmesh->vertices, threadCount, threadCount, [&](long slice, void* item)
+   {
+      auto vertex = (Triwrap::vertex)item;
+
+      // as with vbegin(), duplicates aren't part of the mesh
+      if (vertextype(vertex) == DEADVERTEX || vertextype(vertex) == UNDEADVERTEX)
+      {
+         return;
+      }
+
+      VertexIterator vit;
+      vit.m_delaunay = this;
+      vit.vloop = vertex;
+
+      func(vit, (int)slice);
+   });
+}
+
+
+bool Delaunay::exportMesh(MeshBuffers& buffers)
+{
+   buffers.vertexCount = 0;
+   buffers.triangleCount = 0;
+
+   if (!m_triangulated)
+   {
+      std::cerr << "ERROR: No triangulation to export!\n";
+      return false;
+   }
+
+   int vertexCount = verticeCount();
+   int triangleCount = this->triangleCount();
+
+   if (buffers.vertexCapacity < (size_t)vertexCount || buffers.triangleCapacity < (size_t)triangleCount ||
+       !buffers.points || !buffers.triangles)
+   {
+      std::cerr << "ERROR: Mesh buffers too small, need " << vertexCount << " vertices and " 
+                << triangleCount << " triangles!\n";
+      return false;
+   }
+
+   TP_MESH_BEHAVIOR_WRAP();
+   Triwrap::__pmesh* m = tpmesh;         // needed for Triwrap's macros vertextype()/vertexmark()
+   typedef Triwrap::triangle triangle;   // needed for Triwrap's macros deadtri()/sym()
+   typedef Triwrap::vertex vertex;       // needed for Triwrap's macros org()/dest()/apex()
+   typedef Triwrap::subseg subseg;       // needed for Triwrap's macro tspivot()
+   typedef Triwrap::int_ptr_type int_ptr_type; // same!
+   int threadCount = resolveThreadCount(m_threadCount);
+   int firstnumber = tpbehavior->firstnumber;
+   int inputCount = (int)m_pointList.size();
+
+   // vertices: the numbers set by numbernodes() are the slots in the buffers, thus each worker
+   // writes its own entries
+   std::vector<char> badSlices(threadCount, 0);
+
+   pTriangleWrap->traverseparallel(&tpmesh->vertices, threadCount, threadCount, [&](long slice, void* item)
+   {
+      auto vertexloop = (vertex)item;
+
+      if (vertextype(vertexloop) == DEADVERTEX || (tpbehavior->jettison && vertextype(vertexloop) == UNDEADVERTEX))
+      {
+         return;
+      }
+
+      int index = vertexmark(vertexloop) - firstnumber;
+
+      if ((unsigned)index >= (unsigned)vertexCount)
+      {
+         badSlices[slice] = 1;
+         return;
+      }
+
+      buffers.points[2 * index] = vertexloop[0];
+      buffers.points[2 * index + 1] = vertexloop[1];
+
+      if (buffers.markers)
+      {
+         buffers.markers[index] = vertextype(vertexloop) == SEGMENTVERTEX ? 1 : 0;
+      }
+      if (buffers.inputIndexes)
+      {
+         buffers.inputIndexes[index] = index < inputCount ? index : -1;
+      }
+   });
+
+   bool outOfRange = std::find(badSlices.begin(), badSlices.end(), 1) != badSlices.end();
+
+   // triangles: count the live ones per slice first, then each worker writes from its slice's offset
+   std::vector<int> sliceCounts(threadCount + 1, 0);
+
+   pTriangleWrap->traverseparallel(&tpmesh->triangles, threadCount, threadCount, [&](long slice, void* item)
+   {
+      if (!deadtri((triangle*)item))
+      {
+         sliceCounts[slice + 1]++;
+      }
+   });
+
+   for (int i = 0; i < threadCount; ++i)
+   {
+      sliceCounts[i + 1] += sliceCounts[i];
+   }
+
+   std::vector<int> sliceNext(sliceCounts.begin(), sliceCounts.end() - 1);
+   std::vector<std::vector<int>> boundaryVertices(threadCount);
+
+   pTriangleWrap->traverseparallel(&tpmesh->triangles, threadCount, threadCount, [&](long slice, void* item)
+   {
+      Triwrap::__otriangle triangleloop, neighbor;
+      struct Triwrap::osub checksubseg;
+      vertex corners[3];
+      triangle ptr;  // needed for Triwrap's macro sym()
+      subseg sptr;   // needed for Triwrap's macro tspivot()
+
+      triangleloop.tri = (triangle*)item;
+      triangleloop.orient = 0;
+
+      if (deadtri(triangleloop.tri))
+      {
+         return;
+      }
+
+      org(triangleloop, corners[0]);
+      dest(triangleloop, corners[1]);
+      apex(triangleloop, corners[2]);
+
+      int32_t* out = buffers.triangles + 3 * (size_t)sliceNext[slice]++;
+
+      for (int i = 0; i < 3; ++i)
+      {
+         out[i] = vertexmark(corners[i]) - firstnumber;
+      }
+
+      if (!buffers.markers)
+      {
+         return;
+      }
+
+      // edges on the mesh's boundary or on a segment, marked serially below
+      for (triangleloop.orient = 0; triangleloop.orient < 3; triangleloop.orient++)
+      {
+         sym(triangleloop, neighbor);
+         bool onBoundary = neighbor.tri == tpmesh->dummytri;
+
+         if (!onBoundary && tpbehavior->usesegments)
+         {
+            tspivot(triangleloop, checksubseg);
+            onBoundary = checksubseg.ss != tpmesh->dummysub;
+         }
+
+         if (onBoundary)
+         {
+            vertex endpoint;
+            org(triangleloop, endpoint);
+            boundaryVertices[slice].push_back(vertexmark(endpoint) - firstnumber);
+            dest(triangleloop, endpoint);
+            boundaryVertices[slice].push_back(vertexmark(endpoint) - firstnumber);
+         }
+      }
+   });
+
+   for (auto& slice : boundaryVertices)
+   {
+      for (int index : slice)
+      {
+         if ((unsigned)index < (unsigned)vertexCount)
+         {
+            buffers.markers[index] = 1;
+         }
+      }
+   }
+
+   if (outOfRange)
+   {
+      std::cerr << "ERROR: Vertex numbering out of date, mesh not exported!\n";
+      return false;
+   }
+
+   buffers.vertexCount = vertexCount;
+   buffers.triangleCount = triangleCount;
+
+   return true;
+}
+
+
 VoronoiVertexIterator Delaunay::vvbegin()
 {
+   if (!buildVoronoi())
+   {
+      return vvend();
+   }
+
    return VoronoiVertexIterator(this);
 }
 
@@ -780,6 +2316,11 @@ VoronoiVertexIterator Delaunay::vvend()
 
 VoronoiEdgeIterator Delaunay::vebegin()
 {
+   if (!buildVoronoi())
+   {
+      return veend();
+   }
+
    return VoronoiEdgeIterator(this);
 }
 
@@ -793,7 +2334,90 @@ VoronoiEdgeIterator Delaunay::veend()
    veit.vecount = 0;
    veit.m_delaunay = nullptr;
 
-   return veit;
+   return veit;
+}
+
+
+ConstSpan<Delaunay::Point> Delaunay::voronoiPoints()
+{
+   buildVoronoi(); // empty without a triangulation
+   return ConstSpan<Point>(m_voronoiPoints.data(), m_voronoiPoints.size());
+}
+
+
+ConstSpan<Delaunay::VoronoiEdge> Delaunay::voronoiEdges()
+{
+   buildVoronoi();
+   return ConstSpan<VoronoiEdge>(m_voronoiEdges.data(), m_voronoiEdges.size());
+}
+
+
+ConstSpan<Delaunay::Point> Delaunay::voronoiRays()
+{
+   buildVoronoi();
+   return ConstSpan<Point>(m_voronoiRays.data(), m_voronoiRays.size());
+}
+
+
+ConstSpan<Delaunay::VoronoiEdgeSites> Delaunay::voronoiEdgeSites()
+{
+   buildVoronoi();
+   return ConstSpan<VoronoiEdgeSites>(m_voronoiEdgeSites.data(), m_voronoiEdgeSites.size());
+}
+
+
+Delaunay::VoronoiCells Delaunay::voronoiCells()
+{
+   VoronoiCells cells;
+
+   if (!m_triangulated)
+   {
+      return cells;
+   }
+
+   TP_MESH_BEHAVIOR_WRAP();
+
+   tpbehavior->threads = resolveThreadCount(m_threadCount);
+
+   int* offsets = nullptr;
+   int* vertices = nullptr;
+   int* neighbors = nullptr;
+   double* areas = nullptr;
+   int* clippedOffsets = nullptr;
+   double* clippedPoints = nullptr;
+
+   pTriangleWrap->buildvoronoicells(tpmesh, tpbehavior, &offsets, &vertices, &neighbors, &areas,
+                                    m_voronoiClipRegion.data(), (int)m_voronoiClipRegion.size() / 2, 
+                                    &clippedOffsets, &clippedPoints);
+
+   size_t cellCount = (size_t)tpmesh->vertices.items;
+   size_t entryCount = (size_t)offsets[cellCount];
+
+   cells.offsets.assign(offsets, offsets + cellCount + 1);
+   cells.vertices.assign(vertices, vertices + entryCount);
+   cells.neighbors.assign(neighbors, neighbors + entryCount);
+   cells.areas.assign(areas, areas + cellCount);
+
+   if (clippedOffsets)
+   {
+      cells.clippedOffsets.assign(clippedOffsets, clippedOffsets + cellCount + 1);
+      cells.clippedPoints.resize(clippedOffsets[cellCount]);
+
+      for (size_t i = 0; i < cells.clippedPoints.size(); ++i)
+      {
+         cells.clippedPoints[i] = Point(clippedPoints[2 * i], clippedPoints[2 * i + 1]);
+      }
+   }
+
+   // allocated by TriLib's trimalloc()
+   free(offsets);
+   free(vertices);
+   free(neighbors);
+   free(areas);
+   free(clippedOffsets);
+   free(clippedPoints);
+
+   return cells;
 }
 
 
@@ -854,10 +2478,31 @@ void Delaunay::invokeTriLib(std::string& triswitches)
 
    m_in = new triangulateio;
    TP_INPUT();
+
+   m_weightedMesh = false;
+
+   if (!m_pointWeights.empty())
+   {
+      // as in TriLib, a regular triangulation cannot be constrained or refined
+      if (m_pointWeights.size() != m_pointList.size())
+      {
+         std::cerr << "WARNING: point weights ignored, their count doesn't match the count of points!\n";
+      }
+      else if (!m_segmentList.empty() || !m_holeRingSegments.empty() || !m_holesList.empty() ||
+               triswitches.find("q") != std::string::npos)
+      {
+         std::cerr << "WARNING: point weights ignored, not supported with segments, holes or quality constraints!\n";
+      }
+      else
+      {
+         m_weightedMesh = true;
+         triswitches.append("w"); // regular triangulation, the weights are the first point attribute
+      }
+   }
    
    initTriangleInputData(pin, m_pointList);
 
-   if (!m_segmentList.empty()) // OPEN:: a separate option to enable segment constraitns???
+   if (!m_segmentList.empty() || !m_holeRingSegments.empty()) // OPEN:: a separate option to enable segment constraitns???
    {
       pin->numberofsegments = (int)m_segmentList.size() / 2;
       pin->segmentlist = m_segmentList.data();
@@ -880,7 +2525,7 @@ void Delaunay::invokeTriLib(std::string& triswitches)
       pin->numberofholes = (int)m_holesList.size();
       pin->holelist = static_cast<double*>((void*)(&m_holesList[0]));
 
-      if (m_segmentList.empty())
+      if (m_segmentList.empty() && m_holeRingSegments.empty())
       {
          triswitches.append("p"); // constrained Delaunay (Planar Straight Line Graph)
          triswitches.append("B"); // but no boundary info at the moment!
@@ -892,11 +2537,31 @@ void Delaunay::invokeTriLib(std::string& triswitches)
       }
    }
   
-   if (!m_regionsConstrList.empty() && triswitches.find("q") != std::string::npos)
+   if (!m_regionsConstrList.empty())
    {
+      // the regional attribute of the triangles is the region's index + 1, 0 = no region
+      m_regionLabelList.clear();
+      m_regionLabelList.reserve(4 * m_regionsConstrList.size());
+
+      for (size_t i = 0; i < m_regionsConstrList.size(); ++i)
+      {
+         const Point4& region = m_regionsConstrList[i];
+         m_regionLabelList.insert(m_regionLabelList.end(), { region[0], region[1], double(i + 1), region[3] });
+      }
+
       pin->numberofregions = (int)m_regionsConstrList.size();
-      pin->regionlist = static_cast<double*>((void*)(&m_regionsConstrList[0]));
-      triswitches.append("a");
+      pin->regionlist = m_regionLabelList.data();
+      triswitches.append("A");
+
+      if (triswitches.find("q") != std::string::npos)
+      {
+         triswitches.append("a");
+      }
+   }
+
+   if (m_userTestCall && triswitches.find("q") != std::string::npos)
+   {
+      triswitches.append("u"); // user-defined triangle test, only used with quality constraints
    }
 
    TRACE2s(" -- switches:", triswitches.c_str());
@@ -912,19 +2577,80 @@ void Delaunay::invokeTriLib(std::string& triswitches)
    TP_MESH_BEHAVIOR_WRAP();
 
    pTriangleWrap->parsecommandline(1, &pTriswitches, tpbehavior);
+   tpbehavior->threads = resolveThreadCount(m_threadCount);
+
+   if (tpbehavior->weighted)
+   {
+      // only the incremental algorithm inserts weighted vertices
+      tpbehavior->incremental = 1;
+      tpbehavior->sweepline = 0;
+   }
+
+   if (tpbehavior->usertest)
+   {
+      tpbehavior->usertestfunc = m_userTestCall;
+      tpbehavior->usertestcontext = m_userTest.get();
+   }
+
+   if (tpbehavior->quality && !m_sizingFieldAreas.empty())
+   {
+      tpbehavior->sizingfield.xmin = m_sizingField.originX;
+      tpbehavior->sizingfield.ymin = m_sizingField.originY;
+      tpbehavior->sizingfield.cellsize = m_sizingField.cellSize;
+      tpbehavior->sizingfield.columns = m_sizingField.columns;
+      tpbehavior->sizingfield.rows = m_sizingField.rows;
+      tpbehavior->sizingfield.areas = m_sizingFieldAreas.data();
+   }
 
    // initialize data structs
    pTriangleWrap->triangleinit(tpmesh);
+
+   if (m_hasRefinementBudget && m_refinementBudget.maxSteinerPoints >= 0)
+   {
+      tpbehavior->steiner = m_refinementBudget.maxSteinerPoints; // as with the -S switch
+   }
+
    tpmesh->steinerleft = tpbehavior->steiner;
 
-   pTriangleWrap->transfernodes(
-         tpmesh, tpbehavior, pin->pointlist,
-         pin->pointattributelist,
-         pin->pointmarkerlist, pin->numberofpoints,
-         pin->numberofpointattributes);
+   computeVertexPermutation();
+
+   if (m_vertexPermutation.empty())
+   {
+      pTriangleWrap->transfernodes(
+            tpmesh, tpbehavior, pin->pointlist,
+            pin->pointattributelist,
+            pin->pointmarkerlist, pin->numberofpoints,
+            pin->numberofpointattributes);
+   }
+   else
+   {
+      // place the vertex records in the pool in spatial order
+      int attrCount = pin->numberofpointattributes;
+      std::vector<double> orderedCoords(2 * m_vertexPermutation.size());
+      std::vector<double> orderedAttrs(attrCount * m_vertexPermutation.size());
+
+      for (size_t i = 0; i < m_vertexPermutation.size(); ++i)
+      {
+         int inputIdx = m_vertexPermutation[i];
+
+         orderedCoords[2 * i] = pin->pointlist[2 * inputIdx];
+         orderedCoords[2 * i + 1] = pin->pointlist[2 * inputIdx + 1];
+
+         for (int j = 0; j < attrCount; ++j)
+         {
+            orderedAttrs[attrCount * i + j] = pin->pointattributelist[attrCount * inputIdx + j];
+         }
+      }
+
+      pTriangleWrap->transfernodes(
+            tpmesh, tpbehavior, orderedCoords.data(),
+            attrCount ? orderedAttrs.data() : nullptr,
+            pin->pointmarkerlist, pin->numberofpoints,
+            attrCount);
+   }
 
    // MAIN work: triangulate!
-   tpmesh->hullsize = pTriangleWrap->delaunay(tpmesh, tpbehavior);
+   tpmesh->hullsize = triangulateInputPoints();
 
    // OPEN TODO:: 
    //    if(concave hull) - compute concave hull with the chi-algorithm,
@@ -944,8 +2670,14 @@ void Delaunay::invokeTriLib(std::string& triswitches)
       if (!tpbehavior->refine)
       {
          // Insert PSLG segments and/or convex hull segments.
-         pTriangleWrap->formskeleton(tpmesh, tpbehavior, pin->segmentlist,
-                                     pin->segmentmarkerlist, pin->numberofsegments);
+         std::vector<int> segmentMarkers;
+         std::vector<int> segments = skeletonSegments(segmentMarkers);
+         tpbehavior->segmenthints = m_segmentBatchInsertion;
+         tpbehavior->holeringmark = segmentMarkers.empty() ? 0 : HoleRingMarker;
+
+         pTriangleWrap->formskeleton(tpmesh, tpbehavior, segments.empty() ? nullptr : segments.data(),
+                                     segmentMarkers.empty() ? nullptr : segmentMarkers.data(), 
+                                     (int)segments.size() / 2);
       }
    }
 
@@ -968,13 +2700,16 @@ void Delaunay::invokeTriLib(std::string& triswitches)
    if (tpbehavior->quality && (tpmesh->triangles.items > 0))
    {
       // Enforce angle and area constraints
-      pTriangleWrap->enforcequality(tpmesh, tpbehavior);
+      enforceQualityConstraints();
    }
 
    // Calculate the number of edges.
    tpmesh->edges = (3l * tpmesh->triangles.items + tpmesh->hullsize) / 2l;
 
    pTriangleWrap->numbernodes(tpmesh, tpbehavior);
+   // transfernodes() put the input vertices into the first slots of the vertex pool, as permuted
+   remapInputVertexMarks();
+
    TRACE2i("<- Triangulate: triangles= ", tpmesh->triangles.items);
 
    m_triangulated = true;
@@ -1063,26 +2798,128 @@ void Delaunay::freeTriangleDataStructs()
 
    //struct triangulateio* pin = (struct triangulateio*) m_in;
 
+   freeVoronoi();
+
    TP_MESH_BEHAVIOR_WRAP();
    TP_INPUT();
-   TP_VOROUT();
 
    pTriangleWrap->triangledeinit(tpmesh, tpbehavior);
 
    delete tpmesh;
    delete tpbehavior;
    delete pin;
-   delete tpvorout;
    delete pTriangleWrap;
 
    m_in = nullptr;
-   m_vorout = nullptr;
    m_triangleWrap = nullptr;
    m_pmesh = nullptr;
    m_pbehavior = nullptr;
 }
 
 
+bool Delaunay::buildVoronoi()
+{
+   if (m_vorout != nullptr)
+   {
+      return true;
+   }
+
+   if (!m_triangulated)
+   {
+      return false;
+   }
+
+   TP_MESH_BEHAVIOR_WRAP();
+
+   m_vorout = new triangulateio;
+   TP_VOROUT();
+
+   tpvorout->numberofpoints = tpmesh->triangles.items;
+   tpvorout->numberofpointattributes = 0;
+   tpvorout->numberofedges = 0; // counted by TriLib
+
+   tpvorout->pointlist = nullptr;
+   tpvorout->pointattributelist = nullptr;
+   tpvorout->pointmarkerlist = nullptr;
+   tpvorout->numberofsegments = 0;
+   tpvorout->numberofholes = 0;
+   tpvorout->numberofregions = 0;
+   tpvorout->regionlist = nullptr;
+   tpvorout->edgelist = nullptr;
+   tpvorout->edgemarkerlist = nullptr;
+   tpvorout->normlist = nullptr;
+
+   // circumcenters and dual edges of the current mesh, no re-triangulation needed
+   int threadCount = resolveThreadCount(m_threadCount);
+   int* sitelist = nullptr;
+
+   tpbehavior->threads = threadCount;
+   tpvorout->numberofedges = (int)pTriangleWrap->buildvoronoi(tpmesh, tpbehavior, &tpvorout->pointlist, &tpvorout->edgelist, &tpvorout->normlist, 
+                               &sitelist);
+
+   // typed copies, TriLib's flat lists aren't kept
+   long pointCount = tpvorout->numberofpoints;
+   long edgeCount = tpvorout->numberofedges;
+
+   m_voronoiPoints.resize(pointCount);
+   m_voronoiEdges.resize(edgeCount);
+   m_voronoiRays.resize(edgeCount);
+   m_voronoiEdgeSites.resize(edgeCount);
+
+   parallelFor(std::max(pointCount, edgeCount), threadCount, [&](long first, long last)
+   {
+      for (long i = first; i < std::min(last, pointCount); ++i)
+      {
+         m_voronoiPoints[i] = Point(tpvorout->pointlist[2 * i], tpvorout->pointlist[2 * i + 1]);
+      }
+
+      for (long i = first; i < std::min(last, edgeCount); ++i)
+      {
+         m_voronoiEdges[i] = { tpvorout->edgelist[2 * i], tpvorout->edgelist[2 * i + 1] };
+         m_voronoiRays[i] = Point(tpvorout->normlist[2 * i], tpvorout->normlist[2 * i + 1]);
+         m_voronoiEdgeSites[i] = { sitelist[2 * i], sitelist[2 * i + 1] };
+      }
+   });
+
+   // allocated by TriLib's trimalloc()
+   free(tpvorout->pointlist);
+   free(tpvorout->edgelist);
+   free(tpvorout->normlist);
+   free(sitelist);
+
+   tpvorout->pointlist = nullptr;
+   tpvorout->edgelist = nullptr;
+   tpvorout->normlist = nullptr;
+
+   return true;
+}
+
+
+void Delaunay::freeVoronoi()
+{
+   if (m_vorout == nullptr)
+   {
+      return;
+   }
+
+   TP_VOROUT();
+
+   // allocated by TriLib's trimalloc()
+   free(tpvorout->pointlist);
+   free(tpvorout->pointattributelist);
+   free(tpvorout->edgelist);
+   free(tpvorout->normlist);
+
+   delete tpvorout;
+   m_vorout = nullptr;
+
+   m_voronoiPoints.clear();
+   m_voronoiEdges.clear();
+   m_voronoiRays.clear();
+   m_voronoiEdgeSites.clear();
+}
+
+
 void Delaunay::initTriangleDataForPoints()
 {
     Assert(!m_triangleWrap && !m_pmesh && !m_pbehavior, "Expected empty instance!");
@@ -1111,10 +2948,28 @@ void Delaunay::initTriangleDataForPoints()
 void Delaunay::initTriangleInputData(triangulateio* pin, const std::vector<Point>& points) /*const*/
 {
     pin->numberofpoints = (int)points.size();
-    pin->numberofpointattributes = m_extraVertexAttr ? 1 : 0;
+    pin->numberofpointattributes = (m_weightedMesh ? 1 : 0) + (m_extraVertexAttr ? 1 : 0);
     pin->pointlist = static_cast<double*>((void*)(&points[0]));
 
-    if (m_extraVertexAttr)
+    if (m_weightedMesh)
+    {
+       // TriLib expects the weight as first attribute, the mesh index follows
+       m_defaultExtraAttrs.clear();
+       m_defaultExtraAttrs.reserve(pin->numberofpointattributes * points.size());
+
+       for (double weight : m_pointWeights)
+       {
+          m_defaultExtraAttrs.push_back(weight);
+
+          if (m_extraVertexAttr)
+          {
+             m_defaultExtraAttrs.push_back(-1.0);
+          }
+       }
+
+       pin->pointattributelist = m_defaultExtraAttrs.data();
+    }
+    else if (m_extraVertexAttr)
     {       
        m_defaultExtraAttrs.clear();
        m_defaultExtraAttrs.insert(m_defaultExtraAttrs.begin(), points.size(), -1.0);
@@ -1134,70 +2989,55 @@ void Delaunay::initTriangleInputData(triangulateio* pin, const std::vector<Point
 }
 
 
-void Delaunay::sanitizeInputData(std::unordered_map<int, int> duplicatePointsMap, DebugOutputLevel traceLvl)
+void Delaunay::applyPointRemap(const std::vector<int>& pointRemap, DebugOutputLevel traceLvl)
 {
-    // don't use duplicated points in segment definitions
-    //  - replace with "originals"
-   
-    if (traceLvl != None)
-    {
-        printf("Warning:  %d duplicate vertexes found - trying to sanitize input data!\n", duplicatePointsMap.size());
-    }
-
-    for (size_t i = 0; i < m_segmentList.size(); ++i)
-    {
-        auto& pointIdx = m_segmentList[i];
-        auto iter = duplicatePointsMap.find(pointIdx);
-
-        if (iter != duplicatePointsMap.end())
-        {
-            TRACE2i(" -- sanitize: duplicate point as segment endpoint detected, index=", pointIdx);
-            TRACE2i(" --           replaced with index=", iter->second);
+   // the kept points were numbered in input order, thus compact the list in place, a merged point 
+   // keeps the weight of its first occurrence
+   size_t keptCount = 0;
+   bool withWeights = m_pointWeights.size() == m_pointList.size();
 
-            if (traceLvl != None)
-            {
-                printf("Warning:  segments[%zd] - a duplicate vertex (index=%d) replaced by original (index=%d).\n",
-                    i / 2, pointIdx, iter->second);
-            }
+   for (size_t i = 0; i < m_pointList.size(); ++i)
+   {
+      if (pointRemap[i] == (int)keptCount)
+      {
+         if (withWeights)
+         {
+            m_pointWeights[keptCount] = m_pointWeights[i];
+         }
+         m_pointList[keptCount++] = m_pointList[i];
+      }
+      else if (traceLvl != None)
+      {
+         printf("Warning:  A duplicate vertex point at index=%zd merged into vertex point at new index=%d.\n",
+                i, pointRemap[i]);
+      }
+   }
 
-            pointIdx = iter->second;
-        }
-    }
+   m_pointList.resize(keptCount);
+   invalidatePointIndex();
 
-    // remove point duplicates
-    std::vector<int> duplicatePts(duplicatePointsMap.size());
-    std::transform(duplicatePointsMap.begin(), duplicatePointsMap.end(), duplicatePts.begin(), [](auto& pair) { return pair.first; });
-    std::sort(duplicatePts.begin(), duplicatePts.end());
+   if (withWeights)
+   {
+      m_pointWeights.resize(keptCount);
+   }
 
-    for (auto iter = duplicatePts.rbegin(); iter != duplicatePts.rend(); ++iter)
-    {
-        m_pointList.erase(m_pointList.begin() + *iter);
+   for (size_t i = 0; i < m_segmentList.size(); ++i)
+   {
+      auto& pointIdx = m_segmentList[i];
 
-        if (traceLvl != None)
-        {
-            printf("Warning:  A duplicate vertex point deleted at index=%d.\n", *iter);
-        }
-    }
+      if (traceLvl != None && pointRemap[pointIdx] != pointIdx)
+      {
+         printf("Warning:  segments[%zd] - endpoint index=%d replaced by index=%d.\n",
+                i / 2, pointIdx, pointRemap[pointIdx]);
+      }
 
-    // corrections for removed points
-    for (auto& pointIdx : m_segmentList)
-    {
-        int i = 0;
-        for (auto iter = duplicatePts.rbegin(); iter != duplicatePts.rend(); ++iter, ++i)
-        {
-            if (pointIdx > *iter)
-            {
-                if (traceLvl != None)
-                {
-                    printf("Warning:  Correction for segment endpoint - iter=%d pointIdx=%d, new_pointIdx=%zd.\n",
-                        *iter, pointIdx, pointIdx - (duplicatePts.size() - i));
-                }
+      pointIdx = pointRemap[pointIdx];
+   }
 
-                pointIdx -= (duplicatePts.size() - i);  // OPEN TODO:: warning !!!
-                break;
-            }
-        }
-    }
+   for (auto& pointIdx : m_holeRingSegments)
+   {
+      pointIdx = pointRemap[pointIdx];
+   }
 }
 
 
@@ -1275,98 +3115,265 @@ void Delaunay::readSegmentsFromMesh(std::vector<int>& segmentEndpoints) const
         }
 #endif
 
-        subsegloop.ss = pTriangleWrap->subsegtraverse(tpmesh);
-        subsegnumber++;
-    }
+        subsegloop.ss = pTriangleWrap->subsegtraverse(tpmesh);
+        subsegnumber++;
+    }
+}
+
+
+void Delaunay::readHolesFromFile(
+        char* polyfileName, 
+        FILE* polyfile,
+        std::vector<Point>& holeMarkers, 
+        std::vector<Point4>& regionConstr) const
+{
+   TP_MESH_BEHAVIOR_WRAP();
+
+   REAL* holearray = nullptr;
+   REAL* regionarray = nullptr;
+
+   holeMarkers.clear();
+
+   // read also the regions!
+   int regionattrib = tpbehavior->regionattrib;
+   tpbehavior->regionattrib = 1;   
+   int regionCt = -1;
+
+   try
+   {
+      pTriangleWrap->readholes(tpmesh, tpbehavior, polyfile, polyfileName,
+                               &holearray, &tpmesh->holes, &regionarray, &regionCt);
+      tpmesh->regions = regionCt;
+   }
+   catch (...)
+   {     
+      // maybe no regions in file ???
+      if (regionCt == -1)
+      {
+         tpmesh->regions = 0;
+      }
+      else
+      {
+         // real parsing problem
+         throw;
+      }      
+   }
+
+   tpbehavior->regionattrib = regionattrib;
+
+   for (int i = 0; i < 2 * tpmesh->holes; i += 2)
+   {
+      holeMarkers.emplace_back(holearray[i], holearray[i + 1]);
+   }
+
+   if (tpmesh->holes > 0)
+   {
+      pTriangleWrap->trifree((VOID*)holearray);
+   }
+
+   regionConstr.clear();
+
+   for (int i = 0; i < 4 * tpmesh->regions; i += 4)
+   {
+      double arr[] = { regionarray[i], regionarray[i + 1], regionarray[i + 2],  regionarray[i + 3] };
+      regionConstr.emplace_back(arr);
+   }
+
+   if (tpmesh->regions > 0)
+   {
+      pTriangleWrap->trifree((VOID*)regionarray);
+   }
+}
+
+
+bool Delaunay::appendPolyline(const std::vector<Point>& polyline, bool closed, std::vector<int>& segments)
+{
+   size_t oldSize = segments.size();
+   size_t pointCount = polyline.size();
+
+   if (closed && pointCount > 2 && polyline.front() != polyline.back())
+   {
+      ++pointCount; // connect the last point to the first one
+   }
+
+   for (size_t i = 1; i < pointCount; ++i)
+   {
+      int startIdx = findPointIndex(polyline[i - 1]);
+      int endIdx = findPointIndex(polyline[i % polyline.size()]);
+
+      if (startIdx < 0 || endIdx < 0)
+      {
+         segments.resize(oldSize);
+         return false;
+      }
+
+      segments.push_back(startIdx);
+      segments.push_back(endIdx);
+   }
+
+   return true;
+}
+
+
+int Delaunay::findPointIndex(const Point& pt)
+{
+   updatePointIndex();
+
+   if (m_pointIndex.empty())
+   {
+      return -1;
+   }
+
+   return m_pointIndex[findPointSlot(pt)];
 }
 
 
-void Delaunay::readHolesFromFile(
-        char* polyfileName, 
-        FILE* polyfile,
-        std::vector<Point>& holeMarkers, 
-        std::vector<Point4>& regionConstr) const
+size_t Delaunay::findPointSlot(const Point& pt) const
 {
-   TP_MESH_BEHAVIOR_WRAP();
+   size_t mask = m_pointIndex.size() - 1;
+   size_t slot = (size_t)mixBits(mixBits(coordinateBits(pt[0])) ^ coordinateBits(pt[1])) & mask;
 
-   REAL* holearray = nullptr;
-   REAL* regionarray = nullptr;
+   while (m_pointIndex[slot] >= 0 && m_pointList[m_pointIndex[slot]] != pt)
+   {
+      slot = (slot + 1) & mask;
+   }
 
-   holeMarkers.clear();
+   return slot;
+}
 
-   // read also the regions!
-   int regionattrib = tpbehavior->regionattrib;
-   tpbehavior->regionattrib = 1;   
-   int regionCt = -1;
 
-   try
+void Delaunay::updatePointIndex()
+{
+   // points appended since the last call are added to the index, at most half of the slots are used
+   size_t pointCount = m_pointList.size();
+
+   if (m_indexedPointCount == pointCount)
    {
-      pTriangleWrap->readholes(tpmesh, tpbehavior, polyfile, polyfileName,
-                               &holearray, &tpmesh->holes, &regionarray, &regionCt);
-      tpmesh->regions = regionCt;
+      return;
    }
-   catch (...)
-   {     
-      // maybe no regions in file ???
-      if (regionCt == -1)
+
+   if (m_indexedPointCount == 0 || m_indexedPointCount > pointCount || m_pointIndex.size() < 2 * pointCount)
+   {
+      size_t tableSize = 16;
+      while (tableSize < 2 * pointCount)
       {
-         tpmesh->regions = 0;
+         tableSize *= 2;
       }
-      else
+
+      m_pointIndex.assign(tableSize, -1);
+      m_indexedPointCount = 0;
+   }
+
+   for (size_t i = m_indexedPointCount; i < pointCount; ++i)
+   {
+      size_t slot = findPointSlot(m_pointList[i]);
+
+      if (m_pointIndex[slot] < 0)
       {
-         // real parsing problem
-         throw;
-      }      
+         m_pointIndex[slot] = (int)i; // keep the first one of duplicates
+      }
    }
 
-   tpbehavior->regionattrib = regionattrib;
+   m_indexedPointCount = pointCount;
+}
 
-   for (int i = 0; i < 2 * tpmesh->holes; i += 2)
+
+int Delaunay::findDuplicatePoints(double tolerance, std::vector<int>& pointRemap) const
+{
+   // Hashed grid of the kept points with cells of the tolerance's size, or with one cell for each 
+   // position if looking for exact duplicates. Open addressing, at most half of the slots are used.
+   typedef std::pair<int64_t, int64_t> CellKey;
+
+   size_t pointCount = m_pointList.size();
+   size_t tableSize = 16;
+   while (tableSize < 2 * pointCount)
    {
-      holeMarkers.emplace_back(holearray[i], holearray[i + 1]);
+      tableSize *= 2;
    }
 
-   if (tpmesh->holes > 0)
+   std::vector<CellKey> cellKeys(tableSize);
+   std::vector<int> cellHeads(tableSize, -1); // last kept point in the cell, -1 = free slot
+   std::vector<int> nextInCell(pointCount, -1);
+
+   auto cellOf = [tolerance](const Point& pt)
    {
-      pTriangleWrap->trifree((VOID*)holearray);
-   }
+      if (tolerance > 0)
+      {
+         const double limit = 9e18; // keep it in the range of int64_t
+         return CellKey((int64_t)std::max(-limit, std::min(limit, std::floor(pt[0] / tolerance))),
+                        (int64_t)std::max(-limit, std::min(limit, std::floor(pt[1] / tolerance))));
+      }
 
-   regionConstr.clear();
+      return CellKey((int64_t)coordinateBits(pt[0]), (int64_t)coordinateBits(pt[1]));
+   };
 
-   for (int i = 0; i < 4 * tpmesh->regions; i += 4)
+   auto findSlot = [&](const CellKey& key)
    {
-      double arr[] = { regionarray[i], regionarray[i + 1], regionarray[i + 2],  regionarray[i + 3] };
-      regionConstr.emplace_back(arr);
-   }
+      size_t slot = (size_t)mixBits(mixBits((uint64_t)key.first) ^ (uint64_t)key.second) & (tableSize - 1);
 
-   if (tpmesh->regions > 0)
+      while (cellHeads[slot] >= 0 && cellKeys[slot] != key)
+      {
+         slot = (slot + 1) & (tableSize - 1);
+      }
+
+      return slot;
+   };
+
+   double toleranceSquare = tolerance * tolerance;
+   int keptCount = 0;
+   int mergedCount = 0;
+
+   pointRemap.assign(pointCount, -1);
+
+   for (size_t i = 0; i < pointCount; ++i)
    {
-      pTriangleWrap->trifree((VOID*)regionarray);
-   }
-}
+      const Point& pt = m_pointList[i];
+      CellKey key = cellOf(pt);
+      int match = -1;
 
+      if (tolerance > 0)
+      {
+         // the first kept point within the tolerance
+         for (int dx = -1; dx <= 1; ++dx)
+         {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+               size_t slot = findSlot(CellKey(key.first + dx, key.second + dy));
+
+               for (int k = cellHeads[slot]; k >= 0; k = nextInCell[k])
+               {
+                  double distX = m_pointList[k][0] - pt[0];
+                  double distY = m_pointList[k][1] - pt[1];
+
+                  if (distX * distX + distY * distY <= toleranceSquare && (match < 0 || k < match))
+                  {
+                     match = k;
+                  }
+               }
+            }
+         }
+      }
+      else
+      {
+         match = cellHeads[findSlot(key)];
+      }
 
-std::unordered_map<int, int> Delaunay::checkForDuplicatePoints() const
-{
-    std::unordered_map<Delaunay::Point, size_t> uniqueMap;
-    std::unordered_map<int, int> duplicateMap;
+      if (match >= 0)
+      {
+         pointRemap[i] = pointRemap[match];
+         ++mergedCount;
+         continue;
+      }
 
-    for (size_t i = 0; i < m_pointList.size(); ++i)
-    {
-        auto& point = m_pointList[i];
+      pointRemap[i] = keptCount++;
 
-        auto iter = uniqueMap.find(point);
-        if (iter == uniqueMap.end())
-        {
-            uniqueMap.insert({ point, i });
-        }
-        else
-        {
-            duplicateMap.insert({ i, iter->second });  // OPEN TODO:: warning !!!
-        }
-    }
+      size_t slot = findSlot(key);
+      cellKeys[slot] = key;
+      nextInCell[i] = cellHeads[slot];
+      cellHeads[slot] = (int)i;
+   }
 
-    return duplicateMap;    
+   return mergedCount;
 }
 
 
@@ -1493,6 +3500,282 @@ int Delaunay::GetFirstIndexNumber() const
 }
 
 
+void Delaunay::setUserTest(UserTestCall call, std::shared_ptr<void> userTest)
+{
+   m_userTestCall = call;
+   m_userTest = std::move(userTest);
+}
+
+
+void Delaunay::enforceQualityConstraints()
+{
+   TP_MESH_BEHAVIOR_WRAP();
+
+   if (!m_hasRefinementBudget)
+   {
+      // e.g. a refine() after the budget was removed
+      tpbehavior->worstfirst = 0;
+      pTriangleWrap->enforcequality(tpmesh, tpbehavior);
+      return;
+   }
+
+   RefinementBudgetCheck budgetCheck;
+   budgetCheck.budget = &m_refinementBudget;
+   budgetCheck.deadline = std::chrono::steady_clock::now() +
+                          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                             std::chrono::duration<double>(std::min(m_refinementBudget.maxSeconds, 1.0e9)));
+   budgetCheck.nextProgress = m_refinementBudget.progressInterval;
+
+   tpbehavior->worstfirst = m_refinementBudget.worstFirst ? 1 : 0;
+   tpbehavior->refinementcheck = &RefinementBudgetCheck::check;
+   tpbehavior->refinementcontext = &budgetCheck;
+
+   try
+   {
+      pTriangleWrap->enforcequality(tpmesh, tpbehavior);
+   }
+   catch (...)
+   {
+      tpbehavior->refinementcheck = nullptr;
+      tpbehavior->refinementcontext = nullptr;
+      throw;
+   }
+
+   // the check object is gone after return!
+   tpbehavior->refinementcheck = nullptr;
+   tpbehavior->refinementcontext = nullptr;
+}
+
+
+long Delaunay::triangulateInputPoints()
+{
+   TP_MESH_BEHAVIOR_WRAP();
+   BaseTriangulation& base = m_baseTriangulation;
+   const std::vector<double> noWeights;
+   const std::vector<double>& weights = m_weightedMesh ? m_pointWeights : noWeights;
+
+   if (m_cacheBaseTriangulation && !base.corners.empty() && 
+       base.algorithm == m_triAlgorithm && base.ordering == m_vertexOrdering && 
+       base.points == m_pointList && base.weights == weights)
+   {
+      return pTriangleWrap->restoredelaunay(tpmesh, tpbehavior, base.corners.data(), base.neighbors.data(),
+                                            (long)base.corners.size() / 3, base.hullStart, 
+                                            base.undeadVertices.data(), (int)base.undeadVertices.size(), 
+                                            base.hullSize);
+   }
+
+   long hullSize = pTriangleWrap->delaunay(tpmesh, tpbehavior);
+
+   base = BaseTriangulation();
+
+   if (m_cacheBaseTriangulation && tpmesh->triangles.items > 0)
+   {
+      base.points = m_pointList;
+      base.weights = weights;
+      base.algorithm = m_triAlgorithm;
+      base.ordering = m_vertexOrdering;
+      base.corners.resize(3 * tpmesh->triangles.items);
+      base.neighbors.resize(3 * tpmesh->triangles.items);
+      base.undeadVertices.resize(tpmesh->undeads);
+      base.hullStart = pTriangleWrap->savedelaunay(tpmesh, base.corners.data(), base.neighbors.data(),
+                                                   base.undeadVertices.data());
+      base.hullSize = hullSize;
+   }
+
+   return hullSize;
+}
+
+
+void Delaunay::computeVertexPermutation()
+{
+   m_vertexPermutation.clear();
+
+   if (m_vertexOrdering == InputOrder)
+   {
+      return;
+   }
+
+   m_vertexPermutation.resize(m_pointList.size());
+   for (size_t i = 0; i < m_vertexPermutation.size(); ++i)
+   {
+      m_vertexPermutation[i] = (int)i;
+   }
+
+   switch (m_vertexOrdering)
+   {
+   case Lexicographic:
+      std::stable_sort(m_vertexPermutation.begin(), m_vertexPermutation.end(),
+                       [this](int lhs, int rhs) { return OrderPoints()(m_pointList[lhs], m_pointList[rhs]); });
+      break;
+
+   case Hilbert:
+   {
+      double minX, minY, extent;
+      boundingSquare(m_pointList, minX, minY, extent);
+
+      std::vector<uint64_t> keys(m_pointList.size());
+      for (size_t i = 0; i < keys.size(); ++i)
+      {
+         keys[i] = hilbertKey(m_pointList[i][0], m_pointList[i][1], minX, minY, extent);
+      }
+
+      std::stable_sort(m_vertexPermutation.begin(), m_vertexPermutation.end(),
+                       [&keys](int lhs, int rhs) { return keys[lhs] < keys[rhs]; });
+      break;
+   }
+
+   default:
+      Assert(false, "unknown vertex ordering");
+   }
+}
+
+
+std::vector<int> Delaunay::skeletonSegments(std::vector<int>& segmentMarkers) const
+{
+   std::vector<int> segments(m_segmentList);
+   segmentMarkers.clear();
+
+   if (!m_holeRingSegments.empty())
+   {
+      // the hole rings' edges follow the constraints, marked for TriLib's parity flood fill. An edge 
+      // shared by several rings is crossed once for each of them, thus it flips the parity only if
+      // its count is odd!
+      std::vector<std::pair<std::pair<int, int>, int>> ringEdges;
+      ringEdges.reserve(m_holeRingSegments.size() / 2);
+
+      for (size_t i = 0; i < m_holeRingSegments.size(); i += 2)
+      {
+         int end1 = m_holeRingSegments[i];
+         int end2 = m_holeRingSegments[i + 1];
+
+         if (end1 != end2)
+         {
+            ringEdges.push_back({ { std::min(end1, end2), std::max(end1, end2) }, (int)i });
+         }
+      }
+
+      std::sort(ringEdges.begin(), ringEdges.end());
+      segmentMarkers.assign(segments.size() / 2, 0);
+
+      for (size_t i = 0; i < ringEdges.size(); )
+      {
+         size_t next = i + 1;
+         while (next < ringEdges.size() && ringEdges[next].first == ringEdges[i].first)
+         {
+            ++next;
+         }
+
+         segments.push_back(m_holeRingSegments[ringEdges[i].second]);
+         segments.push_back(m_holeRingSegments[ringEdges[i].second + 1]);
+         segmentMarkers.push_back((next - i) % 2 ? HoleRingMarker : 0);
+
+         i = next;
+      }
+   }
+
+   size_t segmentCount = segments.size() / 2;
+
+   if (m_segmentBatchInsertion && segmentCount >= 2)
+   {
+      // batch mode: insert the segments in the order of their midpoints along a Hilbert curve
+      double minX, minY, extent;
+      boundingSquare(m_pointList, minX, minY, extent);
+
+      std::vector<uint64_t> keys(segmentCount, 0);
+      std::vector<int> order(segmentCount);
+
+      for (size_t i = 0; i < segmentCount; ++i)
+      {
+         int end1 = segments[2 * i];
+         int end2 = segments[2 * i + 1];
+         order[i] = (int)i;
+
+         if (end1 >= 0 && end1 < (int)m_pointList.size() && end2 >= 0 && end2 < (int)m_pointList.size())
+         {
+            keys[i] = hilbertKey((m_pointList[end1][0] + m_pointList[end2][0]) / 2,
+                                 (m_pointList[end1][1] + m_pointList[end2][1]) / 2, minX, minY, extent);
+         }
+      }
+
+      std::stable_sort(order.begin(), order.end(), [&keys](int lhs, int rhs) { return keys[lhs] < keys[rhs]; });
+
+      std::vector<int> orderedSegments(segments.size());
+      std::vector<int> orderedMarkers(segmentMarkers.size());
+
+      for (size_t i = 0; i < segmentCount; ++i)
+      {
+         orderedSegments[2 * i] = segments[2 * order[i]];
+         orderedSegments[2 * i + 1] = segments[2 * order[i] + 1];
+
+         if (!segmentMarkers.empty())
+         {
+            orderedMarkers[i] = segmentMarkers[order[i]];
+         }
+      }
+
+      segments.swap(orderedSegments);
+      segmentMarkers.swap(orderedMarkers);
+   }
+
+   // formskeleton() looks up the segment endpoints by their position in the vertex pool, thus 
+   // the input indexes must be mapped through the vertex permutation
+   if (!m_vertexPermutation.empty())
+   {
+      std::vector<int> poolPosition(m_vertexPermutation.size());
+      for (size_t i = 0; i < m_vertexPermutation.size(); ++i)
+      {
+         poolPosition[m_vertexPermutation[i]] = (int)i;
+      }
+
+      for (auto& pointIdx : segments)
+      {
+         if (pointIdx >= 0 && pointIdx < (int)poolPosition.size())
+         {
+            pointIdx = poolPosition[pointIdx];
+         }
+      }
+   }
+
+   return segments;
+}
+
+
+void Delaunay::remapInputVertexMarks()
+{
+   // numbernodes() numbers the vertices in pool order, but the input vertices were 
+   // placed in the pool permuted, i.e. map them back to their input indexes!
+   //  --> transfernodes() allocates the input vertices in the first slots of the fresh vertex pool 
+   //      and only Steiner points are deleted later, thus a vertex's slot is its pool position in 
+   //      m_vertexPermutation. Steiner points keep their numbers.
+
+   if (m_vertexPermutation.empty())
+   {
+      return;
+   }
+
+   TP_MESH_BEHAVIOR_WRAP();
+   Triwrap::__pmesh* m = tpmesh; // needed for Triwrap's macro setvertexmark()
+
+   Triwrap::poolslottable vertexSlots;
+   pTriangleWrap->poolslotinit(&tpmesh->vertices, &vertexSlots);
+
+   pTriangleWrap->traversalinit(&tpmesh->vertices);
+   Triwrap::vertex vertexloop = pTriangleWrap->vertextraverse(tpmesh);
+
+   while (vertexloop != nullptr)
+   {
+      long slot = pTriangleWrap->poolslot(&tpmesh->vertices, &vertexSlots, (VOID*)vertexloop);
+
+      if (slot >= 0 && slot < (long)m_vertexPermutation.size())
+      {
+         setvertexmark(vertexloop, m_vertexPermutation[slot] + tpbehavior->firstnumber);
+      }
+
+      vertexloop = pTriangleWrap->vertextraverse(tpmesh);
+   }
+}
+
+
 //  Iterators and Mesh methods
 
 typedef Triwrap::vertex   vertex;
@@ -1510,15 +3793,21 @@ FaceIterator::FaceIterator(Delaunay* triangulator)
    : m_delaunay(triangulator),
      meshPointCount(0)
 {
+   static_assert(sizeof(tpath) == sizeof(Triwrap::__traversal), "mirrors TriLib's traversal position");
    floop.tri = nullptr;
 
    TP_MESH_WRAP_ITER();
-   TP_PLOOP_ITER();
+   TP_PATH_ITER(fpath);
 
-   pTriangleWrap->traversalinit(&(tpmesh->triangles));
+   // the position is kept in the iterator, not in the mesh
+   pTriangleWrap->pathinit(&(tpmesh->triangles), ppath);
 
-   ploop->tri = pTriangleWrap->triangletraverse(tpmesh);
-   ploop->orient = 0;
+   // set through floop, not ploop: the loop's end test reads floop, which the compiler may assume 
+   // not to alias with the ploop pointer once operator++() is inlined!
+   floop.tri = (double***)pTriangleWrap->trianglepathtraverse(tpmesh, ppath);
+   floop.orient = 0;
+
+   TP_PATH_STORE(fpath);
 }
 
 
@@ -1527,9 +3816,17 @@ FaceIterator& FaceIterator::operator++()
    // cout << "++ called\n";
 
    TP_MESH_WRAP_ITER();   
-   TP_PLOOP_ITER();
+   TP_PATH_ITER(fpath);
 
-   ploop->tri = pTriangleWrap->triangletraverse(tpmesh);
+   if (!fpath.pathblock)
+   {
+      // not from fbegin() but e.g. from TriangulationMesh::Sym(), nothing to traverse
+      floop.tri = nullptr;
+      return *this;
+   }
+
+   floop.tri = (double***)pTriangleWrap->trianglepathtraverse(tpmesh, ppath);
+   TP_PATH_STORE(fpath);
 
    // cout << "tri val = " << ploop->tri << endl;
 
@@ -1663,6 +3960,23 @@ double FaceIterator::area() const
 }
 
 
+int FaceIterator::regionId() const
+{
+   TP_MESH_ITER();
+   TP_BEHAVIOR_ITER();
+   TP_PLOOP_ITER();
+
+   if (!tpbehavior->regionattrib || tpmesh->eextras < 1)
+   {
+      return -1;
+   }
+
+   // the regional attribute is the last one
+   double label = ((double*)ploop->tri)[tpmesh->elemattribindex + tpmesh->eextras - 1];
+   return (int)label - 1;
+}
+
+
 int FaceIterator::getVertexIndex(/*Triwrap::vertex*/ double* vertexptr) const
 {
    // OPEN TODO: compile test type check - Triwrap::vertex == double* ???
@@ -1689,26 +4003,31 @@ int FaceIterator::getMeshVertexIndex(/*Triwrap::vertex*/ double* vertexptr) cons
 
    Assert(meshPointCount >= 0, "");
 
+   TP_MESH_ITER();
+
+   // the mesh index is the last attribute, after the weight in regular triangulations
+   double& meshIndex = vertexptr[1 + tpmesh->nextras];
+
    if (getVertexIndex(vertexptr) >= 0)
    {
       // extra attr. initialized to -1!
-      if ((vertexptr)[2] < 0)
+      if (meshIndex < 0)
       {
-         (vertexptr)[2] = meshPointCount++;
+         meshIndex = meshPointCount++;
       }
    }
    else
    {
       // extra attr. initialized to -1!
-      if ((vertexptr)[2] < 0)
+      if (meshIndex < 0)
       {
-         Assert((vertexptr)[2] == -1.00, "");
+         Assert(meshIndex == -1.00, "");
 
-         (vertexptr)[2] = meshPointCount++;
+         meshIndex = meshPointCount++;
       }
    }
 
-   int idx = (vertexptr)[2];  // OPEN TODO:: warning !!!
+   int idx = meshIndex;  // OPEN TODO:: warning !!!
    Assert(idx >= 0, "");
 
    return idx;
@@ -1743,11 +4062,14 @@ VertexIterator::VertexIterator(Delaunay* triangulator)
 {
    m_delaunay = triangulator;
 
+   static_assert(sizeof(tpath) == sizeof(Triwrap::__traversal), "mirrors TriLib's traversal position");
+
    TP_MESH_WRAP_ITER();
    TP_BEHAVIOR_ITER();
+   TP_PATH_ITER(vpath);
 
-   pTriangleWrap->traversalinit(&(tpmesh->vertices));
-   vloop = pTriangleWrap->vertextraverse(tpmesh);
+   pTriangleWrap->pathinit(&(tpmesh->vertices), ppath);
+   vloop = pTriangleWrap->vertexpathtraverse(tpmesh, ppath);
 
    while
       (
@@ -1756,8 +4078,10 @@ VertexIterator::VertexIterator(Delaunay* triangulator)
             ((int*)vloop)[tpmesh->vertexmarkindex + 1] == UNDEADVERTEX)
          )
    {
-      vloop = (void*)pTriangleWrap->vertextraverse(tpmesh);
+      vloop = (void*)pTriangleWrap->vertexpathtraverse(tpmesh, ppath);
    }
+
+   TP_PATH_STORE(vpath);
 }
 
 
@@ -1765,6 +4089,7 @@ VertexIterator VertexIterator::operator++()
 {
    TP_MESH_WRAP_ITER();
    TP_BEHAVIOR_ITER();
+   TP_PATH_ITER(vpath);
 
    while
       (
@@ -1773,14 +4098,16 @@ VertexIterator VertexIterator::operator++()
             ((int*)vloop)[tpmesh->vertexmarkindex + 1] == UNDEADVERTEX)
          )
    {
-      vloop = (void*)pTriangleWrap->vertextraverse(tpmesh);
+      vloop = (void*)pTriangleWrap->vertexpathtraverse(tpmesh, ppath);
    }
 
-   vloop = (void*)pTriangleWrap->vertextraverse(tpmesh);
+   vloop = (void*)pTriangleWrap->vertexpathtraverse(tpmesh, ppath);
+   TP_PATH_STORE(vpath);
 
    VertexIterator vit;
    vit.vloop = vloop;
    vit.m_delaunay = m_delaunay;
+   vit.vpath = vpath;
 
    return vit;
 }
@@ -1843,14 +4170,13 @@ VoronoiVertexIterator::VoronoiVertexIterator()
 VoronoiVertexIterator::VoronoiVertexIterator(Delaunay* triangulator) 
 {
    m_delaunay = triangulator;
-   triangulateio* pvorout = (struct triangulateio*)triangulator->m_vorout;
 
    // TEST::: I hope so!
    Assert(triangulator->GetFirstIndexNumber() == 0, "");
 
-   vvloop = pvorout->pointlist;
    vvindex = 0;
-   vvcount = pvorout->numberofpoints;
+   vvcount = (int)triangulator->m_voronoiPoints.size();
+   vvloop = vvcount > 0 ? triangulator->m_voronoiPoints.data() : nullptr;
 }
 
 
@@ -1869,21 +4195,16 @@ VoronoiVertexIterator VoronoiVertexIterator::operator++()
 
 Delaunay::Point& VoronoiVertexIterator::operator*() const 
 {
-   Delaunay::Point::NT* pointlist = (Delaunay::Point::NT*)vvloop;
-
-   // UB! -> but also in original code...  OPEN TODO::: !!!
-   return *((Delaunay::Point*)(pointlist + vvindex));
+   // typed copy of TriLib's point list, @see Delaunay::voronoiPoints()
+   return ((Delaunay::Point*)vvloop)[vvindex];
 }
 
 
 void VoronoiVertexIterator::advance(int steps) 
 {
-   int stepSize = 2;
-   Assert(Delaunay::Point().dim() == stepSize, "");
-
-   if (vvindex/stepSize + steps < vvcount) 
+   if (vvindex + steps < vvcount) 
    {
-      vvindex += steps * stepSize;
+      vvindex += steps;
    }
    else 
    {
@@ -1892,7 +4213,7 @@ void VoronoiVertexIterator::advance(int steps)
       vvloop = nullptr;
    }
 
-   Assert(vvindex / stepSize < vvcount, "");
+   Assert(vvindex < vvcount || !vvloop, "");
 }
 
 
@@ -1929,14 +4250,13 @@ VoronoiEdgeIterator::VoronoiEdgeIterator()
 VoronoiEdgeIterator::VoronoiEdgeIterator(Delaunay* triangulator) 
 {
    m_delaunay = triangulator;
-   triangulateio* pvorout = (struct triangulateio*)triangulator->m_vorout;
 
    // TEST::: I hope so!
    Assert(triangulator->GetFirstIndexNumber() == 0, "");
 
-   veloop = pvorout->edgelist; 
    veindex = 0; 
-   vecount = pvorout->numberofedges;
+   vecount = (int)triangulator->m_voronoiEdges.size();
+   veloop = vecount > 0 ? triangulator->m_voronoiEdges.data() : nullptr;
 }
 
 
@@ -1948,10 +4268,9 @@ VoronoiEdgeIterator VoronoiEdgeIterator::operator++()
    veit.veindex = veindex;
    veit.m_delaunay = m_delaunay;
 
-   // an edge is represented as 2 integer indexes!
-   if (veindex / 2 + 1 < vecount ) 
+   if (veindex + 1 < vecount) 
    {
-       veindex += 2;
+       veindex += 1;
    }
    else 
    {
@@ -1959,7 +4278,7 @@ VoronoiEdgeIterator VoronoiEdgeIterator::operator++()
       veloop = nullptr;
    }
 
-   Assert(veindex / 2 < vecount, "");
+   Assert(veindex < vecount || !veloop, "");
    return veit;
 }
 
@@ -1972,8 +4291,8 @@ int VoronoiEdgeIterator::startPointId() const
       return -1;
    }
 
-   auto edgelist = (int*)veloop;
-   return edgelist[veindex];
+   auto edges = (const Delaunay::VoronoiEdge*)veloop;
+   return edges[veindex].start;
 }
 
 
@@ -1985,26 +4304,13 @@ int VoronoiEdgeIterator::endPointId(Delaunay::Point& normvec) const
       return -1;
    }
 
-   Assert(veindex / 2 < vecount, "");
-   auto edgelist = (int*)veloop;
-   int idx = edgelist[veindex + 1];
+   Assert(veindex < vecount, "");
+   auto edges = (const Delaunay::VoronoiEdge*)veloop;
+   int idx = edges[veindex].end;
    
-   if (idx == -1) 
-   {
-      triangulateio* pvorout = (struct triangulateio*)m_delaunay->m_vorout;
-      auto normlist = pvorout->normlist;
-            
-      // normlist has same no. of elements as edgelist!
-      normvec[0] = normlist[veindex];
-      normvec[1] = normlist[veindex + 1];
-
-      Assert(!(normvec[0] == 0.0 && normvec[1] == 0.0), "");
-   }
-   else 
-   {
-      normvec[0] = 0.0;
-      normvec[1] = 0.0;
-   }
+   // (0, 0) for finite edges
+   normvec = m_delaunay->m_voronoiRays[veindex];
+   Assert((idx == -1) == !(normvec[0] == 0.0 && normvec[1] == 0.0), "");
 
    return idx;
 }
@@ -2012,19 +4318,12 @@ int VoronoiEdgeIterator::endPointId(Delaunay::Point& normvec) const
 
 const Delaunay::Point& VoronoiEdgeIterator::Org()
 {
-   auto pointId = startPointId();
-
-   VoronoiVertexIterator vit = m_delaunay->vvbegin();
-   vit.advance(pointId);
-   return *vit;
+   return m_delaunay->m_voronoiPoints[startPointId()];
 }
 
 
 Delaunay::Point VoronoiEdgeIterator::Dest(bool& finiteEdge)
 {
-   // OPEN TODO::: optimization --- use const& as return value!
-   //  -> don't uderstand this anymore, needed????
-
    Delaunay::Point normvec;
 
    auto pointId = endPointId(normvec);
@@ -2037,13 +4336,8 @@ Delaunay::Point VoronoiEdgeIterator::Dest(bool& finiteEdge)
    }
    else
    {
-      Assert(normvec.sqr_length() == 0.0, "");
-
-      VoronoiVertexIterator vit = m_delaunay->vvbegin(); 
-      vit.advance(pointId);
-      return *vit;
+      return m_delaunay->m_voronoiPoints[pointId];
    }
-
 }
 
 
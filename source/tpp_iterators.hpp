@@ -24,6 +24,10 @@ namespace tpp
 
         A triangle abc has an origin (Org) a, a destination (Dest) b, and apex (Apex) c.
         These vertices occur in counterclockwise order about the triangle.
+
+        The traversal position is kept in the iterator, thus several iterators (also in several threads)
+        can traverse a mesh at the same time, as long as it isn't changed. Mesh indexes (@see Org()) are 
+        assigned by the iterators though, i.e. the mesh is changed!
     */
    class TRPP_LIB_EXPORT FaceIterator
    {
@@ -31,7 +35,7 @@ namespace tpp
       FaceIterator& operator++();
       FaceIterator operator++(int);
 
-      FaceIterator() : m_delaunay(nullptr), meshPointCount(0) { floop.tri = nullptr; }
+      FaceIterator() : m_delaunay(nullptr), fpath(), meshPointCount(0) { floop.tri = nullptr; }
 
       bool empty() const;    // points to no triangle?  
       bool isdummy() const;  // deprecated!!!! --> pointing to a ghost triangle?
@@ -63,6 +67,14 @@ namespace tpp
        */
       double area() const;
 
+      /**
+         @brief: Get the region containing the triangle
+
+         @return: index of the region point in Delaunay::setRegionsConstraint() or -1 if the triangle isn't
+                  in any region, i.e. in no segment-bounded area with a region point
+       */
+      int regionId() const;
+
       // support for iterator dereferencing
       struct Face
       {
@@ -80,6 +92,7 @@ namespace tpp
 
          // misc
          double area() const { return m_iter->area(); }
+         int regionId() const { return m_iter->regionId(); }
 
       private:
          FaceIterator* m_iter;
@@ -100,6 +113,13 @@ namespace tpp
 
       typedef struct tdata poface; // = ptr. to oriented face
 
+      struct tpath // TriLib's internal data, a traversal position
+      {
+         void** pathblock;
+         void* pathitem;
+         int pathitemsleft;
+      };
+
       FaceIterator(Delaunay* triangulator);
 
       int getVertexIndex(/*Triwrap::vertex*/ double* vertexptr) const;
@@ -107,6 +127,7 @@ namespace tpp
 
       Delaunay* m_delaunay;         
       poface floop;                // TriLib's internal data
+      tpath fpath;                 // the position of the traversal
       mutable int meshPointCount;  // Used for numbering vertices in a complete triangulation   
 
       friend struct Face;
@@ -133,7 +154,8 @@ namespace tpp
    /**
       @brief: The vertex iterator for a Delaunay triangulation
 
-        Implements access to the resulting vertices of the triangulation
+        Implements access to the resulting vertices of the triangulation. As with FaceIterator, the 
+        traversal position is kept in the iterator.
     */
    class TRPP_LIB_EXPORT VertexIterator
    {
@@ -141,7 +163,7 @@ namespace tpp
       VertexIterator operator++();
       Delaunay::Point& operator*() const;
 
-      VertexIterator() : vloop(nullptr), m_delaunay(nullptr) {}
+      VertexIterator() : vloop(nullptr), m_delaunay(nullptr), vpath() {}
 
       int vertexId() const; // standard internal numbering! ---> OPEN TODO::: mesh numbering, -1 for Steiner points ???!!!
       double x() const;
@@ -154,8 +176,16 @@ namespace tpp
    private:
       VertexIterator(Delaunay* triangulator);   
 
+      struct tpath // TriLib's internal data, a traversal position
+      {
+         void** pathblock;
+         void* pathitem;
+         int pathitemsleft;
+      };
+
       void* vloop;  // TriLib's internal data
       Delaunay* m_delaunay;   
+      tpath vpath;  // the position of the traversal
    };
 
 
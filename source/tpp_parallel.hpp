@@ -0,0 +1,96 @@
+ /**
+    @file  tpp_parallel.hpp
+    @brief Internal helpers for running parts of the triangulation on several threads
+
+    Only *read-only* passes over the mesh are run in parallel, TriLib's mesh modifications are
+    always serial!
+ */
+
+#ifndef TRPP_PARALLEL
+#define TRPP_PARALLEL
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+
+namespace tpp
+{
+   /**
+     @brief: Get the number of threads to be used: 0 = all hardware threads, else at least 1
+    */
+   inline int resolveThreadCount(int requested)
+   {
+      if (requested > 0)
+      {
+         return requested;
+      }
+
+      unsigned hwThreads = std::thread::hardware_concurrency();
+      return hwThreads > 0 ? (int)hwThreads : 1;
+   }
+
+   /**
+     @brief: Call func(begin, end) on consecutive, non-overlapping chunks of the [0, count) range
+
+     The calling thread processes the first chunk itself. With one thread (or a tiny range)
+     func() is simply called inline, thus serial and parallel results are always the same, if
+     func() only writes to its own part of the results!
+    */
+   template <class Func>
+   void parallelFor(long count, int threadCount, Func&& func)
+   {
+      long chunks = std::min<long>(threadCount, count);
+
+      if (chunks <= 1)
+      {
+         if (count > 0)
+         {
+            func(0l, count);
+         }
+         return;
+      }
+
+      long chunkSize = (count + chunks - 1) / chunks;
+      std::vector<std::thread> workers;
+      std::vector<std::exception_ptr> errors(chunks);
+      workers.reserve(chunks - 1);
+
+      auto runChunk = [&func, &errors](long chunk, long begin, long end)
+      {
+         try
+         {
+            func(begin, end);
+         }
+         catch (...)
+         {
+            errors[chunk] = std::current_exception(); // e.g. TriLib's exit by exception
+         }
+      };
+
+      for (long chunk = 1; chunk * chunkSize < count; ++chunk)
+      {
+         long begin = chunk * chunkSize;
+         long end = std::min(begin + chunkSize, count);
+         workers.emplace_back(runChunk, chunk, begin, end);
+      }
+
+      runChunk(0, 0, std::min(chunkSize, count));
+
+      for (auto& worker : workers)
+      {
+         worker.join();
+      }
+
+      for (auto& error : errors)
+      {
+         if (error)
+         {
+            std::rethrow_exception(error);
+         }
+      }
+   }
+}
+
+#endif // TRPP_PARALLEL
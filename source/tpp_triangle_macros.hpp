@@ -22,6 +22,10 @@
     Triwrap::__pbehavior* tpbehavior = static_cast<Triwrap::__pbehavior *>(m_pbehavior); \
     Triwrap* pTriangleWrap = static_cast<Triwrap *>(m_triangleWrap);
 
+#define TP_MESH_WRAP() \
+    Triwrap::__pmesh* tpmesh = static_cast<Triwrap::__pmesh *>(m_pmesh); \
+    Triwrap* pTriangleWrap = static_cast<Triwrap *>(m_triangleWrap);
+
 #define TP_WRAP_PTR() \
     static_cast<Triwrap *>(m_triangleWrap);
 
@@ -60,4 +64,14 @@
 #define TP_PLOOP_ITER() \
     Triwrap::__otriangle* ploop = (Triwrap::__otriangle*)(&(this->floop));
 
+// the iterator's mirror of the traversal position is copied, not cast, as the compiler may assume
+// that the two struct types don't alias! Store it back with TP_PATH_STORE() after traversing.
+#define TP_PATH_ITER(path) \
+    Triwrap::__traversal tpathcopy; \
+    std::memcpy(&tpathcopy, &(this->path), sizeof(tpathcopy)); \
+    Triwrap::__traversal* ppath = &tpathcopy;
+
+#define TP_PATH_STORE(path) \
+    std::memcpy(&(this->path), ppath, sizeof(this->path));
+
 #endif // TRPP_TRILIB_MACROS
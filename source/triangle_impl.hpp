@@ -354,6 +354,10 @@
 #include "dpoint.hpp"
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "tpp_parallel.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -610,6 +614,35 @@ struct flipstacker {
   struct flipstacker *prevflip;               /* Previous flip in the stack. */
 };
 
+/* A background sizing field:  the maximum triangle areas at the nodes of a  */
+/*   regular grid, interpolated bilinearly in between.  `areas' holds        */
+/*   `columns' * `rows' values row by row, starting at (`xmin', `ymin').     */
+/*   Not used if `areas' is NULL.  Added mrkkrj.                             */
+
+struct sizinggrid {
+  REAL xmin, ymin;
+  REAL cellsize;
+  int columns, rows;
+  REAL *areas;
+};
+
+/* Quality measures of the mesh, as printed by quality_statistics().  Added  */
+/*   mrkkrj: lengths, areas and angles are final values, i.e. not squared.   */
+/*   `angletable' counts the angles in 10 degree bins, `aspecttable' the     */
+/*   aspect ratios up to the bounds in `ratiotable' (the last bin is open).  */
+/*   The `bad...' counts refer to the quality switches of the mesh.          */
+
+struct qualitystats {
+  long triangles;
+  int angletable[18];
+  int aspecttable[16];
+  REAL smallestangle, biggestangle;
+  REAL shortest, longest;
+  REAL minaltitude, worstaspect;
+  REAL smallestarea, biggestarea;
+  long badangles, badareas, badusertests;
+};
+
 /* A node in a heap used to store events for the sweepline Delaunay          */
 /*   algorithm.  Nodes do not point directly to their parents or children in */
 /*   the heap.  Instead, each node knows its position in the heap, and can   */
@@ -655,7 +688,9 @@ struct splaynode {
 /*   the "deaditemstack" stack as well as live items.  pathblock points to   */
 /*   the block currently being traversed.  pathitem points to the next item  */
 /*   to be traversed.  pathitemsleft is the number of items that remain to   */
-/*   be traversed in pathblock.                                              */
+/*   be traversed in pathblock.  The pool's own traversal is in `path'; any  */
+/*   number of other ones can be kept outside of the pool, so they don't     */
+/*   disturb each other (added mrkkrj).                                      */
 /*                                                                           */
 /* alignbytes determines how new records should be aligned in memory.        */
 /*   itembytes is the length of a record in bytes (after rounding up).       */
@@ -666,19 +701,38 @@ struct splaynode {
 /*   been allocated at once; it is the current number of items plus the      */
 /*   number of records kept on deaditemstack.                                */
 
+struct traversal {
+  VOID **pathblock;
+  VOID *pathitem;
+  int pathitemsleft;
+};
+
+typedef struct traversal __traversal;
+
 struct memorypool {
   VOID **firstblock, **nowblock;
   VOID *nextitem;
   VOID *deaditemstack;
-  VOID **pathblock;
-  VOID *pathitem;
+  struct traversal path;
   int alignbytes;
   int itembytes;
   int itemsperblock;
   int itemsfirstblock;
   long items, maxitems;
   int unallocateditems;
-  int pathitemsleft;
+};
+
+/* Added mrkkrj: the blocks of a memory pool sorted by their addresses, to   */
+/*   find the number of an item (see poolslot()) by a binary search.         */
+/*   blockslots holds the number of the first item of each block, counting   */
+/*   all items (dead ones included) in traversal order, slots the number of  */
+/*   all items.                                                              */
+
+struct poolslottable {
+  std::vector<char *> blockitems;
+  std::vector<long> blockslots;
+  std::vector<int> blockcounts;
+  long slots;
 };
 
 
@@ -749,6 +803,7 @@ struct mesh {
   int areaboundindex;             /* Index to find area bound of a triangle. */
   int checksegments;         /* Are there segments in the triangulation yet? */
   int checkquality;                  /* Has quality triangulation begun yet? */
+  int refinementstopped;   /* Bad triangles left after enforcequality()? */
   int readnodefile;                           /* Has a .node file been read? */
   long samples;              /* Number of random samples for point location. */
 
@@ -819,6 +874,24 @@ struct behavior {
 /*   quiet: -Q switch.  verbose: count of how often -V switch is selected.   */
 /*   usesegments: -p, -r, -q, or -c switch; determines whether segments are  */
 /*     used at all.                                                          */
+/*   threads: number of threads for the read-only passes over the mesh (no   */
+/*     switch, set by the wrapper - added mrkkrj).                           */
+/*   segmenthints: locate the endpoints of a PSLG segment starting from the  */
+/*     triangle reached by the previous insertion, for segments inserted in  */
+/*     spatial order (no switch, set by the wrapper - added mrkkrj).         */
+/*   holeringmark: marker of the subsegments bounding holes, the triangles   */
+/*     enclosed by an odd number of them are carved away, 0 = none (no       */
+/*     switch, set by the wrapper - added mrkkrj).                           */
+/*   refinementcheck, refinementcontext: called before each bad triangle is  */
+/*     split with the count of Steiner points and bad triangles, returns 0   */
+/*     to stop the refinement.  worstfirst: queue bad triangles by quality   */
+/*     instead of by the length of the shortest edge (no switches, set by    */
+/*     the wrapper - added mrkkrj).                                          */
+/*   sizingfield: maximum triangle areas varying over the domain (no switch, */
+/*     set by the wrapper - added mrkkrj).                                   */
+/*   usertestfunc, usertestcontext: the triangle test used with -u instead   */
+/*     of triunsuitable(), if not NULL (no switch, set by the wrapper -      */
+/*     added mrkkrj).                                                        */
 /*                                                                           */
 /* Read the instructions to find out the meaning of these switches.          */
 
@@ -836,6 +909,15 @@ struct behavior {
   int order;
   int nobisect;
   int steiner;
+  int threads;
+  int segmenthints;
+  int holeringmark;
+  int (*usertestfunc)(REAL *, REAL *, REAL *, REAL, void *);
+  void *usertestcontext;
+  struct sizinggrid sizingfield;
+  int (*refinementcheck)(long, long, void *);
+  void *refinementcontext;
+  int worstfirst;
   REAL minangle, goodangle, offconstant;
   REAL maxarea;
 
@@ -3391,6 +3473,15 @@ struct behavior *b;
   b->nobisect = 0;
   b->conformdel = 0;
   b->steiner = -1;
+  b->threads = 1;
+  b->segmenthints = 0;
+  b->holeringmark = 0;
+  b->usertestfunc = NULL;
+  b->usertestcontext = NULL;
+  b->sizingfield.areas = (REAL *) NULL;
+  b->refinementcheck = NULL;
+  b->refinementcontext = NULL;
+  b->worstfirst = 0;
   b->order = 1;
   b->minangle = 0.0;
   b->maxarea = -1.0;
@@ -3596,13 +3687,7 @@ struct behavior *b;
 #endif /* not CDT_ONLY */
 #endif /* not TRILIBRARY */
   b->usesegments = b->poly || b->refine || b->quality || b->convex;
-  b->goodangle = cos(b->minangle * PI / 180.0);
-  if (b->goodangle == 1.0) {
-    b->offconstant = 0.0;
-  } else {
-    b->offconstant = 0.475 * sqrt((1.0 + b->goodangle) / (1.0 - b->goodangle));
-  }
-  b->goodangle *= b->goodangle;
+  qualityconstants(b);
   if (b->refine && b->noiterationnum) {
     printf(
       "Error:  You cannot use the -I switch when refining a triangulation.\n");
@@ -3719,6 +3804,33 @@ struct behavior *b;
 #endif /* not TRILIBRARY */
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  qualityconstants()   Derive the constants used by the quality tests and  */
+/*                       the off-center Steiner points from `b->minangle'.   */
+/*                                                                           */
+/*  Added mrkkrj: also used when the angle bound is changed for a further    */
+/*  refinement of an existing mesh.                                          */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void qualityconstants(struct behavior *b)
+#else /* not ANSI_DECLARATORS */
+void qualityconstants(b)
+struct behavior *b;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  b->goodangle = cos(b->minangle * PI / 180.0);
+  if (b->goodangle == 1.0) {
+    b->offconstant = 0.0;
+  } else {
+    b->offconstant = 0.475 * sqrt((1.0 + b->goodangle) / (1.0 - b->goodangle));
+  }
+  b->goodangle *= b->goodangle;
+}
+
 /**                                                                         **/
 /**                                                                         **/
 /********* User interaction routines begin here                      *********/
@@ -3938,8 +4050,9 @@ struct memorypool *pool;
   pool->nowblock = (VOID **) NULL;
   pool->nextitem = (VOID *) NULL;
   pool->deaditemstack = (VOID *) NULL;
-  pool->pathblock = (VOID **) NULL;
-  pool->pathitem = (VOID *) NULL;
+  pool->path.pathblock = (VOID **) NULL;
+  pool->path.pathitem = (VOID *) NULL;
+  pool->path.pathitemsleft = 0;
   pool->alignbytes = 0;
   pool->itembytes = 0;
   pool->itemsperblock = 0;
@@ -3947,7 +4060,6 @@ struct memorypool *pool;
   pool->items = 0;
   pool->maxitems = 0;
   pool->unallocateditems = 0;
-  pool->pathitemsleft = 0;
 }
 
 /*****************************************************************************/
@@ -4168,19 +4280,40 @@ void traversalinit(pool)
 struct memorypool *pool;
 #endif /* not ANSI_DECLARATORS */
 
+{
+  pathinit(pool, &pool->path);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  pathinit()   Prepare to traverse the entire list of items, keeping the   */
+/*               position in `path' instead of the pool.                     */
+/*                                                                           */
+/*  This routine is used in conjunction with pathtraverse().  Added mrkkrj.  */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void pathinit(struct memorypool *pool, struct traversal *path)
+#else /* not ANSI_DECLARATORS */
+void pathinit(pool, path)
+struct memorypool *pool;
+struct traversal *path;
+#endif /* not ANSI_DECLARATORS */
+
 {
   int_ptr_type alignptr;
 
   /* Begin the traversal in the first block. */
-  pool->pathblock = pool->firstblock;
+  path->pathblock = pool->firstblock;
   /* Find the first item in the block.  Increment by the size of (VOID *). */
-  alignptr = (int_ptr_type) (pool->pathblock + 1);
+  alignptr = (int_ptr_type) (path->pathblock + 1);
   /* Align with item on an `alignbytes'-byte boundary. */
-  pool->pathitem = (VOID *)
+  path->pathitem = (VOID *)
     (alignptr + (int_ptr_type) pool->alignbytes -
      (alignptr % (int_ptr_type) pool->alignbytes));
   /* Set the number of items left in the current block. */
-  pool->pathitemsleft = pool->itemsfirstblock;
+  path->pathitemsleft = pool->itemsfirstblock;
 }
 
 /*****************************************************************************/
@@ -4204,36 +4337,168 @@ VOID *traverse(pool)
 struct memorypool *pool;
 #endif /* not ANSI_DECLARATORS */
 
+{
+  return pathtraverse(pool, &pool->path);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  pathtraverse()   Find the next item in the list, for a traversal begun   */
+/*                   by pathinit().                                          */
+/*                                                                           */
+/*  As traverse(), but only `path' is changed, not the pool, thus several    */
+/*  traversals (e.g. in several threads) can run at the same time, as long   */
+/*  as no items are allocated.  Added mrkkrj.                                */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+VOID *pathtraverse(struct memorypool *pool, struct traversal *path)
+#else /* not ANSI_DECLARATORS */
+VOID *pathtraverse(pool, path)
+struct memorypool *pool;
+struct traversal *path;
+#endif /* not ANSI_DECLARATORS */
+
 {
   VOID *newitem;
   int_ptr_type alignptr;
 
   /* Stop upon exhausting the list of items. */
-  if (pool->pathitem == pool->nextitem) {
+  if (path->pathitem == pool->nextitem) {
     return (VOID *) NULL;
   }
 
   /* Check whether any untraversed items remain in the current block. */
-  if (pool->pathitemsleft == 0) {
+  if (path->pathitemsleft == 0) {
     /* Find the next block. */
-    pool->pathblock = (VOID **) *(pool->pathblock);
+    path->pathblock = (VOID **) *(path->pathblock);
     /* Find the first item in the block.  Increment by the size of (VOID *). */
-    alignptr = (int_ptr_type) (pool->pathblock + 1);
+    alignptr = (int_ptr_type) (path->pathblock + 1);
     /* Align with item on an `alignbytes'-byte boundary. */
-    pool->pathitem = (VOID *)
+    path->pathitem = (VOID *)
       (alignptr + (int_ptr_type) pool->alignbytes -
        (alignptr % (int_ptr_type) pool->alignbytes));
     /* Set the number of items left in the current block. */
-    pool->pathitemsleft = pool->itemsperblock;
+    path->pathitemsleft = pool->itemsperblock;
   }
 
-  newitem = pool->pathitem;
+  newitem = path->pathitem;
   /* Find the next item in the block. */
-  pool->pathitem = (VOID *) ((char *) pool->pathitem + pool->itembytes);
-  pool->pathitemsleft--;
+  path->pathitem = (VOID *) ((char *) path->pathitem + pool->itembytes);
+  path->pathitemsleft--;
   return newitem;
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  poolblocks()   Find the first item and the number of traversable items   */
+/*                 of every block of a pool.                                 */
+/*                                                                           */
+/*  Returns the number of blocks.  If `blockitems' and `blockcounts' aren't  */
+/*  NULL, they are filled with one entry per block.  The blocks returned     */
+/*  contain exactly the items traverse() would return, in the same order.    */
+/*  As with traverse(), dead items are included.  Added mrkkrj.              */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+long poolblocks(struct memorypool *pool, VOID **blockitems, int *blockcounts)
+#else /* not ANSI_DECLARATORS */
+long poolblocks(pool, blockitems, blockcounts)
+struct memorypool *pool;
+VOID **blockitems;
+int *blockcounts;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  VOID **block;
+  VOID *firstitem;
+  char *blockend;
+  int_ptr_type alignptr;
+  int itemcount;
+  long blockcount;
+
+  blockcount = 0;
+  block = pool->firstblock;
+  itemcount = pool->itemsfirstblock;
+  while (block != (VOID **) NULL) {
+    /* Find the first item in the block, as traverse() does. */
+    alignptr = (int_ptr_type) (block + 1);
+    firstitem = (VOID *)
+      (alignptr + (int_ptr_type) pool->alignbytes -
+       (alignptr % (int_ptr_type) pool->alignbytes));
+    blockend = (char *) firstitem + itemcount * pool->itembytes;
+    if (((char *) pool->nextitem >= (char *) firstitem) &&
+        ((char *) pool->nextitem <= blockend)) {
+      /* The last block in use. */
+      itemcount = (int) (((char *) pool->nextitem - (char *) firstitem) /
+                         pool->itembytes);
+      block = (VOID **) NULL;
+    } else {
+      block = (VOID **) *block;
+    }
+    if (blockitems != (VOID **) NULL) {
+      blockitems[blockcount] = firstitem;
+      blockcounts[blockcount] = itemcount;
+    }
+    blockcount++;
+    itemcount = pool->itemsperblock;
+  }
+  return blockcount;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  traverseparallel()   Call `func(slice, item)' for every item of a pool,  */
+/*                       dead ones included, using `threads' threads.        */
+/*                                                                           */
+/*  The items are numbered as traverse() would return them and cut into      */
+/*  `slicecount' consecutive slices, which are processed concurrently.  If   */
+/*  `func' collects its results per slice, merging them in slice order gives */
+/*  the same order as a serial traversal.  Added mrkkrj.                     */
+/*                                                                           */
+/*****************************************************************************/
+
+template <class Func>
+void traverseparallel(struct memorypool *pool, int threads, long slicecount,
+                      Func func)
+{
+  long blockcount, itemcount, slicesize;
+  long i;
+
+  blockcount = poolblocks(pool, (VOID **) NULL, (int *) NULL);
+  std::vector<VOID *> blockitems(blockcount);
+  std::vector<int> blockcounts(blockcount);
+  std::vector<long> blockstarts(blockcount + 1);
+  poolblocks(pool, blockitems.data(), blockcounts.data());
+  /* Number the items of the pool consecutively over all blocks. */
+  itemcount = 0;
+  for (i = 0; i < blockcount; i++) {
+    blockstarts[i] = itemcount;
+    itemcount += blockcounts[i];
+  }
+  blockstarts[blockcount] = itemcount;
+  slicesize = itemcount / slicecount + 1;
+
+  tpp::parallelFor(slicecount, threads, [&](long firstslice, long lastslice) {
+    long slice, item, block;
+
+    for (slice = firstslice; slice < lastslice; slice++) {
+      item = slice * slicesize;
+      block = std::upper_bound(blockstarts.begin(), blockstarts.end(), item) -
+              blockstarts.begin() - 1;
+      for (; (item < (slice + 1) * slicesize) && (item < itemcount); item++) {
+        while (item >= blockstarts[block + 1]) {
+          block++;
+        }
+        func(slice, (VOID *) ((char *) blockitems[block] +
+                              (item - blockstarts[block]) * pool->itembytes));
+      }
+    }
+  });
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  dummyinit()   Initialize the triangle that fills "outer space" and the   */
@@ -4494,6 +4759,33 @@ struct mesh *m;
   return newtriangle;
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  trianglepathtraverse()   Traverse the triangles along `path', skipping   */
+/*                           dead ones.  Added mrkkrj.                       */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+triangle *trianglepathtraverse(struct mesh *m, struct traversal *path)
+#else /* not ANSI_DECLARATORS */
+triangle *trianglepathtraverse(m, path)
+struct mesh *m;
+struct traversal *path;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  triangle *newtriangle;
+
+  do {
+    newtriangle = (triangle *) pathtraverse(&m->triangles, path);
+    if (newtriangle == (triangle *) NULL) {
+      return (triangle *) NULL;
+    }
+  } while (deadtri(newtriangle));                         /* Skip dead ones. */
+  return newtriangle;
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  subsegdealloc()   Deallocate space for a subsegment, marking it dead.    */
@@ -4586,6 +4878,33 @@ struct mesh *m;
   return newvertex;
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  vertexpathtraverse()   Traverse the vertices along `path', skipping dead */
+/*                         ones.  Added mrkkrj.                              */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+vertex vertexpathtraverse(struct mesh *m, struct traversal *path)
+#else /* not ANSI_DECLARATORS */
+vertex vertexpathtraverse(m, path)
+struct mesh *m;
+struct traversal *path;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  vertex newvertex;
+
+  do {
+    newvertex = (vertex) pathtraverse(&m->vertices, path);
+    if (newvertex == (vertex) NULL) {
+      return (vertex) NULL;
+    }
+  } while (vertextype(newvertex) == DEADVERTEX);          /* Skip dead ones. */
+  return newvertex;
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  badsubsegdealloc()   Deallocate space for a bad subsegment, marking it   */
@@ -4688,6 +5007,44 @@ int number;
   return (vertex) (foundvertex + m->vertices.itembytes * (number - current));
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  qualitydeinit()   Free the memory used by enforcequality().              */
+/*                                                                           */
+/*  Added mrkkrj: must be called with the quality switches of the last run   */
+/*  of enforcequality(). Afterwards enforcequality() can be run once more on */
+/*  the same mesh, as the freed pools are zeroed, i.e. neither freed twice   */
+/*  nor do their dead item stacks point into the freed blocks.               */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef CDT_ONLY
+
+#ifdef ANSI_DECLARATORS
+void qualitydeinit(struct mesh *m, struct behavior *b)
+#else /* not ANSI_DECLARATORS */
+void qualitydeinit(m, b)
+struct mesh *m;
+struct behavior *b;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  if (b->quality) {
+    pooldeinit(&m->badsubsegs);
+    poolzero(&m->badsubsegs);
+    if ((b->minangle > 0.0) || b->vararea || b->fixedarea || b->usertest ||
+        (b->sizingfield.areas != (REAL *) NULL)) {
+      pooldeinit(&m->badtriangles);
+      poolzero(&m->badtriangles);
+      pooldeinit(&m->flipstackers);
+      poolzero(&m->flipstackers);
+    }
+  }
+  m->checkquality = 0;   /* insertvertex() mustn't use the freed flip stack. */
+}
+
+#endif /* not CDT_ONLY */
+
 /*****************************************************************************/
 /*                                                                           */
 /*  triangledeinit()   Free all remaining allocated memory.                  */
@@ -4711,13 +5068,7 @@ struct behavior *b;
   }
   pooldeinit(&m->vertices);
 #ifndef CDT_ONLY
-  if (b->quality) {
-    pooldeinit(&m->badsubsegs);
-    if ((b->minangle > 0.0) || b->vararea || b->fixedarea || b->usertest) {
-      pooldeinit(&m->badtriangles);
-      pooldeinit(&m->flipstackers);
-    }
-  }
+  qualitydeinit(m, b);
 #endif /* not CDT_ONLY */
 }
 
@@ -5329,12 +5680,35 @@ vertex pb;
 vertex pc;
 #endif /* not ANSI_DECLARATORS */
 
+{
+  m->counterclockcount++;
+
+  return counterclockwiseuncounted(b, pa, pb, pc);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  counterclockwiseuncounted()   Same as counterclockwise(), but doesn't    */
+/*                                count the test, thus can be called from    */
+/*                                several threads.  Added mrkkrj.            */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+REAL counterclockwiseuncounted(struct behavior *b,
+                               vertex pa, vertex pb, vertex pc)
+#else /* not ANSI_DECLARATORS */
+REAL counterclockwiseuncounted(b, pa, pb, pc)
+struct behavior *b;
+vertex pa;
+vertex pb;
+vertex pc;
+#endif /* not ANSI_DECLARATORS */
+
 {
   REAL detleft, detright, det;
   REAL detsum, errbound;
 
-  m->counterclockcount++;
-
   detleft = (pa[0] - pc[0]) * (pb[1] - pc[1]);
   detright = (pa[1] - pc[1]) * (pb[0] - pc[0]);
   det = detleft - detright;
@@ -5979,6 +6353,32 @@ vertex pc;
 vertex pd;
 #endif /* not ANSI_DECLARATORS */
 
+{
+  m->incirclecount++;
+
+  return incircleuncounted(b, pa, pb, pc, pd);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  incircleuncounted()   Same as incircle(), but doesn't count the test,    */
+/*                        thus can be called from several threads.           */
+/*                        Added mrkkrj.                                      */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+REAL incircleuncounted(struct behavior *b,
+                       vertex pa, vertex pb, vertex pc, vertex pd)
+#else /* not ANSI_DECLARATORS */
+REAL incircleuncounted(b, pa, pb, pc, pd)
+struct behavior *b;
+vertex pa;
+vertex pb;
+vertex pc;
+vertex pd;
+#endif /* not ANSI_DECLARATORS */
+
 {
   REAL adx, bdx, cdx, ady, bdy, cdy;
   REAL bdxcdy, cdxbdy, cdxady, adxcdy, adxbdy, bdxady;
@@ -5986,8 +6386,6 @@ vertex pd;
   REAL det;
   REAL permanent, errbound;
 
-  m->incirclecount++;
-
   adx = pa[0] - pd[0];
   bdx = pb[0] - pd[0];
   cdx = pc[0] - pd[0];
@@ -6733,6 +7131,7 @@ struct mesh *m;
   m->samples = 1;         /* Point location should take at least one sample. */
   m->checksegments = 0;   /* There are no segments in the triangulation yet. */
   m->checkquality = 0;     /* The quality triangulation stage has not begun. */
+  m->refinementstopped = 0;
   m->incirclecount = m->counterclockcount = m->orient3dcount = 0;
   m->hyperbolacount = m->circletopcount = m->circumcentercount = 0;
   randomseed = 1;
@@ -7284,13 +7683,72 @@ struct osub *testsubseg;
 
 #endif /* not CDT_ONLY */
 
+/*****************************************************************************/
+/*                                                                           */
+/*  sizingfieldarea()   Find the maximum triangle area the sizing field      */
+/*                      permits at a point.                                  */
+/*                                                                           */
+/*  Interpolates bilinearly between the four grid nodes around the point.    */
+/*  Points outside of the grid use the values at its border.  Added mrkkrj.  */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef CDT_ONLY
+
+#ifdef ANSI_DECLARATORS
+REAL sizingfieldarea(struct behavior *b, REAL x, REAL y)
+#else /* not ANSI_DECLARATORS */
+REAL sizingfieldarea(b, x, y)
+struct behavior *b;
+REAL x;
+REAL y;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct sizinggrid *grid;
+  REAL gx, gy, fx, fy;
+  REAL *row0, *row1;
+  int col, row;
+
+  grid = &b->sizingfield;
+  /* Grid coordinates, clamped to the grid. */
+  gx = (x - grid->xmin) / grid->cellsize;
+  gy = (y - grid->ymin) / grid->cellsize;
+  gx = (gx < 0.0) ? 0.0 : (gx > grid->columns - 1) ? grid->columns - 1 : gx;
+  gy = (gy < 0.0) ? 0.0 : (gy > grid->rows - 1) ? grid->rows - 1 : gy;
+  col = (int) gx;
+  row = (int) gy;
+  if (col >= grid->columns - 1) {
+    col = (grid->columns > 1) ? grid->columns - 2 : 0;
+  }
+  if (row >= grid->rows - 1) {
+    row = (grid->rows > 1) ? grid->rows - 2 : 0;
+  }
+  fx = (grid->columns > 1) ? gx - col : 0.0;
+  fy = (grid->rows > 1) ? gy - row : 0.0;
+
+  row0 = &grid->areas[row * grid->columns + col];
+  row1 = (grid->rows > 1) ? row0 + grid->columns : row0;
+  if (grid->columns > 1) {
+    return (1.0 - fy) * ((1.0 - fx) * row0[0] + fx * row0[1]) +
+           fy * ((1.0 - fx) * row1[0] + fx * row1[1]);
+  } else {
+    return (1.0 - fy) * row0[0] + fy * row1[0];
+  }
+}
+
+#endif /* not CDT_ONLY */
+
 /*****************************************************************************/
 /*                                                                           */
 /*  testtriangle()   Test a triangle for quality and size.                   */
 /*                                                                           */
 /*  Tests a triangle to see if it satisfies the minimum angle condition and  */
 /*  the maximum area condition.  Triangles that aren't up to spec are added  */
-/*  to the bad triangle queue.                                               */
+/*  to the bad triangle queue.  Their key is the squared length of the       */
+/*  shortest edge, or with `b->worstfirst' a measure of the triangle's       */
+/*  quality, smaller for worse triangles (sin^2 of the smallest angle, or    */
+/*  the ratio of the permitted to the actual area).  Modified mrkkrj.        */
 /*                                                                           */
 /*****************************************************************************/
 
@@ -7314,9 +7772,9 @@ struct otri *testtri;
   vertex joinvertex;
   REAL dxod, dyod, dxda, dyda, dxao, dyao;
   REAL dxod2, dyod2, dxda2, dyda2, dxao2, dyao2;
-  REAL apexlen, orglen, destlen, minedge;
+  REAL apexlen, orglen, destlen, minedge, key;
   REAL angle;
-  REAL area;
+  REAL area, sizingarea;
   REAL dist1, dist2;
   subseg sptr;                      /* Temporary variable used by tspivot(). */
   triangle ptr;           /* Temporary variable used by oprev() and dnext(). */
@@ -7370,12 +7828,14 @@ struct otri *testtri;
     lprev(*testtri, tri1);
   }
 
-  if (b->vararea || b->fixedarea || b->usertest) {
+  if (b->vararea || b->fixedarea || b->usertest ||
+      (b->sizingfield.areas != (REAL *) NULL)) {
     /* Check whether the area is larger than permitted. */
     area = 0.5 * (dxod * dyda - dyod * dxda);
     if (b->fixedarea && (area > b->maxarea)) {
       /* Add this triangle to the list of bad triangles. */
-      enqueuebadtri(m, b, testtri, minedge, tapex, torg, tdest);
+      key = b->worstfirst ? b->maxarea / area : minedge;
+      enqueuebadtri(m, b, testtri, key, tapex, torg, tdest);
       return;
     }
 
@@ -7383,14 +7843,31 @@ struct otri *testtri;
     if ((b->vararea) && (area > areabound(*testtri)) &&
         (areabound(*testtri) > 0.0)) {
       /* Add this triangle to the list of bad triangles. */
-      enqueuebadtri(m, b, testtri, minedge, tapex, torg, tdest);
+      key = b->worstfirst ? areabound(*testtri) / area : minedge;
+      enqueuebadtri(m, b, testtri, key, tapex, torg, tdest);
       return;
     }
 
+    /* Check the area permitted by the sizing field at the centroid. */
+    if (b->sizingfield.areas != (REAL *) NULL) {
+      sizingarea = sizingfieldarea(b, (torg[0] + tdest[0] + tapex[0]) / 3.0,
+                                   (torg[1] + tdest[1] + tapex[1]) / 3.0);
+      if (area > sizingarea) {
+        /* Add this triangle to the list of bad triangles. */
+        key = b->worstfirst ? sizingarea / area : minedge;
+        enqueuebadtri(m, b, testtri, key, tapex, torg, tdest);
+        return;
+      }
+    }
+
     if (b->usertest) {
       /* Check whether the user thinks this triangle is too large. */
-      if (triunsuitable(torg, tdest, tapex, area)) {
-        enqueuebadtri(m, b, testtri, minedge, tapex, torg, tdest);
+      if ((b->usertestfunc != NULL) ?
+          b->usertestfunc(torg, tdest, tapex, area, b->usertestcontext) :
+          triunsuitable(torg, tdest, tapex, area)) {
+        /* No measure of quality, queue it behind the bad ones. */
+        key = b->worstfirst ? 1.0 : minedge;
+        enqueuebadtri(m, b, testtri, key, tapex, torg, tdest);
         return;
       }
     }
@@ -7454,7 +7931,12 @@ struct otri *testtri;
     }
 
     /* Add this triangle to the list of bad triangles. */
-    enqueuebadtri(m, b, testtri, minedge, tapex, torg, tdest);
+    key = minedge;
+    if (b->worstfirst) {
+      /* The square of the sine of the smallest angle (> 0 for the queue). */
+      key = (angle < 1.0) ? 1.0 - angle : minedge;
+    }
+    enqueuebadtri(m, b, testtri, key, tapex, torg, tdest);
   }
 }
 
@@ -7873,10 +8355,68 @@ struct otri *searchtri;
   return preciselocate(m, b, searchpoint, searchtri, 0);
 }
 
-/**                                                                         **/
-/**                                                                         **/
-/********* Point location routines end here                          *********/
-
+/*****************************************************************************/
+/*                                                                           */
+/*  walklocate()   Find a triangle or edge containing a given point, walking */
+/*                 straight from a triangle known to be nearby.              */
+/*                                                                           */
+/*  Same as locate(), but without the random sampling, i.e. the walk starts  */
+/*  at `searchtri' (which must not be the boundary triangle `dummytri').     */
+/*  Cheap if the point is close to `searchtri', as when the insertions are   */
+/*  made in spatial order.  Added mrkkrj.                                    */
+/*                                                                           */
+/*  WARNING:  This routine is designed for convex triangulations, and will   */
+/*  not generally work after the holes and concavities have been carved.     */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+enum locateresult walklocate(struct mesh *m, struct behavior *b,
+                             vertex searchpoint, struct otri *searchtri)
+#else /* not ANSI_DECLARATORS */
+enum locateresult walklocate(m, b, searchpoint, searchtri)
+struct mesh *m;
+struct behavior *b;
+vertex searchpoint;
+struct otri *searchtri;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  vertex torg, tdest;
+  REAL ahead;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  org(*searchtri, torg);
+  dest(*searchtri, tdest);
+  /* Check the starting triangle's vertices. */
+  if ((torg[0] == searchpoint[0]) && (torg[1] == searchpoint[1])) {
+    return ONVERTEX;
+  }
+  if ((tdest[0] == searchpoint[0]) && (tdest[1] == searchpoint[1])) {
+    lnextself(*searchtri);
+    return ONVERTEX;
+  }
+  /* Orient `searchtri' to fit the preconditions of calling preciselocate(). */
+  ahead = counterclockwise(m, b, torg, tdest, searchpoint);
+  if (ahead < 0.0) {
+    symself(*searchtri);
+    if (searchtri->tri == m->dummytri) {
+      /* The point lies beyond a hull edge. */
+      return OUTSIDE;
+    }
+  } else if (ahead == 0.0) {
+    if (((torg[0] < searchpoint[0]) == (searchpoint[0] < tdest[0])) &&
+        ((torg[1] < searchpoint[1]) == (searchpoint[1] < tdest[1]))) {
+      return ONEDGE;
+    }
+  }
+  return preciselocate(m, b, searchpoint, searchtri, 0);
+}
+
+/**                                                                         **/
+/**                                                                         **/
+/********* Point location routines end here                          *********/
+
 /********* Mesh transformation routines begin here                   *********/
 /**                                                                         **/
 /**                                                                         **/
@@ -8731,6 +9271,17 @@ int triflaws;
           /* `farvertex' is infinitely distant and cannot be inside */
           /*   the circumcircle of the triangle `horiz'.            */
           doflip = 0;
+        } else if (b->weighted) {
+          /* Test whether the edge is locally regular.  Unlike in the     */
+          /*   Delaunay case, the quadrilateral needn't be convex, thus   */
+          /*   the remaining edges are left to insertweightedvertex().    */
+          /*   Added mrkkrj.                                              */
+          doflip = (nonregular(m, b, leftvertex, newvertex, rightvertex,
+                               farvertex) > 0.0) &&
+                   (counterclockwise(m, b, newvertex, rightvertex, farvertex)
+                    > 0.0) &&
+                   (counterclockwise(m, b, farvertex, leftvertex, newvertex)
+                    > 0.0);
         } else {
           /* Test whether the edge is locally Delaunay. */
           doflip = incircle(m, b, leftvertex, newvertex, rightvertex,
@@ -10354,6 +10905,354 @@ struct behavior *b;
 
 #endif /* not REDUCED */
 
+/*****************************************************************************/
+/*                                                                           */
+/*  isboxvertex()   Is `testvertex' one of the vertices of the triangular    */
+/*                  bounding box?  Added mrkkrj.                             */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef REDUCED
+
+#ifdef ANSI_DECLARATORS
+int isboxvertex(struct mesh *m, vertex testvertex)
+#else /* not ANSI_DECLARATORS */
+int isboxvertex(m, testvertex)
+struct mesh *m;
+vertex testvertex;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  return (testvertex == m->infvertex1) || (testvertex == m->infvertex2) ||
+         (testvertex == m->infvertex3);
+}
+
+#endif /* not REDUCED */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  removedegree3vertex()   Remove a vertex of degree three from the         */
+/*                          triangulation (a 3-1 flip).                      */
+/*                                                                           */
+/*  `deledge' is an edge whose origin is the vertex to be removed.  The      */
+/*  three triangles around it are replaced by one, which reuses the record   */
+/*  of the triangle of `deledge'; upon completion `deledge' is a handle of   */
+/*  the new triangle.  The removed vertex is marked as UNDEADVERTEX.         */
+/*                                                                           */
+/*  WARNING:  The vertex must lie inside the triangle formed by its three    */
+/*  neighbors, and none of the triangles may be adjacent to a subsegment.    */
+/*  Added mrkkrj.                                                            */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef REDUCED
+
+#ifdef ANSI_DECLARATORS
+void removedegree3vertex(struct mesh *m, struct behavior *b,
+                         struct otri *deledge)
+#else /* not ANSI_DECLARATORS */
+void removedegree3vertex(m, b, deledge)
+struct mesh *m;
+struct behavior *b;
+struct otri *deledge;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri lefttri, righttri;
+  struct otri leftcasing, rightcasing;
+  struct otri edge;
+  vertex delvertex, farvertex;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  org(*deledge, delvertex);
+  if (b->verbose > 1) {
+    printf("  Removing redundant vertex (%.12g, %.12g).\n",
+           delvertex[0], delvertex[1]);
+  }
+  /* The triangles on the two other edges around the vertex. */
+  lprev(*deledge, edge);
+  sym(edge, lefttri);
+  sym(*deledge, righttri);
+  apex(righttri, farvertex);
+  /* Their outer edges become edges of the remaining triangle. */
+  lnext(lefttri, edge);
+  sym(edge, leftcasing);
+  lprev(righttri, edge);
+  sym(edge, rightcasing);
+
+  setorg(*deledge, farvertex);
+  lprev(*deledge, edge);
+  if (leftcasing.tri == m->dummytri) {
+    dissolve(edge);
+  } else {
+    bond(edge, leftcasing);
+  }
+  if (rightcasing.tri == m->dummytri) {
+    dissolve(*deledge);
+  } else {
+    bond(*deledge, rightcasing);
+  }
+  triangledealloc(m, lefttri.tri);
+  triangledealloc(m, righttri.tri);
+  otricopy(*deledge, m->recenttri);
+
+  setvertextype(delvertex, UNDEADVERTEX);
+  m->undeads++;
+}
+
+#endif /* not REDUCED */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  removeredundantvertex()   Remove the reflex vertex of a non-regular edge */
+/*                            from a regular triangulation, if possible.     */
+/*                                                                           */
+/*  `deledge' is a non-regular edge whose origin is the reflex vertex of its */
+/*  quadrilateral, i.e. it lies above the lifted triangles of the star of    */
+/*  the vertex being inserted.  It is removed by a 3-1 flip if it has degree */
+/*  three.  If it lies exactly on the diagonal of the quadrilateral (`flat'  */
+/*  is set), it is removed by a 4-2 flip if it has degree four:  the edge to */
+/*  its fourth neighbor is flipped first, leaving a flat triangle and        */
+/*  degree three.  The fourth neighbor may be a vertex of the bounding box,  */
+/*  which is how redundant vertices on the convex hull are removed.          */
+/*                                                                           */
+/*  Returns 1 if the vertex was removed, then `deledge' is a handle of one   */
+/*  of the remaining triangles.  Added mrkkrj.                               */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef REDUCED
+
+#ifdef ANSI_DECLARATORS
+int removeredundantvertex(struct mesh *m, struct behavior *b,
+                          struct otri *deledge, int flat)
+#else /* not ANSI_DECLARATORS */
+int removeredundantvertex(m, b, deledge, flat)
+struct mesh *m;
+struct behavior *b;
+struct otri *deledge;
+int flat;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri testtri;
+  int degree;
+  triangle ptr;   /* Temporary variable used by sym(), onext(), and oprev(). */
+
+  /* Count the degree, the vertex is always inside the bounding box. */
+  otricopy(*deledge, testtri);
+  degree = 0;
+  do {
+    degree++;
+    onextself(testtri);
+  } while ((degree <= 4) && !otriequal(testtri, *deledge));
+
+  if (degree == 3) {
+    removedegree3vertex(m, b, deledge);
+    return 1;
+  }
+  if ((degree == 4) && flat) {
+    /* The neighbors in counterclockwise order are the destination of */
+    /*   `deledge', its apex, the fourth one and the far vertex.       */
+    onext(*deledge, testtri);
+    onextself(testtri);
+    flip(m, b, &testtri);
+    /* `testtri' is now the edge from the apex to the far vertex in the */
+    /*   flat triangle.                                                 */
+    lprev(testtri, *deledge);
+    removedegree3vertex(m, b, deledge);
+    return 1;
+  }
+  return 0;
+}
+
+#endif /* not REDUCED */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  insertweightedvertex()   Insert a weighted vertex into a regular         */
+/*                           (weighted Delaunay) triangulation.              */
+/*                                                                           */
+/*  A vertex whose lifted point (x^2 + y^2 - weight) does not lie below the  */
+/*  lifted triangle containing it is redundant and is not inserted, of two   */
+/*  duplicates the one with the lower lifted point is kept.                  */
+/*  Otherwise it is inserted by insertvertex(), which flips only the edges   */
+/*  with a convex quadrilateral.  Then the edges of its star are checked     */
+/*  again as in the flip algorithm of Edelsbrunner and Shah:  a non-regular  */
+/*  edge is flipped if its quadrilateral is convex, or its reflex vertex is  */
+/*  removed by removeredundantvertex().  With collinear vertices, a spoke    */
+/*  can be non-regular too, its end vertex is removed in the same way.       */
+/*  Removed vertices are marked as UNDEADVERTEX.                             */
+/*                                                                           */
+/*  The vertices of the bounding box are treated as infinitely distant, as   */
+/*  in insertvertex(); they are never removed.                               */
+/*                                                                           */
+/*  Returns 1 if the vertex was inserted, 0 if it is redundant or a          */
+/*  duplicate.  Added mrkkrj.                                                */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef REDUCED
+
+#ifdef ANSI_DECLARATORS
+int insertweightedvertex(struct mesh *m, struct behavior *b,
+                         vertex newvertex)
+#else /* not ANSI_DECLARATORS */
+int insertweightedvertex(m, b, newvertex)
+struct mesh *m;
+struct behavior *b;
+vertex newvertex;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri searchtri, testtri;
+  struct otri spoke, linkedge, across;
+  vertex torg, tdest, tapex;
+  vertex rightvertex, leftvertex, farvertex;
+  REAL rightturn, leftturn;
+  enum locateresult intersect;
+  int changed, doflip;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  /* Locate the vertex. */
+  searchtri.tri = m->dummytri;
+  searchtri.orient = 0;
+  symself(searchtri);
+  intersect = locate(m, b, newvertex, &searchtri);
+  if (intersect == ONVERTEX) {
+    /* A duplicate:  the vertex with the lower lifted point is kept. */
+    org(searchtri, torg);
+    if ((b->weighted == 1) ? (newvertex[2] <= torg[2]) :
+                             (newvertex[2] >= torg[2])) {
+      return 0;
+    }
+    otricopy(searchtri, testtri);
+    do {
+      setorg(testtri, newvertex);
+      onextself(testtri);
+    } while (!otriequal(testtri, searchtri));
+    setvertextype(torg, UNDEADVERTEX);
+    m->undeads++;
+  } else {
+    /* Is it below the lifted triangle containing it?  If it lies on an */
+    /*   edge, either of the triangles of the edge can be used.         */
+    otricopy(searchtri, testtri);
+    apex(testtri, tapex);
+    if (isboxvertex(m, tapex) && (intersect == ONEDGE)) {
+      symself(testtri);
+    }
+    if (testtri.tri != m->dummytri) {
+      org(testtri, torg);
+      dest(testtri, tdest);
+      apex(testtri, tapex);
+      if (!isboxvertex(m, torg) && !isboxvertex(m, tdest) &&
+          !isboxvertex(m, tapex) &&
+          (nonregular(m, b, torg, tdest, tapex, newvertex) <= 0.0)) {
+        if (b->verbose > 1) {
+          printf("  Vertex (%.12g, %.12g) is redundant.\n",
+                 newvertex[0], newvertex[1]);
+        }
+        return 0;
+      }
+    }
+
+    if (intersect == ONEDGE) {
+      /* insertvertex() needs an edge with the vertex strictly left of it. */
+      lnextself(searchtri);
+    }
+    if (insertvertex(m, b, newvertex, &searchtri, (struct osub *) NULL, 0, 0)
+        == DUPLICATEVERTEX) {
+      return 0;
+    }
+  }
+
+  /* Change the star of the new vertex until all its edges are regular.  */
+  /*   `searchtri' is a handle whose origin is the new vertex.            */
+  do {
+    changed = 0;
+    otricopy(searchtri, spoke);
+    do {
+      /* A spoke can only be non-regular if its end vertex lies exactly */
+      /*   between its neighbors in the link, then it's redundant.      */
+      dest(spoke, rightvertex);
+      apex(spoke, leftvertex);
+      sym(spoke, testtri);
+      apex(testtri, farvertex);
+      if (!isboxvertex(m, rightvertex) && !isboxvertex(m, leftvertex) &&
+          !isboxvertex(m, farvertex) &&
+          (counterclockwise(m, b, leftvertex, rightvertex, farvertex)
+           == 0.0) &&
+          (nonregular(m, b, newvertex, rightvertex, leftvertex, farvertex)
+           > 0.0) &&
+          removeredundantvertex(m, b, &testtri, 1)) {
+        otricopy(testtri, linkedge);
+        changed = 1;
+        break;
+      }
+      /* The link edge opposite to the new vertex, and the far vertex. */
+      lnext(spoke, linkedge);
+      sym(linkedge, across);
+      onextself(spoke);
+      if (across.tri == m->dummytri) {
+        continue;
+      }
+      org(linkedge, rightvertex);
+      dest(linkedge, leftvertex);
+      apex(across, farvertex);
+      if (isboxvertex(m, leftvertex)) {
+        doflip = counterclockwise(m, b, newvertex, rightvertex, farvertex)
+                 > 0.0;
+      } else if (isboxvertex(m, rightvertex)) {
+        doflip = counterclockwise(m, b, farvertex, leftvertex, newvertex)
+                 > 0.0;
+      } else if (isboxvertex(m, farvertex)) {
+        doflip = 0;
+      } else if (nonregular(m, b, leftvertex, newvertex, rightvertex,
+                            farvertex) <= 0.0) {
+        doflip = 0;
+      } else {
+        rightturn = counterclockwise(m, b, newvertex, rightvertex, farvertex);
+        leftturn = counterclockwise(m, b, farvertex, leftvertex, newvertex);
+        doflip = (rightturn > 0.0) && (leftturn > 0.0);
+        if (!doflip) {
+          /* The quadrilateral isn't convex, try to remove its reflex    */
+          /*   vertex, which must be redundant.  Start from the side to  */
+          /*   have it as origin.                                        */
+          if (rightturn <= 0.0) {
+            changed = removeredundantvertex(m, b, &linkedge,
+                                            rightturn == 0.0);
+          } else {
+            changed = removeredundantvertex(m, b, &across, leftturn == 0.0);
+            otricopy(across, linkedge);
+          }
+        }
+      }
+
+      if (doflip) {
+        /* Upon completion the handle holds the edge from `farvertex' */
+        /*   to the new vertex.                                       */
+        flip(m, b, &linkedge);
+        changed = 1;
+      }
+    } while (!changed && !otriequal(spoke, searchtri));
+
+    if (changed) {
+      /* Find the new vertex in the changed triangle `linkedge'. */
+      otricopy(linkedge, searchtri);
+      org(searchtri, torg);
+      while (torg != newvertex) {
+        lnextself(searchtri);
+        org(searchtri, torg);
+      }
+    }
+  } while (changed);
+
+  otricopy(searchtri, m->recenttri);
+  return 1;
+}
+
+#endif /* not REDUCED */
+
 /*****************************************************************************/
 /*                                                                           */
 /*  incrementaldelaunay()   Form a Delaunay triangulation by incrementally   */
@@ -10385,6 +11284,15 @@ struct behavior *b;
   traversalinit(&m->vertices);
   vertexloop = vertextraverse(m);
   while (vertexloop != (vertex) NULL) {
+    if (b->weighted) {
+      /* Regular triangulation:  redundant vertices are left out. */
+      if (!insertweightedvertex(m, b, vertexloop)) {
+        setvertextype(vertexloop, UNDEADVERTEX);
+        m->undeads++;
+      }
+      vertexloop = vertextraverse(m);
+      continue;
+    }
     starttri.tri = m->dummytri;
     if (insertvertex(m, b, vertexloop, &starttri, (struct osub *) NULL, 0, 0)
         == DUPLICATEVERTEX) {
@@ -11141,6 +12049,9 @@ struct behavior *b;
   }
 
   pooldeinit(&m->splaynodes);
+  /* Free the event heap, it leaked before (added mrkkrj). */
+  trifree((VOID *) events);
+  trifree((VOID *) eventheap);
   lprevself(bottommost);
   return removeghosts(m, b, &bottommost);
 }
@@ -11211,68 +12122,352 @@ struct behavior *b;
 
 /*****************************************************************************/
 /*                                                                           */
-/*  reconstruct()   Reconstruct a triangulation from its .ele (and possibly  */
-/*                  .poly) file.  Used when the -r switch is used.           */
-/*                                                                           */
-/*  Reads an .ele file and reconstructs the original mesh.  If the -p switch */
-/*  is used, this procedure will also read a .poly file and reconstruct the  */
-/*  subsegments of the original mesh.  If the -a switch is used, this        */
-/*  procedure will also read an .area file and set a maximum area constraint */
-/*  on each triangle.                                                        */
-/*                                                                           */
-/*  Vertices that are not corners of triangles, such as nodes on edges of    */
-/*  subparametric elements, are discarded.                                   */
+/*  poolslotinit()   Set up the table poolslot() looks up the items in.      */
 /*                                                                           */
-/*  This routine finds the adjacencies between triangles (and subsegments)   */
-/*  by forming one stack of triangles for each vertex.  Each triangle is on  */
-/*  three different stacks simultaneously.  Each triangle's subsegment       */
-/*  pointers are used to link the items in each stack.  This memory-saving   */
-/*  feature makes the code harder to read.  The most important thing to keep */
-/*  in mind is that each triangle is removed from a stack precisely when     */
-/*  the corresponding pointer is adjusted to refer to a subsegment rather    */
-/*  than the next triangle of the stack.                                     */
+/*  The table is valid until the pool gets a new block.  Added mrkkrj.       */
 /*                                                                           */
 /*****************************************************************************/
 
-#ifndef CDT_ONLY
-
-#ifdef TRILIBRARY
-
 #ifdef ANSI_DECLARATORS
-int reconstruct(struct mesh *m, struct behavior *b, int *trianglelist,
-                REAL *triangleattriblist, REAL *trianglearealist,
-                int elements, int corners, int attribs,
-                int *segmentlist,int *segmentmarkerlist, int numberofsegments)
+void poolslotinit(struct memorypool *pool, struct poolslottable *table)
 #else /* not ANSI_DECLARATORS */
-int reconstruct(m, b, trianglelist, triangleattriblist, trianglearealist,
-                elements, corners, attribs, segmentlist, segmentmarkerlist,
-                numberofsegments)
-struct mesh *m;
-struct behavior *b;
-int *trianglelist;
-REAL *triangleattriblist;
-REAL *trianglearealist;
-int elements;
-int corners;
-int attribs;
-int *segmentlist;
-int *segmentmarkerlist;
-int numberofsegments;
+void poolslotinit(pool, table)
+struct memorypool *pool;
+struct poolslottable *table;
 #endif /* not ANSI_DECLARATORS */
 
-#else /* not TRILIBRARY */
+{
+  long blocks;
+  long i;
+
+  blocks = poolblocks(pool, (VOID **) NULL, (int *) NULL);
+  std::vector<VOID *> blockitems(blocks);
+  std::vector<int> blockcounts(blocks);
+  std::vector<long> order(blocks);
+  poolblocks(pool, blockitems.data(), blockcounts.data());
+  for (i = 0; i < blocks; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&blockitems](long lhs, long rhs) {
+    return std::less<char *>()((char *) blockitems[lhs],
+                               (char *) blockitems[rhs]);
+  });
+
+  /* Number the items in traversal order, then sort the blocks. */
+  std::vector<long> blockslots(blocks);
+  table->slots = 0;
+  for (i = 0; i < blocks; i++) {
+    blockslots[i] = table->slots;
+    table->slots += blockcounts[i];
+  }
+  table->blockitems.resize(blocks);
+  table->blockslots.resize(blocks);
+  table->blockcounts.resize(blocks);
+  for (i = 0; i < blocks; i++) {
+    table->blockitems[i] = (char *) blockitems[order[i]];
+    table->blockslots[i] = blockslots[order[i]];
+    table->blockcounts[i] = blockcounts[order[i]];
+  }
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  poolslot()   Find the number of an item in a pool, counting all items    */
+/*               (dead ones included) in traversal order.                    */
+/*                                                                           */
+/*  `table' must have been set up by poolslotinit().  The block holding the  */
+/*  item is found by a binary search over the block addresses.  Returns -1   */
+/*  if the item isn't in the pool.  Added mrkkrj.                            */
+/*                                                                           */
+/*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-long reconstruct(struct mesh *m, struct behavior *b, char *elefilename,
-                 char *areafilename, char *polyfilename, FILE *polyfile)
+long poolslot(struct memorypool *pool, struct poolslottable *table,
+              VOID *item)
 #else /* not ANSI_DECLARATORS */
-long reconstruct(m, b, elefilename, areafilename, polyfilename, polyfile)
-struct mesh *m;
-struct behavior *b;
-char *elefilename;
-char *areafilename;
-char *polyfilename;
-FILE *polyfile;
+long poolslot(pool, table, item)
+struct memorypool *pool;
+struct poolslottable *table;
+VOID *item;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  long i;
+  char *first;
+
+  i = (long) (std::upper_bound(table->blockitems.begin(),
+                               table->blockitems.end(), (char *) item,
+                               std::less<char *>()) -
+              table->blockitems.begin()) - 1;
+  if (i < 0) {
+    return -1l;
+  }
+  first = table->blockitems[i];
+  if ((char *) item >= first + table->blockcounts[i] * pool->itembytes) {
+    return -1l;
+  }
+  return table->blockslots[i] + ((char *) item - first) / pool->itembytes;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  savedelaunay()   Store the triangulation created by delaunay() as        */
+/*                   vertex and neighbor numbers.                            */
+/*                                                                           */
+/*  For each living triangle (in traversal order) `corners' gets the numbers */
+/*  of its origin, destination and apex (vertices counted from zero in pool  */
+/*  order), and `neighbors' the neighbors opposite them as oriented          */
+/*  triangles (3 * triangle number + orientation, -1 on the convex hull).    */
+/*  Both need room for 3 * m->triangles.items numbers, `undeadvertices' for  */
+/*  m->undeads numbers.  Returns the oriented triangle point location starts */
+/*  from, to be given to restoredelaunay().                                  */
+/*                                                                           */
+/*  Added mrkkrj: the Delaunay triangulation of the input vertices can be    */
+/*  cached and reused for different segments, holes and quality switches.   */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+int savedelaunay(struct mesh *m, int *corners, int *neighbors,
+                 int *undeadvertices)
+#else /* not ANSI_DECLARATORS */
+int savedelaunay(m, corners, neighbors, undeadvertices)
+struct mesh *m;
+int *corners;
+int *neighbors;
+int *undeadvertices;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri triangleloop;
+  struct otri neighbor;
+  struct poolslottable trislots, vertslots;
+  int *trinumbers;
+  long number;
+  vertex vertexloop;
+  vertex tvertex;
+  int hullstart;
+  int i, j;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  /* Find the blocks of the triangle and vertex pools. */
+  poolslotinit(&m->triangles, &trislots);
+  poolslotinit(&m->vertices, &vertslots);
+
+  /* Number the living triangles; dead ones leave gaps in the pool. */
+  trinumbers = (int *) trimalloc((int) ((trislots.slots + 1) * sizeof(int)));
+  number = 0;
+  traversalinit(&m->triangles);
+  triangleloop.tri = triangletraverse(m);
+  while (triangleloop.tri != (triangle *) NULL) {
+    trinumbers[poolslot(&m->triangles, &trislots,
+                        (VOID *) triangleloop.tri)] = (int) number;
+    number++;
+    triangleloop.tri = triangletraverse(m);
+  }
+
+  number = 0;
+  traversalinit(&m->triangles);
+  triangleloop.tri = triangletraverse(m);
+  while (triangleloop.tri != (triangle *) NULL) {
+    for (triangleloop.orient = 0; triangleloop.orient < 3;
+         triangleloop.orient++) {
+      j = (int) (3 * number + triangleloop.orient);
+      org(triangleloop, tvertex);
+      corners[j] = (int) poolslot(&m->vertices, &vertslots,
+                                  (VOID *) tvertex);
+      /* The neighbor opposite the origin lies across the edge dest-apex. */
+      lnext(triangleloop, neighbor);
+      symself(neighbor);
+      if (neighbor.tri == m->dummytri) {
+        neighbors[j] = -1;
+      } else {
+        neighbors[j] = 3 * trinumbers[poolslot(&m->triangles, &trislots,
+                                               (VOID *) neighbor.tri)] +
+                       neighbor.orient;
+      }
+    }
+    number++;
+    triangleloop.tri = triangletraverse(m);
+  }
+
+  decode(m->dummytri[0], neighbor);
+  hullstart = 3 * trinumbers[poolslot(&m->triangles, &trislots,
+                                      (VOID *) neighbor.tri)] +
+              neighbor.orient;
+
+  /* Note the duplicate input vertices. */
+  number = 0;
+  i = 0;
+  traversalinit(&m->vertices);
+  vertexloop = vertextraverse(m);
+  while (vertexloop != (vertex) NULL) {
+    if (vertextype(vertexloop) == UNDEADVERTEX) {
+      undeadvertices[i++] = (int) number;
+    }
+    number++;
+    vertexloop = vertextraverse(m);
+  }
+
+  trifree((VOID *) trinumbers);
+  return hullstart;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  restoredelaunay()   Rebuild a triangulation stored by savedelaunay() for */
+/*                      the same vertices, in place of delaunay().           */
+/*                                                                           */
+/*  The vertices must have been transferred in the same order as for the     */
+/*  saved triangulation.  The triangle and subsegment pools are set up for   */
+/*  the current switches.  Returns the number of edges on the convex hull,   */
+/*  which must be passed in `hullsize' as it isn't stored.  Added mrkkrj.    */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+long restoredelaunay(struct mesh *m, struct behavior *b, int *corners,
+                     int *neighbors, long triangles, int hullstart,
+                     int *undeadvertices, int undeadcount, long hullsize)
+#else /* not ANSI_DECLARATORS */
+long restoredelaunay(m, b, corners, neighbors, triangles, hullstart,
+                     undeadvertices, undeadcount, hullsize)
+struct mesh *m;
+struct behavior *b;
+int *corners;
+int *neighbors;
+long triangles;
+int hullstart;
+int *undeadvertices;
+int undeadcount;
+long hullsize;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri triangleloop;
+  struct otri neighbor;
+  triangle **trianglearray;
+  vertex *vertexarray;
+  long i;
+  int j;
+
+  m->eextras = 0;
+  initializetrisubpools(m, b);
+
+  if (!b->quiet) {
+    printf("Restoring the cached Delaunay triangulation.\n");
+  }
+
+  vertexarray = (vertex *) trimalloc((int) (m->vertices.items *
+                                            sizeof(vertex)));
+  traversalinit(&m->vertices);
+  for (i = 0; i < m->vertices.items; i++) {
+    vertexarray[i] = vertextraverse(m);
+  }
+  for (j = 0; j < undeadcount; j++) {
+    setvertextype(vertexarray[undeadvertices[j]], UNDEADVERTEX);
+  }
+  m->undeads = undeadcount;
+
+  trianglearray = (triangle **) trimalloc((int) ((triangles + 1) *
+                                                 sizeof(triangle *)));
+  for (i = 0; i < triangles; i++) {
+    maketriangle(m, b, &triangleloop);
+    setorg(triangleloop, vertexarray[corners[3 * i]]);
+    setdest(triangleloop, vertexarray[corners[3 * i + 1]]);
+    setapex(triangleloop, vertexarray[corners[3 * i + 2]]);
+    trianglearray[i] = triangleloop.tri;
+  }
+
+  for (i = 0; i < triangles; i++) {
+    triangleloop.tri = trianglearray[i];
+    for (triangleloop.orient = 0; triangleloop.orient < 3;
+         triangleloop.orient++) {
+      j = neighbors[3 * i + triangleloop.orient];
+      if (j >= 0) {
+        /* Bond the edge dest-apex to its neighbor. */
+        neighbor.tri = trianglearray[j / 3];
+        neighbor.orient = j % 3;
+        lnextself(triangleloop);
+        bond(triangleloop, neighbor);
+        lprevself(triangleloop);
+      }
+    }
+  }
+
+  triangleloop.tri = trianglearray[hullstart / 3];
+  triangleloop.orient = hullstart % 3;
+  m->dummytri[0] = encode(triangleloop);
+
+  trifree((VOID *) trianglearray);
+  trifree((VOID *) vertexarray);
+  return hullsize;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  reconstruct()   Reconstruct a triangulation from its .ele (and possibly  */
+/*                  .poly) file.  Used when the -r switch is used.           */
+/*                                                                           */
+/*  Reads an .ele file and reconstructs the original mesh.  If the -p switch */
+/*  is used, this procedure will also read a .poly file and reconstruct the  */
+/*  subsegments of the original mesh.  If the -a switch is used, this        */
+/*  procedure will also read an .area file and set a maximum area constraint */
+/*  on each triangle.                                                        */
+/*                                                                           */
+/*  Vertices that are not corners of triangles, such as nodes on edges of    */
+/*  subparametric elements, are discarded.                                   */
+/*                                                                           */
+/*  This routine finds the adjacencies between triangles (and subsegments)   */
+/*  by forming one stack of triangles for each vertex.  Each triangle is on  */
+/*  three different stacks simultaneously.  Each triangle's subsegment       */
+/*  pointers are used to link the items in each stack.  This memory-saving   */
+/*  feature makes the code harder to read.  The most important thing to keep */
+/*  in mind is that each triangle is removed from a stack precisely when     */
+/*  the corresponding pointer is adjusted to refer to a subsegment rather    */
+/*  than the next triangle of the stack.                                     */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef CDT_ONLY
+
+#ifdef TRILIBRARY
+
+#ifdef ANSI_DECLARATORS
+int reconstruct(struct mesh *m, struct behavior *b, int *trianglelist,
+                REAL *triangleattriblist, REAL *trianglearealist,
+                int elements, int corners, int attribs,
+                int *segmentlist,int *segmentmarkerlist, int numberofsegments)
+#else /* not ANSI_DECLARATORS */
+int reconstruct(m, b, trianglelist, triangleattriblist, trianglearealist,
+                elements, corners, attribs, segmentlist, segmentmarkerlist,
+                numberofsegments)
+struct mesh *m;
+struct behavior *b;
+int *trianglelist;
+REAL *triangleattriblist;
+REAL *trianglearealist;
+int elements;
+int corners;
+int attribs;
+int *segmentlist;
+int *segmentmarkerlist;
+int numberofsegments;
+#endif /* not ANSI_DECLARATORS */
+
+#else /* not TRILIBRARY */
+
+#ifdef ANSI_DECLARATORS
+long reconstruct(struct mesh *m, struct behavior *b, char *elefilename,
+                 char *areafilename, char *polyfilename, FILE *polyfile)
+#else /* not ANSI_DECLARATORS */
+long reconstruct(m, b, elefilename, areafilename, polyfilename, polyfile)
+struct mesh *m;
+struct behavior *b;
+char *elefilename;
+char *areafilename;
+char *polyfilename;
+FILE *polyfile;
 #endif /* not ANSI_DECLARATORS */
 
 #endif /* not TRILIBRARY */
@@ -12431,6 +13626,15 @@ int newmark;
     decode(encodedtri, searchtri1);
     org(searchtri1, checkvertex);
   }
+  if ((checkvertex != endpoint1) && b->segmenthints &&
+      (m->recenttri.tri != (triangle *) NULL) && !deadtri(m->recenttri.tri)) {
+    /* Walk from the triangle reached by the previous insertion (added */
+    /*   mrkkrj).                                                      */
+    otricopy(m->recenttri, searchtri1);
+    if (walklocate(m, b, endpoint1, &searchtri1) == ONVERTEX) {
+      checkvertex = endpoint1;
+    }
+  }
   if (checkvertex != endpoint1) {
     /* Find a boundary triangle to search from. */
     searchtri1.tri = m->dummytri;
@@ -12464,6 +13668,13 @@ int newmark;
     decode(encodedtri, searchtri2);
     org(searchtri2, checkvertex);
   }
+  if ((checkvertex != endpoint2) && b->segmenthints &&
+      (m->recenttri.tri != (triangle *) NULL) && !deadtri(m->recenttri.tri)) {
+    otricopy(m->recenttri, searchtri2);
+    if (walklocate(m, b, endpoint2, &searchtri2) == ONVERTEX) {
+      checkvertex = endpoint2;
+    }
+  }
   if (checkvertex != endpoint2) {
     /* Find a boundary triangle to search from. */
     searchtri2.tri = m->dummytri;
@@ -12547,6 +13758,132 @@ struct behavior *b;
   } while (!otriequal(hulltri, starttri));
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  insertedgesegments()   Insert the PSLG segments which are already edges  */
+/*                         of the triangulation.                             */
+/*                                                                           */
+/*  The segments are looked up concurrently with `b->threads' threads, by    */
+/*  walking around the triangles of the first endpoint as given by the map   */
+/*  from vertices to triangles (no flips happened yet, so it's up to date).  */
+/*  This needs no geometric tests at all and doesn't change the mesh. Then   */
+/*  the found subsegments are created serially, as the creation allocates    */
+/*  from the memory pool. Each segment that was inserted is flagged in       */
+/*  `inserted'; the remaining ones must be inserted by insertsegment().      */
+/*                                                                           */
+/*  Only this pre-pass is parallel.  The segments crossing edges of the      */
+/*  triangulation are recovered serially by insertsegment(), as the flips    */
+/*  change the neighbouring triangles and all the insertions share the       */
+/*  mesh's pools and the flip stack.  The scaling with the thread count      */
+/*  wasn't measured (single core only).  Added mrkkrj.                       */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef TRILIBRARY
+
+#ifdef ANSI_DECLARATORS
+long insertedgesegments(struct mesh *m, struct behavior *b, int *segmentlist,
+                        int *segmentmarkerlist, int numberofsegments,
+                        char *inserted)
+#else /* not ANSI_DECLARATORS */
+long insertedgesegments(m, b, segmentlist, segmentmarkerlist,
+                        numberofsegments, inserted)
+struct mesh *m;
+struct behavior *b;
+int *segmentlist;
+int *segmentmarkerlist;
+int numberofsegments;
+char *inserted;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri edgetri;
+  long insertedcount;
+  int i;
+
+  /* An oriented triangle with the segment as its edge, or NULL. */
+  std::vector<triangle> edges(numberofsegments, (triangle) NULL);
+
+  tpp::parallelFor((long) numberofsegments, b->threads,
+                   [&](long firstsegment, long lastsegment) {
+    struct otri starttri, searchtri;
+    vertex endpoint1, endpoint2;
+    vertex checkvertex;
+    triangle encodedtri;
+    triangle ptr;           /* Temporary variable used by sym() and onext(). */
+    int end1, end2;
+    int found;
+    long k;
+
+    for (k = firstsegment; k < lastsegment; k++) {
+      end1 = segmentlist[2 * k];
+      end2 = segmentlist[2 * k + 1];
+      if ((end1 < b->firstnumber) ||
+          (end1 >= b->firstnumber + m->invertices) ||
+          (end2 < b->firstnumber) ||
+          (end2 >= b->firstnumber + m->invertices) || (end1 == end2)) {
+        /* Left to the serial loop, which reports it. */
+        continue;
+      }
+      endpoint1 = getvertex(m, b, end1);
+      endpoint2 = getvertex(m, b, end2);
+      encodedtri = vertex2tri(endpoint1);
+      if (encodedtri == (triangle) NULL) {
+        continue;
+      }
+      decode(encodedtri, starttri);
+      org(starttri, checkvertex);
+      if (checkvertex != endpoint1) {
+        continue;
+      }
+
+      /* Go counterclockwise around the first endpoint, and if the */
+      /*   hull is reached, clockwise.                             */
+      found = 0;
+      otricopy(starttri, searchtri);
+      do {
+        dest(searchtri, checkvertex);
+        if (checkvertex == endpoint2) {
+          found = 1;
+          break;
+        }
+        onextself(searchtri);
+      } while ((searchtri.tri != m->dummytri) &&
+               !otriequal(searchtri, starttri));
+      if (!found && (searchtri.tri == m->dummytri)) {
+        otricopy(starttri, searchtri);
+        do {
+          apex(searchtri, checkvertex);
+          if (checkvertex == endpoint2) {
+            lprevself(searchtri);
+            found = 1;
+            break;
+          }
+          oprevself(searchtri);
+        } while (searchtri.tri != m->dummytri);
+      }
+      if (found) {
+        edges[k] = encode(searchtri);
+      }
+    }
+  });
+
+  insertedcount = 0;
+  for (i = 0; i < numberofsegments; i++) {
+    if (edges[i] != (triangle) NULL) {
+      decode(edges[i], edgetri);
+      insertsubseg(m, b, &edgetri, segmentmarkerlist != (int *) NULL ?
+                                   segmentmarkerlist[i] : 0);
+      inserted[i] = 1;
+      insertedcount++;
+    }
+  }
+
+  return insertedcount;
+}
+
+#endif /* TRILIBRARY */
+
 /*****************************************************************************/
 /*                                                                           */
 /*  formskeleton()   Create the segments of a triangulation, including PSLG  */
@@ -12591,6 +13928,7 @@ char *polyfilename;
 #ifdef TRILIBRARY
   char polyfilename[6];
   int index;
+  long edgecount;
 #else /* not TRILIBRARY */
   char inputline[INPUTLINESIZE];
   char *stringptr;
@@ -12637,12 +13975,29 @@ char *polyfilename;
       }
     }
 
+#ifdef TRILIBRARY
+    /* With several threads, first take the segments which are edges of */
+    /*   the triangulation already (added mrkkrj).                      */
+    std::vector<char> inserted(m->insegments, 0);
+    if ((m->insegments > 0) && (b->threads > 1)) {
+      edgecount = insertedgesegments(m, b, segmentlist, segmentmarkerlist,
+                                     m->insegments, inserted.data());
+      if (b->verbose) {
+        printf("  %ld segments are edges of the triangulation.\n",
+               edgecount);
+      }
+    }
+#endif /* TRILIBRARY */
+
     boundmarker = 0;
     /* Read and insert the segments. */
     for (i = 0; i < m->insegments; i++) {
 #ifdef TRILIBRARY
       end1 = segmentlist[index++];
       end2 = segmentlist[index++];
+      if (inserted[i]) {
+        continue;
+      }
       if (segmentmarkers) {
         boundmarker = segmentmarkerlist[i];
       }
@@ -12967,6 +14322,90 @@ struct behavior *b;
   } while (!otriequal(hulltri, starttri));
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  infectholerings()   Virally infect all of the triangles enclosed by an   */
+/*                      odd number of hole rings, i.e. of subsegments marked */
+/*                      with `b->holeringmark'.                              */
+/*                                                                           */
+/*  A single flood fill over the triangulation, starting on the convex hull. */
+/*  The parity flips each time a hole ring's subsegment is crossed, thus no  */
+/*  points inside of the holes and no point location are needed.  Must be   */
+/*  called before any other triangle is infected. (added mrkkrj)             */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void infectholerings(struct mesh *m, struct behavior *b)
+#else /* not ANSI_DECLARATORS */
+void infectholerings(m, b)
+struct mesh *m;
+struct behavior *b;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  TRACE(" -> infectholerings");
+  struct otri testtri;
+  struct otri neighbor;
+  struct osub checksubseg;
+  triangle **holetri;
+  std::vector<triangle *> visited;
+  std::vector<char> inside;
+  size_t next;
+  char parity;
+  triangle ptr;             /* Temporary variable used by sym() and onext(). */
+  subseg sptr;                      /* Temporary variable used by tspivot(). */
+
+  if (b->verbose) {
+    printf("  Marking triangles inside of hole rings.\n");
+  }
+  visited.reserve(m->triangles.items);
+  inside.reserve(m->triangles.items);
+
+  /* Start with a triangle on the hull, it's outside of all the rings */
+  /*   unless its hull edge belongs to one.                           */
+  testtri.tri = m->dummytri;
+  testtri.orient = 0;
+  symself(testtri);
+  tspivot(testtri, checksubseg);
+  parity = (checksubseg.ss != m->dummysub) &&
+           (mark(checksubseg) == b->holeringmark);
+  /* The infection marks the visited triangles in the first pass. */
+  infect(testtri);
+  visited.push_back(testtri.tri);
+  inside.push_back(parity);
+
+  for (next = 0; next < visited.size(); next++) {
+    testtri.tri = visited[next];
+    parity = inside[next];
+    /* Uninfect the triangle temporarily to examine its subsegments. */
+    uninfect(testtri);
+    for (testtri.orient = 0; testtri.orient < 3; testtri.orient++) {
+      sym(testtri, neighbor);
+      if ((neighbor.tri != m->dummytri) && !infected(neighbor)) {
+        tspivot(testtri, checksubseg);
+        infect(neighbor);
+        visited.push_back(neighbor.tri);
+        inside.push_back(parity ^ ((checksubseg.ss != m->dummysub) &&
+                                   (mark(checksubseg) == b->holeringmark)));
+      }
+    }
+    infect(testtri);
+  }
+
+  /* Keep the infection only inside of the holes, and let plague() */
+  /*   spread it from there.                                       */
+  for (next = 0; next < visited.size(); next++) {
+    testtri.tri = visited[next];
+    uninfect(testtri);
+    if (inside[next]) {
+      infect(testtri);
+      holetri = (triangle **) poolalloc(&m->viri);
+      *holetri = testtri.tri;
+    }
+  }
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  plague()   Spread the virus from all infected triangles to any neighbors */
@@ -13299,12 +14738,97 @@ REAL area;
 
 /*****************************************************************************/
 /*                                                                           */
-/*  carveholes()   Find the holes and infect them.  Find the area            */
-/*                 constraints and infect them.  Infect the convex hull.     */
-/*                 Spread the infection and kill triangles.  Spread the      */
-/*                 area constraints.                                         */
+/*  labelregions()   Spread the regional attributes and/or area constraints  */
+/*                   of all the regions in a single pass.                    */
 /*                                                                           */
-/*  This routine mainly calls other routines to carry out all these          */
+/*  Replaces one regionplague() call per region: each segment-bounded part   */
+/*  of the mesh is flooded once, starting from the triangle of the last      */
+/*  region point lying in it (thus the same result as calling regionplague() */
+/*  in the order of the regions), and all triangles are uninfected in one    */
+/*  sweep at the end. (added mrkkrj)                                         */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void labelregions(struct mesh *m, struct behavior *b, struct otri *regiontris,
+                  REAL *regionlist, int regions)
+#else /* not ANSI_DECLARATORS */
+void labelregions(m, b, regiontris, regionlist, regions)
+struct mesh *m;
+struct behavior *b;
+struct otri *regiontris;
+REAL *regionlist;
+int regions;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  TRACE(" -> labelregions");
+  struct otri testtri;
+  struct otri neighbor;
+  struct osub neighborsubseg;
+  std::vector<triangle *> flooded;
+  size_t next;
+  REAL attribute, area;
+  int i;
+  triangle ptr;             /* Temporary variable used by sym() and onext(). */
+  subseg sptr;                      /* Temporary variable used by tspivot(). */
+
+  if (b->verbose > 1) {
+    printf("  Labelling the regions.\n");
+  }
+  /* The last region point wins, as it would overwrite the earlier ones. */
+  for (i = regions - 1; i >= 0; i--) {
+    /* Make sure the triangle under consideration still exists, it may */
+    /*   have been eaten by the virus, or is labelled already.         */
+    if ((regiontris[i].tri == m->dummytri) || deadtri(regiontris[i].tri) ||
+        infected(regiontris[i])) {
+      continue;
+    }
+    attribute = regionlist[4 * i + 2];
+    area = regionlist[4 * i + 3];
+
+    next = flooded.size();
+    infect(regiontris[i]);
+    flooded.push_back(regiontris[i].tri);
+
+    for (; next < flooded.size(); next++) {
+      testtri.tri = flooded[next];
+      /* Uninfect the triangle temporarily to examine its subsegments. */
+      uninfect(testtri);
+      if (b->regionattrib) {
+        setelemattribute(testtri, m->eextras, attribute);
+      }
+      if (b->vararea) {
+        setareabound(testtri, area);
+      }
+      for (testtri.orient = 0; testtri.orient < 3; testtri.orient++) {
+        sym(testtri, neighbor);
+        tspivot(testtri, neighborsubseg);
+        if ((neighbor.tri != m->dummytri) && !infected(neighbor)
+            && (neighborsubseg.ss == m->dummysub)) {
+          infect(neighbor);
+          flooded.push_back(neighbor.tri);
+        }
+      }
+      infect(testtri);
+    }
+  }
+
+  /* Uninfect all triangles. */
+  for (next = 0; next < flooded.size(); next++) {
+    testtri.tri = flooded[next];
+    uninfect(testtri);
+  }
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  carveholes()   Find the holes and infect them.  Find the area            */
+/*                 constraints and infect them.  Infect the convex hull.     */
+/*                 Spread the infection and kill triangles.  Spread the      */
+/*                 area constraints.                                         */
+/*                                                                           */
+/*  This routine mainly calls other routines to carry out all these          */
 /*  functions.                                                               */
 /*                                                                           */
 /*****************************************************************************/
@@ -13328,9 +14852,9 @@ int regions;
   struct otri triangleloop;
   struct otri *regiontris;
   triangle **holetri;
-  triangle **regiontri;
   vertex searchorg, searchdest;
   enum locateresult intersect;
+  REAL walkdistance;
   int i;
   triangle ptr;                         /* Temporary variable used by sym(). */
 
@@ -13349,12 +14873,18 @@ int regions;
     regiontris = (struct otri *) NULL;
   }
 
-  if (((holes > 0) && !b->noholes) || !b->convex || (regions > 0)) {
+  if (((holes > 0) && !b->noholes) || !b->convex || (regions > 0) ||
+      (b->holeringmark && !b->noholes)) {
     /* Initialize a pool of viri to be used for holes, concavities, */
     /*   regional attributes, and/or regional area constraints.     */
     poolinit(&m->viri, sizeof(triangle *), VIRUSPERBLOCK, VIRUSPERBLOCK, 0);
   }
 
+  if (b->holeringmark && !b->noholes) {
+    /* Infect the triangles inside of the hole rings (added mrkkrj). */
+    infectholerings(m, b);
+  }
+
   if (!b->convex) {
     /* Mark as infected any unprotected triangles on the boundary. */
     /*   This is one way by which concavities are created.         */
@@ -13399,6 +14929,11 @@ int regions;
   /*   might not be convex; they can only be used with a freshly             */
   /*   triangulated PSLG.)                                                   */
   if (regions > 0) {
+    /* A region point closer to the previous one than about eight       */
+    /*   triangles is found by walking from the previous one's triangle */
+    /*   (added mrkkrj).                                                */
+    walkdistance = 64.0 * (m->xmax - m->xmin) * (m->ymax - m->ymin) /
+                   (REAL) m->triangles.items;
     /* Find the starting triangle for each region. */
     for (i = 0; i < regions; i++) {
       regiontris[i].tri = m->dummytri;
@@ -13406,6 +14941,18 @@ int regions;
       if ((regionlist[4 * i] >= m->xmin) && (regionlist[4 * i] <= m->xmax) &&
           (regionlist[4 * i + 1] >= m->ymin) &&
           (regionlist[4 * i + 1] <= m->ymax)) {
+        if ((i > 0) && (regiontris[i - 1].tri != m->dummytri) &&
+            ((regionlist[4 * i] - regionlist[4 * i - 4]) *
+             (regionlist[4 * i] - regionlist[4 * i - 4]) +
+             (regionlist[4 * i + 1] - regionlist[4 * i - 3]) *
+             (regionlist[4 * i + 1] - regionlist[4 * i - 3]) < walkdistance)) {
+          otricopy(regiontris[i - 1], searchtri);
+          intersect = walklocate(m, b, &regionlist[4 * i], &searchtri);
+          if ((intersect != OUTSIDE) && (!infected(searchtri))) {
+            otricopy(searchtri, regiontris[i]);
+          }
+          continue;
+        }
         /* Start searching from some triangle on the outer boundary. */
         searchtri.tri = m->dummytri;
         searchtri.orient = 0;
@@ -13457,21 +15004,9 @@ int regions;
         triangleloop.tri = triangletraverse(m);
       }
     }
-    for (i = 0; i < regions; i++) {
-      if (regiontris[i].tri != m->dummytri) {
-        /* Make sure the triangle under consideration still exists. */
-        /*   It may have been eaten by the virus.                   */
-        if (!deadtri(regiontris[i].tri)) {
-          /* Put one triangle in the virus pool. */
-          infect(regiontris[i]);
-          regiontri = (triangle **) poolalloc(&m->viri);
-          *regiontri = regiontris[i].tri;
-          /* Apply one region's attribute and/or area constraint. */
-          regionplague(m, b, regionlist[4 * i + 2], regionlist[4 * i + 3]);
-          /* The virus pool should be empty now. */
-        }
-      }
-    }
+    /* Apply all the regions' attributes and/or area constraints in one */
+    /*   pass (changed mrkkrj).                                          */
+    labelregions(m, b, regiontris, regionlist, regions);
     if (b->regionattrib && !b->refine) {
       /* Note the fact that each triangle has an additional attribute. */
       m->eextras++;
@@ -13479,7 +15014,8 @@ int regions;
   }
 
   /* Free up memory. */
-  if (((holes > 0) && !b->noholes) || !b->convex || (regions > 0)) {
+  if (((holes > 0) && !b->noholes) || !b->convex || (regions > 0) ||
+      (b->holeringmark && !b->noholes)) {
     pooldeinit(&m->viri);
   }
   if (regions > 0) {
@@ -13970,6 +15506,19 @@ struct behavior *b;
   /* Initialize the pool of encroached subsegments. */
   poolinit(&m->badsubsegs, sizeof(struct badsubseg), BADSUBSEGPERBLOCK,
            BADSUBSEGPERBLOCK, 0);
+  if ((b->minangle > 0.0) || b->vararea || b->fixedarea || b->usertest ||
+      (b->sizingfield.areas != (REAL *) NULL)) {
+    /* Initialize the pool and the queues of bad triangles.  Done before   */
+    /*   the encroached subsegments are split, as in a mesh refined once   */
+    /*   more the free vertices deleted from their diametral circles note  */
+    /*   new bad triangles (moved mrkkrj).                                 */
+    poolinit(&m->badtriangles, sizeof(struct badtriang), BADTRIPERBLOCK,
+             BADTRIPERBLOCK, 0);
+    for (i = 0; i < 4096; i++) {
+      m->queuefront[i] = (struct badtriang *) NULL;
+    }
+    m->firstnonemptyq = -1;
+  }
   if (b->verbose) {
     printf("  Looking for encroached subsegments.\n");
   }
@@ -13984,15 +15533,8 @@ struct behavior *b;
   /*   triangulation should be (conforming) Delaunay.            */
 
   /* Next, we worry about enforcing triangle quality. */
-  if ((b->minangle > 0.0) || b->vararea || b->fixedarea || b->usertest) {
-    /* Initialize the pool of bad triangles. */
-    poolinit(&m->badtriangles, sizeof(struct badtriang), BADTRIPERBLOCK,
-             BADTRIPERBLOCK, 0);
-    /* Initialize the queues of bad triangles. */
-    for (i = 0; i < 4096; i++) {
-      m->queuefront[i] = (struct badtriang *) NULL;
-    }
-    m->firstnonemptyq = -1;
+  if ((b->minangle > 0.0) || b->vararea || b->fixedarea || b->usertest ||
+      (b->sizingfield.areas != (REAL *) NULL)) {
     /* Test all triangles to see if they're bad. */
     tallyfaces(m, b);
     /* Initialize the pool of recently flipped triangles. */
@@ -14003,6 +15545,13 @@ struct behavior *b;
       printf("  Splitting bad triangles.\n");
     }
     while ((m->badtriangles.items > 0) && (m->steinerleft != 0)) {
+      /* Ask whether the refinement should go on.  The mesh is valid here, */
+      /*   with no encroached subsegments.                                 */
+      if ((b->refinementcheck != NULL) &&
+          !b->refinementcheck(m->vertices.items - m->invertices,
+                              m->badtriangles.items, b->refinementcontext)) {
+        break;
+      }
       /* Fix one bad triangle by inserting a vertex at its circumcenter. */
       badtri = dequeuebadtriang(m);
       splittriangle(m, b, badtri);
@@ -14017,6 +15566,8 @@ struct behavior *b;
         pooldealloc(&m->badtriangles, (VOID *) badtri);
       }
     }
+    /* Stopped early, or ran out of Steiner points? */
+    m->refinementstopped = (m->badtriangles.items > 0);
   }
   /* At this point, if the "-D" switch was selected and we haven't run out  */
   /*   of Steiner points, the triangulation should be (conforming) Delaunay */
@@ -14042,225 +15593,1149 @@ struct behavior *b;
 
 #endif /* not CDT_ONLY */
 
-/**                                                                         **/
-/**                                                                         **/
-/********* Mesh quality maintenance ends here                        *********/
-
 /*****************************************************************************/
 /*                                                                           */
-/*  highorder()   Create extra nodes for quadratic subparametric elements.   */
+/*  triangleminangle()   Return the smallest angle of a triangle, in degrees.*/
+/*                                                                           */
+/*  Uses no exact arithmetic and no counters, thus can be called from        */
+/*  several threads.  Added mrkkrj.                                          */
 /*                                                                           */
 /*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-void highorder(struct mesh *m, struct behavior *b)
+REAL triangleminangle(vertex torg, vertex tdest, vertex tapex)
 #else /* not ANSI_DECLARATORS */
-void highorder(m, b)
-struct mesh *m;
-struct behavior *b;
+REAL triangleminangle(torg, tdest, tapex)
+vertex torg;
+vertex tdest;
+vertex tapex;
 #endif /* not ANSI_DECLARATORS */
 
 {
-  struct otri triangleloop, trisym;
-  struct osub checkmark;
-  vertex newvertex;
-  vertex torg, tdest;
+  vertex corner[3];
+  REAL ux, uy, vx, vy;
+  REAL angle, minangle;
   int i;
-  triangle ptr;                         /* Temporary variable used by sym(). */
-  subseg sptr;                      /* Temporary variable used by tspivot(). */
-
-  if (!b->quiet) {
-    printf("Adding vertices for second-order triangles.\n");
-  }
-  /* The following line ensures that dead items in the pool of nodes    */
-  /*   cannot be allocated for the extra nodes associated with high     */
-  /*   order elements.  This ensures that the primary nodes (at the     */
-  /*   corners of elements) will occur earlier in the output files, and */
-  /*   have lower indices, than the extra nodes.                        */
-  m->vertices.deaditemstack = (VOID *) NULL;
 
-  traversalinit(&m->triangles);
-  triangleloop.tri = triangletraverse(m);
-  /* To loop over the set of edges, loop over all triangles, and look at   */
-  /*   the three edges of each triangle.  If there isn't another triangle  */
-  /*   adjacent to the edge, operate on the edge.  If there is another     */
-  /*   adjacent triangle, operate on the edge only if the current triangle */
-  /*   has a smaller pointer than its neighbor.  This way, each edge is    */
-  /*   considered only once.                                               */
-  while (triangleloop.tri != (triangle *) NULL) {
-    for (triangleloop.orient = 0; triangleloop.orient < 3;
-         triangleloop.orient++) {
-      sym(triangleloop, trisym);
-      if ((triangleloop.tri < trisym.tri) || (trisym.tri == m->dummytri)) {
-        org(triangleloop, torg);
-        dest(triangleloop, tdest);
-        /* Create a new node in the middle of the edge.  Interpolate */
-        /*   its attributes.                                         */
-        newvertex = (vertex) poolalloc(&m->vertices);
-        for (i = 0; i < 2 + m->nextras; i++) {
-          newvertex[i] = 0.5 * (torg[i] + tdest[i]);
-        }
-        /* Set the new node's marker to zero or one, depending on */
-        /*   whether it lies on a boundary.                       */
-        setvertexmark(newvertex, trisym.tri == m->dummytri);
-        setvertextype(newvertex,
-                      trisym.tri == m->dummytri ? FREEVERTEX : SEGMENTVERTEX);
-        if (b->usesegments) {
-          tspivot(triangleloop, checkmark);
-          /* If this edge is a segment, transfer the marker to the new node. */
-          if (checkmark.ss != m->dummysub) {
-            setvertexmark(newvertex, mark(checkmark));
-            setvertextype(newvertex, SEGMENTVERTEX);
-          }
-        }
-        if (b->verbose > 1) {
-          printf("  Creating (%.12g, %.12g).\n", newvertex[0], newvertex[1]);
-        }
-        /* Record the new node in the (one or two) adjacent elements. */
-        triangleloop.tri[m->highorderindex + triangleloop.orient] =
-                (triangle) newvertex;
-        if (trisym.tri != m->dummytri) {
-          trisym.tri[m->highorderindex + trisym.orient] = (triangle) newvertex;
-        }
-      }
-    }
-    triangleloop.tri = triangletraverse(m);
-  }
+  corner[0] = torg;
+  corner[1] = tdest;
+  corner[2] = tapex;
+  minangle = 180.0;
+  for (i = 0; i < 3; i++) {
+    ux = corner[(i + 1) % 3][0] - corner[i][0];
+    uy = corner[(i + 1) % 3][1] - corner[i][1];
+    vx = corner[(i + 2) % 3][0] - corner[i][0];
+    vy = corner[(i + 2) % 3][1] - corner[i][1];
+    angle = atan2(fabs(ux * vy - uy * vx), ux * vx + uy * vy) * 180.0 / PI;
+    if (angle < minangle) {
+      minangle = angle;
+    }
+  }
+  return minangle;
 }
 
-/********* File I/O routines begin here                              *********/
-/**                                                                         **/
-/**                                                                         **/
-
 /*****************************************************************************/
 /*                                                                           */
-/*  readline()   Read a nonempty line from a file.                           */
+/*  minanglehistogram()   Count the living triangles by their smallest       */
+/*                        angle, using `b->threads' threads.                 */
 /*                                                                           */
-/*  A line is considered "nonempty" if it contains something that looks like */
-/*  a number.  Comments (prefaced by `#') are ignored.                       */
+/*  `bins' gets `bincount' counts for equally wide intervals of 0 to 60      */
+/*  degrees, the last one includes 60 degrees.  Added mrkkrj.                */
 /*                                                                           */
 /*****************************************************************************/
 
-#if !defined(TRILIBRARY) || defined(TRIFILES_READ_SUPPORT)
-
 #ifdef ANSI_DECLARATORS
-char *readline(char *string, FILE *infile, char *infilename)
+void minanglehistogram(struct mesh *m, struct behavior *b, long *bins,
+                       int bincount)
 #else /* not ANSI_DECLARATORS */
-char *readline(string, infile, infilename)
-char *string;
-FILE *infile;
-char *infilename;
+void minanglehistogram(m, b, bins, bincount)
+struct mesh *m;
+struct behavior *b;
+long *bins;
+int bincount;
 #endif /* not ANSI_DECLARATORS */
 
 {
-  char *result;
-
-  /* Search for something that looks like a number. */
-  do {
-    result = fgets(string, INPUTLINESIZE, infile);
-    if (result == (char *) NULL) {
-      printf("  Error:  Unexpected end of file in %s.\n", infilename);
-      triexit(1);
-    }
-    /* Skip anything that doesn't look like a number, a comment, */
-    /*   or the end of a line.                                   */
-    while ((*result != '\0') && (*result != '#')
-           && (*result != '.') && (*result != '+') && (*result != '-')
-           && ((*result < '0') || (*result > '9'))) {
-      result++;
-    }
-  /* If it's a comment or end of line, read another line and try again. */
-  } while ((*result == '#') || (*result == '\0'));
-  return result;
-}
-
-#endif /* not TRILIBRARY */
-
-/*****************************************************************************/
-/*                                                                           */
-/*  findfield()   Find the next field of a string.                           */
-/*                                                                           */
-/*  Jumps past the current field by searching for whitespace, then jumps     */
-/*  past the whitespace to find the next field.                              */
-/*                                                                           */
-/*****************************************************************************/
+  long slicecount;
+  long i;
+  int j;
 
-#if !defined(TRILIBRARY) || defined(TRIFILES_READ_SUPPORT)
+  slicecount = 4 * b->threads;
+  std::vector<std::vector<long> > slicebins(slicecount,
+                                            std::vector<long>(bincount, 0l));
 
-#ifdef ANSI_DECLARATORS
-char *findfield(char *string)
-#else /* not ANSI_DECLARATORS */
-char *findfield(string)
-char *string;
-#endif /* not ANSI_DECLARATORS */
+  traverseparallel(&m->triangles, b->threads, slicecount,
+                   [&](long slice, VOID *item) {
+    struct otri slicetri;
+    vertex torg, tdest, tapex;
+    int bin;
 
-{
-  char *result;
+    slicetri.tri = (triangle *) item;
+    slicetri.orient = 0;
+    if (!deadtri(slicetri.tri)) {
+      org(slicetri, torg);
+      dest(slicetri, tdest);
+      apex(slicetri, tapex);
+      bin = (int) (triangleminangle(torg, tdest, tapex) * bincount / 60.0);
+      slicebins[slice][bin < bincount ? bin : bincount - 1]++;
+    }
+  });
 
-  result = string;
-  /* Skip the current field.  Stop upon reaching whitespace. */
-  while ((*result != '\0') && (*result != '#')
-         && (*result != ' ') && (*result != '\t')) {
-    result++;
-  }
-  /* Now skip the whitespace and anything else that doesn't look like a */
-  /*   number, a comment, or the end of a line.                         */
-  while ((*result != '\0') && (*result != '#')
-         && (*result != '.') && (*result != '+') && (*result != '-')
-         && ((*result < '0') || (*result > '9'))) {
-    result++;
-  }
-  /* Check for a comment (prefixed with `#'). */
-  if (*result == '#') {
-    *result = '\0';
+  for (j = 0; j < bincount; j++) {
+    bins[j] = 0l;
+    for (i = 0; i < slicecount; i++) {
+      bins[j] += slicebins[i][j];
+    }
   }
-  return result;
 }
 
-#endif /* not TRILIBRARY */
-
 /*****************************************************************************/
 /*                                                                           */
-/*  readnodes()   Read the vertices from a file, which may be a .node or     */
-/*                .poly file.                                                */
+/*  smoothmesh()   Move the free (Steiner) vertices to improve the shape of  */
+/*                 the triangles around them.                                */
+/*                                                                           */
+/*  Each iteration moves every free vertex in the interior of the mesh       */
+/*  either to the centroid of its neighbors (Laplacian smoothing) or, if     */
+/*  `odt' is set, to the area-weighted mean of the circumcenters of its      */
+/*  triangles (optimal Delaunay triangulation smoothing).  A move is only    */
+/*  done if no triangle around the vertex gets inverted, its smallest angle  */
+/*  doesn't decrease, and the area constraints still hold, thus the quality  */
+/*  bounds of a refined mesh are kept.  Input and segment vertices never     */
+/*  move.                                                                    */
+/*                                                                           */
+/*  The free vertices are colored so that no two neighbors have the same     */
+/*  color; the vertices of one color are moved concurrently, using           */
+/*  `b->threads' threads.  Afterwards the Delaunay property is restored by   */
+/*  flipping the edges which are neither locally Delaunay nor subsegments,   */
+/*  unless the flip would break an area constraint.  Only the triangles      */
+/*  around the moved vertices and the sides of flipped quads are tested.     */
+/*  Returns the number of moves.  Added mrkkrj.                              */
 /*                                                                           */
 /*****************************************************************************/
 
-#if !defined(TRILIBRARY) || defined(TRIFILES_READ_SUPPORT)
+#ifndef CDT_ONLY
 
 #ifdef ANSI_DECLARATORS
-void readnodes(struct mesh *m, struct behavior *b, char *nodefilename,
-               char *polyfilename, FILE **polyfile)
+long smoothmesh(struct mesh *m, struct behavior *b, int iterations, int odt)
 #else /* not ANSI_DECLARATORS */
-void readnodes(m, b, nodefilename, polyfilename, polyfile)
+long smoothmesh(m, b, iterations, odt)
 struct mesh *m;
 struct behavior *b;
-char *nodefilename;
-char *polyfilename;
-FILE **polyfile;
+int iterations;
+int odt;
 #endif /* not ANSI_DECLARATORS */
+
 {
-  TRACE(" -> readnodes");
-  FILE *infile;
+  struct otri startri, triangleloop, neighbor, outertri;
+  struct osub checksub;
   vertex vertexloop;
-  char inputline[INPUTLINESIZE];
-  char *stringptr;
-  char *infilename;
-  REAL x, y;
-  int firstnode;
-  int nodemarkers;
-  int currentmarker;
-  int i, j;
+  vertex ringvertex;
+  vertex torg, tdest, tapex, farvertex;
+  long moves;
+  long i, j;
+  int iteration, color;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+  subseg sptr;                     /* Temporary variable used by tspivot(). */
 
-  if (b->poly) {
-    /* Read the vertices from a .poly file. */
-    if (!b->quiet) {
-      printf("Opening %s.\n", polyfilename);
+  /* Would the triangle pqr meet the area constraints of triangle `tri'? */
+  auto areaallowed = [this, m, b](vertex p, vertex q, vertex r, triangle *tri) {
+    REAL area = 0.5 * fabs((q[0] - p[0]) * (r[1] - p[1]) -
+                           (q[1] - p[1]) * (r[0] - p[0]));
+    REAL bound;
+
+    if (b->fixedarea && (area > b->maxarea)) {
+      return false;
     }
-    *polyfile = fopen(polyfilename, "r");
-    if (*polyfile == (FILE *) NULL) {
-      printf("  Error:  Cannot access file %s.\n", polyfilename);
-      triexit(1);
+    if (b->vararea) {
+      bound = ((REAL *) tri)[m->areaboundindex];
+      if ((bound > 0.0) && (area > bound)) {
+        return false;
+      }
+    }
+    if ((b->sizingfield.areas != (REAL *) NULL) &&
+        (area > sizingfieldarea(b, (p[0] + q[0] + r[0]) / 3.0,
+                                (p[1] + q[1] + r[1]) / 3.0))) {
+      return false;
+    }
+    return true;
+  };
+
+  moves = 0l;
+  for (iteration = 0; iteration < iterations; iteration++) {
+    /* Find the free vertices; the mark holds the vertex's number during */
+    /*   smoothing (`vertex2tri' isn't always available).                 */
+    std::vector<vertex> movable;
+    std::vector<triangle> startris;
+    std::vector<int> oldmarks;
+    traversalinit(&m->vertices);
+    vertexloop = vertextraverse(m);
+    while (vertexloop != (vertex) NULL) {
+      if (vertextype(vertexloop) == FREEVERTEX) {
+        oldmarks.push_back(vertexmark(vertexloop));
+        setvertexmark(vertexloop, (int) movable.size());
+        movable.push_back(vertexloop);
+      }
+      vertexloop = vertextraverse(m);
+    }
+    /* Find a triangle for each of them. */
+    startris.resize(movable.size(), (triangle) NULL);
+    traversalinit(&m->triangles);
+    triangleloop.tri = triangletraverse(m);
+    while (triangleloop.tri != (triangle *) NULL) {
+      for (triangleloop.orient = 0; triangleloop.orient < 3;
+           triangleloop.orient++) {
+        org(triangleloop, torg);
+        if ((vertextype(torg) == FREEVERTEX) &&
+            (vertexmark(torg) >= 0) &&
+            (vertexmark(torg) < (int) movable.size()) &&
+            (movable[vertexmark(torg)] == torg)) {
+          startris[vertexmark(torg)] = encode(triangleloop);
+        }
+      }
+      triangleloop.tri = triangletraverse(m);
+    }
+    /* Vertices on the boundary of the mesh must stay. */
+    for (i = 0; i < (long) movable.size(); i++) {
+      if (startris[i] == (triangle) NULL) {
+        continue;
+      }
+      decode(startris[i], startri);
+      triangleloop = startri;
+      do {
+        onextself(triangleloop);
+      } while ((triangleloop.tri != m->dummytri) &&
+               !otriequal(triangleloop, startri));
+      if (triangleloop.tri == m->dummytri) {
+        startris[i] = (triangle) NULL;
+      }
+    }
+
+    /* Greedy coloring: neighbors mustn't be moved at the same time. */
+    std::vector<int> colors(movable.size(), -1);
+    std::vector<std::vector<long> > colorsets;
+    for (i = 0; i < (long) movable.size(); i++) {
+      if (startris[i] == (triangle) NULL) {
+        continue;
+      }
+      std::vector<char> used(colorsets.size() + 1, 0);
+      decode(startris[i], triangleloop);
+      startri = triangleloop;
+      do {
+        dest(triangleloop, ringvertex);
+        if ((vertextype(ringvertex) == FREEVERTEX) &&
+            (vertexmark(ringvertex) >= 0) &&
+            (vertexmark(ringvertex) < (int) movable.size()) &&
+            (movable[vertexmark(ringvertex)] == ringvertex) &&
+            (colors[vertexmark(ringvertex)] >= 0)) {
+          used[colors[vertexmark(ringvertex)]] = 1;
+        }
+        onextself(triangleloop);
+      } while (!otriequal(triangleloop, startri));
+      for (color = 0; used[color]; color++);
+      if (color == (int) colorsets.size()) {
+        colorsets.push_back(std::vector<long>());
+      }
+      colors[i] = color;
+      colorsets[color].push_back(i);
+    }
+
+    /* Move the vertices of each color concurrently. */
+    std::vector<char> moved(movable.size(), 0);
+    for (color = 0; color < (int) colorsets.size(); color++) {
+      const std::vector<long> &colorset = colorsets[color];
+      tpp::parallelFor((long) colorset.size(), b->threads,
+                       [&](long first, long last) {
+        struct otri startri, startri0;
+        vertex movevertex, ringorg, ringapex;
+        std::vector<vertex> ring;
+        std::vector<triangle *> startris0;
+        REAL newx, newy, weight, area, dx, dy, ex, ey, denominator;
+        REAL oldminangle, newminangle;
+        REAL newpoint[2];
+        long k, n;
+        int accept;
+        triangle ptr;                   /* Temporary variable used by sym(). */
+
+        for (k = first; k < last; k++) {
+          movevertex = movable[colorset[k]];
+          decode(startris[colorset[k]], startri0);
+          startri = startri0;
+          ring.clear();
+          startris0.clear();
+          do {
+            dest(startri, ringorg);
+            ring.push_back(ringorg);
+            startris0.push_back(startri.tri);
+            onextself(startri);
+          } while (!otriequal(startri, startri0));
+          n = (long) ring.size();
+
+          /* The triangles around the vertex are (v, ring[j], ring[j + 1]). */
+          newx = newy = weight = 0.0;
+          oldminangle = 180.0;
+          for (j = 0; j < n; j++) {
+            ringorg = ring[j];
+            ringapex = ring[(j + 1) % n];
+            newminangle = triangleminangle(movevertex, ringorg, ringapex);
+            if (newminangle < oldminangle) {
+              oldminangle = newminangle;
+            }
+            if (odt) {
+              dx = ringorg[0] - movevertex[0];
+              dy = ringorg[1] - movevertex[1];
+              ex = ringapex[0] - movevertex[0];
+              ey = ringapex[1] - movevertex[1];
+              area = 0.5 * (dx * ey - dy * ex);
+              denominator = 4.0 * area;
+              if (denominator != 0.0) {
+                newx += area * (movevertex[0] +
+                                (ey * (dx * dx + dy * dy) -
+                                 dy * (ex * ex + ey * ey)) / denominator);
+                newy += area * (movevertex[1] +
+                                (dx * (ex * ex + ey * ey) -
+                                 ex * (dx * dx + dy * dy)) / denominator);
+                weight += area;
+              }
+            } else {
+              newx += ringorg[0];
+              newy += ringorg[1];
+              weight += 1.0;
+            }
+          }
+          if (weight <= 0.0) {
+            continue;
+          }
+          newpoint[0] = newx / weight;
+          newpoint[1] = newy / weight;
+
+          accept = 1;
+          newminangle = 180.0;
+          for (j = 0; (j < n) && accept; j++) {
+            ringorg = ring[j];
+            ringapex = ring[(j + 1) % n];
+            area = 0.5 * ((ringorg[0] - newpoint[0]) *
+                          (ringapex[1] - newpoint[1]) -
+                          (ringorg[1] - newpoint[1]) *
+                          (ringapex[0] - newpoint[0]));
+            if (area <= 0.0) {
+              accept = 0;                            /* Inverted triangle. */
+            } else if (!areaallowed(newpoint, ringorg, ringapex,
+                                    startris0[j])) {
+              accept = 0;
+            } else {
+              newminangle = std::min(newminangle,
+                             triangleminangle(newpoint, ringorg, ringapex));
+            }
+          }
+          if (accept && (newminangle > oldminangle)) {
+            movevertex[0] = newpoint[0];
+            movevertex[1] = newpoint[1];
+            moved[colorset[k]] = 1;
+          }
+        }
+      });
+    }
+
+    for (i = 0; i < (long) movable.size(); i++) {
+      setvertexmark(movable[i], oldmarks[i]);
+      moves += moved[i];
+    }
+
+    /* Restore the Delaunay property with flips, but keep the subsegments. */
+    /*   Only the edges of the triangles around the moved vertices can be  */
+    /*   not locally Delaunay, thus start from them (as relocatevertices()  */
+    /*   does), then test the sides of the flipped quads.                   */
+    std::vector<triangle> flipstack;
+    for (i = 0; i < (long) movable.size(); i++) {
+      if (!moved[i]) {
+        continue;
+      }
+      decode(startris[i], startri);
+      triangleloop = startri;
+      do {
+        for (j = 0; j < 3; j++) {
+          flipstack.push_back(encode(triangleloop));
+          lnextself(triangleloop);
+        }
+        onextself(triangleloop);
+      } while (!otriequal(triangleloop, startri));
+    }
+    while (!flipstack.empty()) {
+      decode(flipstack.back(), triangleloop);
+      flipstack.pop_back();
+      sym(triangleloop, neighbor);
+      if (neighbor.tri == m->dummytri) {
+        continue;
+      }
+      if (b->usesegments) {
+        tspivot(triangleloop, checksub);
+        if (checksub.ss != m->dummysub) {
+          continue;
+        }
+      }
+      org(triangleloop, torg);
+      dest(triangleloop, tdest);
+      apex(triangleloop, tapex);
+      apex(neighbor, farvertex);
+      /* flip() reuses abc for dca and bad for cdb.  An edge stays if its */
+      /*   flip would break an area constraint.                           */
+      if ((incircle(m, b, torg, tdest, tapex, farvertex) > 0.0) &&
+          areaallowed(farvertex, tapex, torg, triangleloop.tri) &&
+          areaallowed(tapex, farvertex, tdest, neighbor.tri)) {
+        flip(m, b, &triangleloop);
+        sym(triangleloop, neighbor);
+        for (j = 0; j < 2; j++) {
+          lnext(triangleloop, outertri);
+          flipstack.push_back(encode(outertri));
+          lprev(triangleloop, outertri);
+          flipstack.push_back(encode(outertri));
+          otricopy(neighbor, triangleloop);
+        }
+      }
+    }
+  }
+  return moves;
+}
+
+#endif /* not CDT_ONLY */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  repairboundary()   Make the boundary of the mesh convex again, after     */
+/*                     vertices were moved.                                  */
+/*                                                                           */
+/*  A boundary triangle whose apex is an interior vertex that crossed (or    */
+/*  reached) the boundary edge is cut off, the apex becomes a boundary       */
+/*  vertex.  A reflex boundary vertex is covered by a new triangle, which    */
+/*  connects its neighbors on the boundary.  Returns the number of changes.  */
+/*  Added mrkkrj.                                                            */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+long repairboundary(struct mesh *m, struct behavior *b)
+#else /* not ANSI_DECLARATORS */
+long repairboundary(m, b)
+struct mesh *m;
+struct behavior *b;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri triangleloop, neighbor, hulltri, fantri, newtri;
+  vertex torg, tdest, tapex, nextvertex;
+  long changes;
+  int changed;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  changes = 0l;
+  do {
+    changed = 0;
+    traversalinit(&m->triangles);
+    triangleloop.tri = triangletraverse(m);
+    while (triangleloop.tri != (triangle *) NULL) {
+      for (triangleloop.orient = 0; triangleloop.orient < 3;
+           triangleloop.orient++) {
+        sym(triangleloop, neighbor);
+        if (neighbor.tri != m->dummytri) {
+          continue;
+        }
+        org(triangleloop, torg);
+        dest(triangleloop, tdest);
+        apex(triangleloop, tapex);
+        if (counterclockwise(m, b, torg, tdest, tapex) <= 0.0) {
+          /* Only an interior apex can become a boundary vertex. */
+          lprev(triangleloop, fantri);
+          otricopy(fantri, hulltri);
+          do {
+            onextself(hulltri);
+          } while ((hulltri.tri != m->dummytri) &&
+                   !otriequal(hulltri, fantri));
+          if (hulltri.tri == m->dummytri) {
+            continue;
+          }
+          lnext(triangleloop, hulltri);
+          sym(hulltri, neighbor);
+          dissolve(neighbor);
+          m->dummytri[0] = encode(neighbor);
+          sym(fantri, neighbor);
+          dissolve(neighbor);
+          triangledealloc(m, triangleloop.tri);
+          m->hullsize++;
+          changes++;
+          changed = 1;
+          break;
+        }
+        /* Turn clockwise around the destination to the next boundary edge. */
+        lnext(triangleloop, hulltri);
+        sym(hulltri, neighbor);
+        while (neighbor.tri != m->dummytri) {
+          lnext(neighbor, hulltri);
+          sym(hulltri, neighbor);
+        }
+        dest(hulltri, nextvertex);
+        if ((nextvertex != torg) &&
+            (counterclockwise(m, b, torg, tdest, nextvertex) < 0.0)) {
+          /* Cover the reflex vertex by the triangle (tdest, torg, next). */
+          maketriangle(m, b, &newtri);
+          setorg(newtri, tdest);
+          setdest(newtri, torg);
+          setapex(newtri, nextvertex);
+          bond(newtri, triangleloop);
+          lprevself(newtri);
+          bond(newtri, hulltri);
+          lprevself(newtri);
+          m->dummytri[0] = encode(newtri);
+          m->hullsize--;
+          changes++;
+          changed = 1;
+        }
+      }
+      triangleloop.tri = triangletraverse(m);
+    }
+  } while (changed);
+  return changes;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  removevertex()   Remove the origin of `deltri' from the mesh, but keep   */
+/*                   the vertex itself.                                      */
+/*                                                                           */
+/*  An interior vertex is removed like by deletevertex(), the polygon of its */
+/*  neighbors is triangulated Delaunay.  For a boundary vertex the spokes to */
+/*  the reflex vertices of the chain of its neighbors are flipped, until the */
+/*  chain is convex; then its triangles are cut off and the chain becomes    */
+/*  part of the boundary, the mesh may be left non-Delaunay.  The mesh       */
+/*  mustn't have subsegments.  Returns 0 if a boundary vertex couldn't be    */
+/*  removed without disconnecting the mesh.  Added mrkkrj.                   */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef CDT_ONLY
+
+#ifdef ANSI_DECLARATORS
+int removevertex(struct mesh *m, struct behavior *b, struct otri *deltri)
+#else /* not ANSI_DECLARATORS */
+int removevertex(m, b, deltri)
+struct mesh *m;
+struct behavior *b;
+struct otri *deltri;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri fantri, nexttri, spoketri, outertri;
+  struct otri firstedge, lastedge;
+  struct otri deltriright;
+  struct otri lefttri, righttri;
+  struct otri leftcasing, rightcasing;
+  vertex prevvertex, chainvertex, nextvertex;
+  vertex neworg;
+  long fancount;
+  int edgecount;
+  int flipped;
+  triangle ptr;   /* Temporary variable used by sym(), onext(), and oprev(). */
+
+  do {
+    /* Turn counterclockwise until the boundary, or all around. */
+    otricopy(*deltri, fantri);
+    edgecount = 0;
+    do {
+      edgecount++;
+      onext(fantri, nexttri);
+      if (nexttri.tri == m->dummytri) {
+        break;
+      }
+      otricopy(nexttri, fantri);
+    } while (!otriequal(fantri, *deltri));
+
+    if (nexttri.tri != m->dummytri) {
+      /* An interior vertex. */
+      if (edgecount > 3) {
+        onext(*deltri, firstedge);
+        oprev(*deltri, lastedge);
+        triangulatepolygon(m, b, &firstedge, &lastedge, edgecount, 0, 0);
+      }
+      /* Splice out two triangles. */
+      lprev(*deltri, deltriright);
+      dnext(*deltri, lefttri);
+      sym(lefttri, leftcasing);
+      oprev(deltriright, righttri);
+      sym(righttri, rightcasing);
+      bond(*deltri, leftcasing);
+      bond(deltriright, rightcasing);
+      org(lefttri, neworg);
+      setorg(*deltri, neworg);
+      triangledealloc(m, lefttri.tri);
+      triangledealloc(m, righttri.tri);
+      otricopy(*deltri, m->recenttri);
+      return 1;
+    }
+
+    /* A boundary vertex, `fantri' is the triangle of the boundary edge */
+    /*   into it.  Its spokes are visited clockwise, from the edge to    */
+    /*   the chain's first vertex on.                                    */
+    flipped = 0;
+    otricopy(fantri, spoketri);
+    apex(spoketri, prevvertex);
+    dest(spoketri, chainvertex);
+    sym(spoketri, nexttri);
+    while (nexttri.tri != m->dummytri) {
+      apex(nexttri, nextvertex);
+      if (counterclockwise(m, b, prevvertex, chainvertex, nextvertex) < 0.0) {
+        flip(m, b, &spoketri);
+        /* Continue from a spoke of the flipped triangles. */
+        lprev(spoketri, *deltri);
+        flipped = 1;
+        break;
+      }
+      lnext(nexttri, spoketri);
+      prevvertex = chainvertex;
+      chainvertex = nextvertex;
+      sym(spoketri, nexttri);
+    }
+  } while (flipped);
+
+  /* The outer edges of the triangles must stay connected to the mesh. */
+  otricopy(fantri, spoketri);
+  fancount = 0l;
+  do {
+    fancount++;
+    lnext(spoketri, outertri);
+    symself(outertri);
+    if (outertri.tri == m->dummytri) {
+      return 0;
+    }
+    sym(spoketri, nexttri);
+    lnext(nexttri, spoketri);
+  } while (nexttri.tri != m->dummytri);
+  if (fancount >= m->triangles.items) {
+    return 0;
+  }
+
+  otricopy(fantri, spoketri);
+  do {
+    lnext(spoketri, outertri);
+    symself(outertri);
+    dissolve(outertri);
+    m->dummytri[0] = encode(outertri);
+    sym(spoketri, nexttri);
+    triangledealloc(m, spoketri.tri);
+    lnext(nexttri, spoketri);
+  } while (nexttri.tri != m->dummytri);
+  m->hullsize += fancount - 2;
+  otricopy(outertri, m->recenttri);
+  return 1;
+}
+
+#endif /* not CDT_ONLY */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  relocatevertices()   Move the vertices to new positions, and restore the */
+/*                       Delaunay property by edge flips.                    */
+/*                                                                           */
+/*  The vertex numbered `v' (by numbernodes()) is moved to                   */
+/*  (`newcoords[2v]', `newcoords[2v + 1]'), for all the vertices in the      */
+/*  pool.  After the moves the boundary is repaired by repairboundary(), and */
+/*  the vertices of triangles which got inverted anyway are moved back, then */
+/*  the mesh is made Delaunay by flips.  The vertices moved back are removed */
+/*  and inserted again at their new positions.  If this fails (e.g. two      */
+/*  vertices would coincide), all the vertices are moved without repairing   */
+/*  the mesh, -1 is returned and the caller has to triangulate them again.   */
+/*  Else returns the number of flips.  The mesh mustn't have subsegments.    */
+/*  Added mrkkrj.                                                            */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef CDT_ONLY
+
+#ifdef ANSI_DECLARATORS
+long relocatevertices(struct mesh *m, struct behavior *b, REAL *newcoords)
+#else /* not ANSI_DECLARATORS */
+long relocatevertices(m, b, newcoords)
+struct mesh *m;
+struct behavior *b;
+REAL *newcoords;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri triangleloop, neighbor, hulltri, searchtri, newtri;
+  vertex vertexloop;
+  vertex corner[3];
+  vertex movevertex, nextvertex;
+  enum locateresult intersect;
+  long totalflips;
+  long vertexcount;
+  long v;
+  size_t i;
+  int movedback, stuck, j;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  /* Flips edges until the mesh is Delaunay.  All the edges are tested */
+  /*   once (in parallel), then only the edges of the flipped quads.   */
+  auto makedelaunay = [this, m, b]() {
+    struct otri fliptri, oppositetri, outertri;
+    vertex forg, fdest, fapex, farvertex;
+    std::vector<triangle> flipstack;
+    long flipcount, slicecount;
+    long i;
+    int k;
+    triangle ptr;                       /* Temporary variable used by sym(). */
+
+    slicecount = 4 * b->threads;
+    std::vector<std::vector<triangle> > fliplists(slicecount);
+    traverseparallel(&m->triangles, b->threads, slicecount,
+                     [&](long slice, VOID *item) {
+      struct otri slicetri, slicesym;
+      vertex sorg, sdest, sapex, sfar;
+      triangle ptr;                     /* Temporary variable used by sym(). */
+
+      slicetri.tri = (triangle *) item;
+      if (deadtri(slicetri.tri)) {
+        return;
+      }
+      for (slicetri.orient = 0; slicetri.orient < 3; slicetri.orient++) {
+        sym(slicetri, slicesym);
+        /* Each edge once, from the triangle with the smaller pointer. */
+        if ((slicesym.tri == m->dummytri) || (slicetri.tri > slicesym.tri)) {
+          continue;
+        }
+        org(slicetri, sorg);
+        dest(slicetri, sdest);
+        apex(slicetri, sapex);
+        apex(slicesym, sfar);
+        if (incircleuncounted(b, sorg, sdest, sapex, sfar) > 0.0) {
+          fliplists[slice].push_back(encode(slicetri));
+        }
+      }
+    });
+    for (i = slicecount - 1; i >= 0; i--) {
+      flipstack.insert(flipstack.end(), fliplists[i].rbegin(),
+                       fliplists[i].rend());
+    }
+
+    /* A flip only changes the triangles it replaces, so any edge which */
+    /*   isn't locally Delaunay any more is one of the quad's sides.    */
+    flipcount = 0l;
+    while (!flipstack.empty()) {
+      decode(flipstack.back(), fliptri);
+      flipstack.pop_back();
+      sym(fliptri, oppositetri);
+      if (oppositetri.tri == m->dummytri) {
+        continue;
+      }
+      org(fliptri, forg);
+      dest(fliptri, fdest);
+      apex(fliptri, fapex);
+      apex(oppositetri, farvertex);
+      if (incircle(m, b, forg, fdest, fapex, farvertex) > 0.0) {
+        flip(m, b, &fliptri);
+        flipcount++;
+        sym(fliptri, oppositetri);
+        for (k = 0; k < 2; k++) {
+          lnext(fliptri, outertri);
+          flipstack.push_back(encode(outertri));
+          lprev(fliptri, outertri);
+          flipstack.push_back(encode(outertri));
+          otricopy(oppositetri, fliptri);
+        }
+      }
+    }
+    return flipcount;
+  };
+
+  /* locate() would walk off the mesh for a point outside of it; walk */
+  /*   from the last change on, from an edge the point is left of.     */
+  auto walklocate = [this, m, b](vertex searchpoint, struct otri *searchtri) {
+    vertex forg, fdest;
+    triangle ptr;                       /* Temporary variable used by sym(). */
+
+    if ((m->recenttri.tri != (triangle *) NULL) &&
+        !deadtri(m->recenttri.tri)) {
+      otricopy(m->recenttri, *searchtri);
+    } else {
+      searchtri->tri = m->dummytri;
+      searchtri->orient = 0;
+      symself(*searchtri);
+    }
+    for (searchtri->orient = 0; searchtri->orient < 2;
+         searchtri->orient++) {
+      org(*searchtri, forg);
+      dest(*searchtri, fdest);
+      if (counterclockwise(m, b, forg, fdest, searchpoint) > 0.0) {
+        break;
+      }
+    }
+    return preciselocate(m, b, searchpoint, searchtri, 0);
+  };
+
+  /* The state of a vertex is 1 if it was moved, 2 if it was moved back. */
+  vertexcount = m->vertices.items;
+  std::vector<REAL> oldcoords(2 * vertexcount);
+  std::vector<char> states(vertexcount, 0);
+  std::vector<vertex> movedbackvertices;
+  traversalinit(&m->vertices);
+  vertexloop = vertextraverse(m);
+  while (vertexloop != (vertex) NULL) {
+    v = vertexmark(vertexloop) - b->firstnumber;
+    if ((v >= 0) && (v < vertexcount)) {
+      oldcoords[2 * v] = vertexloop[0];
+      oldcoords[2 * v + 1] = vertexloop[1];
+      vertexloop[0] = newcoords[2 * v];
+      vertexloop[1] = newcoords[2 * v + 1];
+      states[v] = 1;
+    }
+    vertexloop = vertextraverse(m);
+  }
+
+  stuck = 0;
+  do {
+    repairboundary(m, b);
+    movedback = 0;
+    traversalinit(&m->triangles);
+    triangleloop.tri = triangletraverse(m);
+    while ((triangleloop.tri != (triangle *) NULL) && !stuck) {
+      triangleloop.orient = 0;
+      org(triangleloop, corner[0]);
+      dest(triangleloop, corner[1]);
+      apex(triangleloop, corner[2]);
+      if (counterclockwise(m, b, corner[0], corner[1], corner[2]) <= 0.0) {
+        stuck = 1;
+        for (j = 0; j < 3; j++) {
+          v = vertexmark(corner[j]) - b->firstnumber;
+          if (states[v] == 1) {
+            corner[j][0] = oldcoords[2 * v];
+            corner[j][1] = oldcoords[2 * v + 1];
+            states[v] = 2;
+            movedbackvertices.push_back(corner[j]);
+            stuck = 0;
+          }
+        }
+        movedback = 1;
+      }
+      triangleloop.tri = triangletraverse(m);
+    }
+  } while (movedback && !stuck);
+
+  totalflips = 0l;
+  if (!stuck) {
+    totalflips += makedelaunay();
+  }
+
+  for (i = 0; (i < movedbackvertices.size()) && !stuck; i++) {
+    movevertex = movedbackvertices[i];
+    if (walklocate(movevertex, &searchtri) != ONVERTEX) {
+      stuck = 1;
+      break;
+    }
+    org(searchtri, corner[0]);
+    if ((corner[0] != movevertex) || !removevertex(m, b, &searchtri)) {
+      stuck = 1;
+      break;
+    }
+
+    v = vertexmark(movevertex) - b->firstnumber;
+    movevertex[0] = newcoords[2 * v];
+    movevertex[1] = newcoords[2 * v + 1];
+    intersect = walklocate(movevertex, &searchtri);
+    if (intersect == ONVERTEX) {
+      stuck = 1;
+    } else if (intersect == OUTSIDE) {
+      /* Attach a triangle to the boundary edge facing the vertex, the */
+      /*   boundary repair connects it to the other ones.              */
+      org(searchtri, corner[0]);
+      dest(searchtri, corner[1]);
+      maketriangle(m, b, &newtri);
+      setorg(newtri, corner[1]);
+      setdest(newtri, corner[0]);
+      setapex(newtri, movevertex);
+      bond(newtri, searchtri);
+      lnextself(newtri);
+      m->dummytri[0] = encode(newtri);
+      m->hullsize++;
+      repairboundary(m, b);
+    } else {
+      if (intersect == ONEDGE) {
+        /* insertvertex() needs the vertex left of the edge. */
+        lnextself(searchtri);
+      }
+      insertvertex(m, b, movevertex, &searchtri, (struct osub *) NULL, 0, 0);
+    }
+  }
+
+  if (!stuck) {
+    totalflips += makedelaunay();
+
+    /* No inverted triangles, and a left turn (or none) at each boundary */
+    /*   vertex, from its boundary edge to the next one.                 */
+    traversalinit(&m->triangles);
+    triangleloop.tri = triangletraverse(m);
+    while ((triangleloop.tri != (triangle *) NULL) && !stuck) {
+      triangleloop.orient = 0;
+      org(triangleloop, corner[0]);
+      dest(triangleloop, corner[1]);
+      apex(triangleloop, corner[2]);
+      stuck = counterclockwise(m, b, corner[0], corner[1], corner[2]) <= 0.0;
+      for (; (triangleloop.orient < 3) && !stuck; triangleloop.orient++) {
+        sym(triangleloop, neighbor);
+        if (neighbor.tri != m->dummytri) {
+          continue;
+        }
+        org(triangleloop, corner[0]);
+        dest(triangleloop, corner[1]);
+        lnext(triangleloop, hulltri);
+        sym(hulltri, neighbor);
+        while (neighbor.tri != m->dummytri) {
+          lnext(neighbor, hulltri);
+          sym(hulltri, neighbor);
+        }
+        dest(hulltri, nextvertex);
+        stuck = counterclockwise(m, b, corner[0], corner[1], nextvertex) < 0.0;
+      }
+      triangleloop.tri = triangletraverse(m);
+    }
+  }
+
+  m->xmin = m->ymin = HUGE_VAL;
+  m->xmax = m->ymax = -HUGE_VAL;
+  traversalinit(&m->vertices);
+  vertexloop = vertextraverse(m);
+  while (vertexloop != (vertex) NULL) {
+    v = vertexmark(vertexloop) - b->firstnumber;
+    if (stuck && (v >= 0) && (v < vertexcount)) {
+      vertexloop[0] = newcoords[2 * v];
+      vertexloop[1] = newcoords[2 * v + 1];
+    }
+    m->xmin = (vertexloop[0] < m->xmin) ? vertexloop[0] : m->xmin;
+    m->xmax = (vertexloop[0] > m->xmax) ? vertexloop[0] : m->xmax;
+    m->ymin = (vertexloop[1] < m->ymin) ? vertexloop[1] : m->ymin;
+    m->ymax = (vertexloop[1] > m->ymax) ? vertexloop[1] : m->ymax;
+    vertexloop = vertextraverse(m);
+  }
+  return stuck ? -1l : totalflips;
+}
+
+#endif /* not CDT_ONLY */
+
+/**                                                                         **/
+/**                                                                         **/
+/********* Mesh quality maintenance ends here                        *********/
+
+/*****************************************************************************/
+/*                                                                           */
+/*  highorder()   Create extra nodes for quadratic subparametric elements.   */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void highorder(struct mesh *m, struct behavior *b)
+#else /* not ANSI_DECLARATORS */
+void highorder(m, b)
+struct mesh *m;
+struct behavior *b;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct otri triangleloop, trisym;
+  struct osub checkmark;
+  vertex newvertex;
+  vertex torg, tdest;
+  int i;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+  subseg sptr;                      /* Temporary variable used by tspivot(). */
+
+  if (!b->quiet) {
+    printf("Adding vertices for second-order triangles.\n");
+  }
+  /* The following line ensures that dead items in the pool of nodes    */
+  /*   cannot be allocated for the extra nodes associated with high     */
+  /*   order elements.  This ensures that the primary nodes (at the     */
+  /*   corners of elements) will occur earlier in the output files, and */
+  /*   have lower indices, than the extra nodes.                        */
+  m->vertices.deaditemstack = (VOID *) NULL;
+
+  traversalinit(&m->triangles);
+  triangleloop.tri = triangletraverse(m);
+  /* To loop over the set of edges, loop over all triangles, and look at   */
+  /*   the three edges of each triangle.  If there isn't another triangle  */
+  /*   adjacent to the edge, operate on the edge.  If there is another     */
+  /*   adjacent triangle, operate on the edge only if the current triangle */
+  /*   has a smaller pointer than its neighbor.  This way, each edge is    */
+  /*   considered only once.                                               */
+  while (triangleloop.tri != (triangle *) NULL) {
+    for (triangleloop.orient = 0; triangleloop.orient < 3;
+         triangleloop.orient++) {
+      sym(triangleloop, trisym);
+      if ((triangleloop.tri < trisym.tri) || (trisym.tri == m->dummytri)) {
+        org(triangleloop, torg);
+        dest(triangleloop, tdest);
+        /* Create a new node in the middle of the edge.  Interpolate */
+        /*   its attributes.                                         */
+        newvertex = (vertex) poolalloc(&m->vertices);
+        for (i = 0; i < 2 + m->nextras; i++) {
+          newvertex[i] = 0.5 * (torg[i] + tdest[i]);
+        }
+        /* Set the new node's marker to zero or one, depending on */
+        /*   whether it lies on a boundary.                       */
+        setvertexmark(newvertex, trisym.tri == m->dummytri);
+        setvertextype(newvertex,
+                      trisym.tri == m->dummytri ? FREEVERTEX : SEGMENTVERTEX);
+        if (b->usesegments) {
+          tspivot(triangleloop, checkmark);
+          /* If this edge is a segment, transfer the marker to the new node. */
+          if (checkmark.ss != m->dummysub) {
+            setvertexmark(newvertex, mark(checkmark));
+            setvertextype(newvertex, SEGMENTVERTEX);
+          }
+        }
+        if (b->verbose > 1) {
+          printf("  Creating (%.12g, %.12g).\n", newvertex[0], newvertex[1]);
+        }
+        /* Record the new node in the (one or two) adjacent elements. */
+        triangleloop.tri[m->highorderindex + triangleloop.orient] =
+                (triangle) newvertex;
+        if (trisym.tri != m->dummytri) {
+          trisym.tri[m->highorderindex + trisym.orient] = (triangle) newvertex;
+        }
+      }
+    }
+    triangleloop.tri = triangletraverse(m);
+  }
+}
+
+/********* File I/O routines begin here                              *********/
+/**                                                                         **/
+/**                                                                         **/
+
+/*****************************************************************************/
+/*                                                                           */
+/*  readline()   Read a nonempty line from a file.                           */
+/*                                                                           */
+/*  A line is considered "nonempty" if it contains something that looks like */
+/*  a number.  Comments (prefaced by `#') are ignored.                       */
+/*                                                                           */
+/*****************************************************************************/
+
+#if !defined(TRILIBRARY) || defined(TRIFILES_READ_SUPPORT)
+
+#ifdef ANSI_DECLARATORS
+char *readline(char *string, FILE *infile, char *infilename)
+#else /* not ANSI_DECLARATORS */
+char *readline(string, infile, infilename)
+char *string;
+FILE *infile;
+char *infilename;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  char *result;
+
+  /* Search for something that looks like a number. */
+  do {
+    result = fgets(string, INPUTLINESIZE, infile);
+    if (result == (char *) NULL) {
+      printf("  Error:  Unexpected end of file in %s.\n", infilename);
+      triexit(1);
+    }
+    /* Skip anything that doesn't look like a number, a comment, */
+    /*   or the end of a line.                                   */
+    while ((*result != '\0') && (*result != '#')
+           && (*result != '.') && (*result != '+') && (*result != '-')
+           && ((*result < '0') || (*result > '9'))) {
+      result++;
+    }
+  /* If it's a comment or end of line, read another line and try again. */
+  } while ((*result == '#') || (*result == '\0'));
+  return result;
+}
+
+#endif /* not TRILIBRARY */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  findfield()   Find the next field of a string.                           */
+/*                                                                           */
+/*  Jumps past the current field by searching for whitespace, then jumps     */
+/*  past the whitespace to find the next field.                              */
+/*                                                                           */
+/*****************************************************************************/
+
+#if !defined(TRILIBRARY) || defined(TRIFILES_READ_SUPPORT)
+
+#ifdef ANSI_DECLARATORS
+char *findfield(char *string)
+#else /* not ANSI_DECLARATORS */
+char *findfield(string)
+char *string;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  char *result;
+
+  result = string;
+  /* Skip the current field.  Stop upon reaching whitespace. */
+  while ((*result != '\0') && (*result != '#')
+         && (*result != ' ') && (*result != '\t')) {
+    result++;
+  }
+  /* Now skip the whitespace and anything else that doesn't look like a */
+  /*   number, a comment, or the end of a line.                         */
+  while ((*result != '\0') && (*result != '#')
+         && (*result != '.') && (*result != '+') && (*result != '-')
+         && ((*result < '0') || (*result > '9'))) {
+    result++;
+  }
+  /* Check for a comment (prefixed with `#'). */
+  if (*result == '#') {
+    *result = '\0';
+  }
+  return result;
+}
+
+#endif /* not TRILIBRARY */
+
+/*****************************************************************************/
+/*                                                                           */
+/*  readnodes()   Read the vertices from a file, which may be a .node or     */
+/*                .poly file.                                                */
+/*                                                                           */
+/*****************************************************************************/
+
+#if !defined(TRILIBRARY) || defined(TRIFILES_READ_SUPPORT)
+
+#ifdef ANSI_DECLARATORS
+void readnodes(struct mesh *m, struct behavior *b, char *nodefilename,
+               char *polyfilename, FILE **polyfile)
+#else /* not ANSI_DECLARATORS */
+void readnodes(m, b, nodefilename, polyfilename, polyfile)
+struct mesh *m;
+struct behavior *b;
+char *nodefilename;
+char *polyfilename;
+FILE **polyfile;
+#endif /* not ANSI_DECLARATORS */
+{
+  TRACE(" -> readnodes");
+  FILE *infile;
+  vertex vertexloop;
+  char inputline[INPUTLINESIZE];
+  char *stringptr;
+  char *infilename;
+  REAL x, y;
+  int firstnode;
+  int nodemarkers;
+  int currentmarker;
+  int i, j;
+
+  if (b->poly) {
+    /* Read the vertices from a .poly file. */
+    if (!b->quiet) {
+      printf("Opening %s.\n", polyfilename);
+    }
+    *polyfile = fopen(polyfilename, "r");
+    if (*polyfile == (FILE *) NULL) {
+      printf("  Error:  Cannot access file %s.\n", polyfilename);
+      triexit(1);
     }
     /* Read number of vertices, number of dimensions, number of vertex */
     /*   attributes, and number of boundary markers.                   */
@@ -15711,100 +18186,983 @@ char **argv;
     fprintf(outfile, "\n");
 #endif /* not TRILIBRARY */
 
-    * (int *) (triangleloop.tri + 6) = (int) vnodenumber;
-    triangleloop.tri = triangletraverse(m);
-    vnodenumber++;
-  }
+    * (int *) (triangleloop.tri + 6) = (int) vnodenumber;
+    triangleloop.tri = triangletraverse(m);
+    vnodenumber++;
+  }
+
+#ifndef TRILIBRARY
+  finishfile(outfile, argc, argv);
+#endif /* not TRILIBRARY */
+
+#ifdef TRILIBRARY
+  if (!b->quiet) {
+    printf("Writing Voronoi edges.\n");
+  }
+  /* Allocate memory for output Voronoi edges if necessary. */
+  if (*vedgelist == (int *) NULL) {
+    *vedgelist = (int *) trimalloc((int) (m->edges * 2 * sizeof(int)));
+  }
+  *vedgemarkerlist = (int *) NULL;
+  /* Allocate memory for output Voronoi norms if necessary. */
+  if (*vnormlist == (REAL *) NULL) {
+    *vnormlist = (REAL *) trimalloc((int) (m->edges * 2 * sizeof(REAL)));
+  }
+  elist = *vedgelist;
+  normlist = *vnormlist;
+  coordindex = 0;
+#else /* not TRILIBRARY */
+  if (!b->quiet) {
+    printf("Writing %s.\n", vedgefilename);
+  }
+  outfile = fopen(vedgefilename, "w");
+  if (outfile == (FILE *) NULL) {
+    printf("  Error:  Cannot create file %s.\n", vedgefilename);
+    triexit(1);
+  }
+  /* Number of edges, zero boundary markers. */
+  fprintf(outfile, "%ld  %d\n", m->edges, 0);
+#endif /* not TRILIBRARY */
+
+  traversalinit(&m->triangles);
+  triangleloop.tri = triangletraverse(m);
+  vedgenumber = b->firstnumber;
+  /* To loop over the set of edges, loop over all triangles, and look at   */
+  /*   the three edges of each triangle.  If there isn't another triangle  */
+  /*   adjacent to the edge, operate on the edge.  If there is another     */
+  /*   adjacent triangle, operate on the edge only if the current triangle */
+  /*   has a smaller pointer than its neighbor.  This way, each edge is    */
+  /*   considered only once.                                               */
+  while (triangleloop.tri != (triangle *) NULL) {
+    for (triangleloop.orient = 0; triangleloop.orient < 3;
+         triangleloop.orient++) {
+      sym(triangleloop, trisym);
+      if ((triangleloop.tri < trisym.tri) || (trisym.tri == m->dummytri)) {
+        /* Find the number of this triangle (and Voronoi vertex). */
+        p1 = * (int *) (triangleloop.tri + 6);
+        if (trisym.tri == m->dummytri) {
+          org(triangleloop, torg);
+          dest(triangleloop, tdest);
+#ifdef TRILIBRARY
+          /* Copy an infinite ray.  Index of one endpoint, and -1. */
+          elist[coordindex] = p1;
+          normlist[coordindex++] = tdest[1] - torg[1];
+          elist[coordindex] = -1;
+          normlist[coordindex++] = torg[0] - tdest[0];
+#else /* not TRILIBRARY */
+          /* Write an infinite ray.  Edge number, index of one endpoint, -1, */
+          /*   and x and y coordinates of a vector representing the          */
+          /*   direction of the ray.                                         */
+          fprintf(outfile, "%4ld   %d  %d   %.17g  %.17g\n", vedgenumber,
+                  p1, -1, tdest[1] - torg[1], torg[0] - tdest[0]);
+#endif /* not TRILIBRARY */
+        } else {
+          /* Find the number of the adjacent triangle (and Voronoi vertex). */
+          p2 = * (int *) (trisym.tri + 6);
+          /* Finite edge.  Write indices of two endpoints. */
+#ifdef TRILIBRARY
+          elist[coordindex] = p1;
+          normlist[coordindex++] = 0.0;
+          elist[coordindex] = p2;
+          normlist[coordindex++] = 0.0;
+#else /* not TRILIBRARY */
+          fprintf(outfile, "%4ld   %d  %d\n", vedgenumber, p1, p2);
+#endif /* not TRILIBRARY */
+        }
+        vedgenumber++;
+      }
+    }
+    triangleloop.tri = triangletraverse(m);
+  }
+
+#ifndef TRILIBRARY
+  finishfile(outfile, argc, argv);
+#endif /* not TRILIBRARY */
+}
+
+#ifdef TRILIBRARY
+
+/*****************************************************************************/
+/*                                                                           */
+/*  voronoicenter()   Find the Voronoi vertex of a triangle, i.e. its        */
+/*                    circumcenter, or its power center if the vertices are  */
+/*                    weighted (-w switch).                                  */
+/*                                                                           */
+/*  Computed as in findcircumcenter(), but without counting the tests, thus  */
+/*  can be called from several threads.  Added mrkkrj.                       */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void voronoicenter(struct behavior *b, vertex torg, vertex tdest,
+                   vertex tapex, REAL *center)
+#else /* not ANSI_DECLARATORS */
+void voronoicenter(b, torg, tdest, tapex, center)
+struct behavior *b;
+vertex torg;
+vertex tdest;
+vertex tapex;
+REAL *center;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  REAL xdo, ydo, xao, yao;
+  REAL dodist, aodist, denominator;
+
+  xdo = tdest[0] - torg[0];
+  ydo = tdest[1] - torg[1];
+  xao = tapex[0] - torg[0];
+  yao = tapex[1] - torg[1];
+  dodist = xdo * xdo + ydo * ydo;
+  aodist = xao * xao + yao * yao;
+  if (b->weighted == 1) {
+    /* The power center of the weighted vertices, thus the power */
+    /*   diagram of a regular triangulation.                     */
+    dodist -= tdest[2] - torg[2];
+    aodist -= tapex[2] - torg[2];
+  }
+  if (b->noexact) {
+    denominator = 0.5 / (xdo * yao - xao * ydo);
+  } else {
+    denominator = 0.5 / counterclockwiseuncounted(b, tdest, tapex, torg);
+  }
+  center[0] = torg[0] + (yao * dodist - ydo * aodist) * denominator;
+  center[1] = torg[1] + (xdo * aodist - xao * dodist) * denominator;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  buildvoronoi()   Create the Voronoi diagram of the current mesh, using   */
+/*                   `b->threads' threads.                                   */
+/*                                                                           */
+/*  Same output as writevoronoi() (without the vertex attributes), but works */
+/*  on any mesh, not only on one created with the -v switch: the numbers of  */
+/*  the Voronoi vertices are stored in the triangles only temporarily, the   */
+/*  subsegment pointers they overwrite are restored afterwards.  The blocks  */
+/*  of the triangle pool are processed concurrently, their results are      */
+/*  placed at offsets counted beforehand, thus the numbering is the same as  */
+/*  in a serial traversal.  The lists are allocated with trimalloc().        */
+/*  For a regular triangulation (-w switch) the power diagram is created.    */
+/*                                                                           */
+/*  If `vsitelist' isn't NULL, it gets the two vertices (numbered by         */
+/*  numbernodes()) separated by each Voronoi edge:  first the one left of    */
+/*  the edge, seen from its first Voronoi vertex towards the second one (or  */
+/*  along the ray), then the one right of it.                                */
+/*                                                                           */
+/*  Returns the number of Voronoi edges written, i.e. the number of edges    */
+/*  counted in the mesh, which doesn't rely on `m->edges' being up to date.  */
+/*  Added mrkkrj.                                                            */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+long buildvoronoi(struct mesh *m, struct behavior *b, REAL **vpointlist,
+                  int **vedgelist, REAL **vnormlist, int **vsitelist)
+#else /* not ANSI_DECLARATORS */
+long buildvoronoi(m, b, vpointlist, vedgelist, vnormlist, vsitelist)
+struct mesh *m;
+struct behavior *b;
+REAL **vpointlist;
+int **vedgelist;
+REAL **vnormlist;
+int **vsitelist;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  REAL *plist;
+  int *elist;
+  REAL *normlist;
+  int *slist;
+  long blockcount;
+  long i;
+
+  if (!b->quiet) {
+    printf("Building Voronoi diagram.\n");
+  }
+  blockcount = poolblocks(&m->triangles, (VOID **) NULL, (int *) NULL);
+  std::vector<VOID *> blockitems(blockcount);
+  std::vector<int> blockcounts(blockcount);
+  std::vector<long> firstvnode(blockcount + 1, 0l);
+  std::vector<long> firstvedge(blockcount + 1, 0l);
+  poolblocks(&m->triangles, blockitems.data(), blockcounts.data());
+
+  /* Each edge is owned by the triangle with the smaller pointer, or by */
+  /*   the only one on the boundary, as in writevoronoi().              */
+  auto ownsedge = [m](struct otri *tri) {
+    struct otri trisym;
+    triangle ptr;                       /* Temporary variable used by sym(). */
+
+    sym(*tri, trisym);
+    return (tri->tri < trisym.tri) || (trisym.tri == m->dummytri);
+  };
+
+  /* Count the Voronoi vertices and edges of each block. */
+  tpp::parallelFor(blockcount, b->threads, [&](long firstblock, long lastblock) {
+    struct otri triangleloop;
+    long block;
+    int j;
+
+    for (block = firstblock; block < lastblock; block++) {
+      for (j = 0; j < blockcounts[block]; j++) {
+        triangleloop.tri = (triangle *) ((char *) blockitems[block] +
+                                         j * m->triangles.itembytes);
+        if (deadtri(triangleloop.tri)) {
+          continue;
+        }
+        firstvnode[block + 1]++;
+        for (triangleloop.orient = 0; triangleloop.orient < 3;
+             triangleloop.orient++) {
+          if (ownsedge(&triangleloop)) {
+            firstvedge[block + 1]++;
+          }
+        }
+      }
+    }
+  });
+  for (i = 0; i < blockcount; i++) {
+    firstvnode[i + 1] += firstvnode[i];
+    firstvedge[i + 1] += firstvedge[i];
+  }
+
+  *vpointlist = (REAL *) trimalloc((int) (firstvnode[blockcount] * 2 *
+                                          sizeof(REAL)));
+  *vedgelist = (int *) trimalloc((int) (firstvedge[blockcount] * 2 *
+                                        sizeof(int)));
+  *vnormlist = (REAL *) trimalloc((int) (firstvedge[blockcount] * 2 *
+                                         sizeof(REAL)));
+  plist = *vpointlist;
+  elist = *vedgelist;
+  normlist = *vnormlist;
+  slist = (int *) NULL;
+  if (vsitelist != (int **) NULL) {
+    *vsitelist = (int *) trimalloc((int) (firstvedge[blockcount] * 2 *
+                                          sizeof(int)));
+    slist = *vsitelist;
+  }
+  std::vector<triangle> savedslots(firstvnode[blockcount]);
+
+  /* Find the circumcenters, and number the triangles. */
+  tpp::parallelFor(blockcount, b->threads, [&](long firstblock, long lastblock) {
+    struct otri triangleloop;
+    vertex torg, tdest, tapex;
+    long block, vnodenumber;
+    int j;
+
+    for (block = firstblock; block < lastblock; block++) {
+      vnodenumber = firstvnode[block];
+      triangleloop.orient = 0;
+      for (j = 0; j < blockcounts[block]; j++) {
+        triangleloop.tri = (triangle *) ((char *) blockitems[block] +
+                                         j * m->triangles.itembytes);
+        if (deadtri(triangleloop.tri)) {
+          continue;
+        }
+        org(triangleloop, torg);
+        dest(triangleloop, tdest);
+        apex(triangleloop, tapex);
+        voronoicenter(b, torg, tdest, tapex, &plist[2 * vnodenumber]);
+
+        savedslots[vnodenumber] = triangleloop.tri[6];
+        * (int *) (triangleloop.tri + 6) = (int) vnodenumber;
+        vnodenumber++;
+      }
+    }
+  });
+
+  /* Connect the Voronoi vertices of adjacent triangles. */
+  tpp::parallelFor(blockcount, b->threads, [&](long firstblock, long lastblock) {
+    struct otri triangleloop, trisym;
+    vertex torg, tdest;
+    long block, coordindex;
+    int p1;
+    int j;
+    triangle ptr;                       /* Temporary variable used by sym(). */
+
+    for (block = firstblock; block < lastblock; block++) {
+      coordindex = 2 * firstvedge[block];
+      for (j = 0; j < blockcounts[block]; j++) {
+        triangleloop.tri = (triangle *) ((char *) blockitems[block] +
+                                         j * m->triangles.itembytes);
+        if (deadtri(triangleloop.tri)) {
+          continue;
+        }
+        p1 = * (int *) (triangleloop.tri + 6);
+        for (triangleloop.orient = 0; triangleloop.orient < 3;
+             triangleloop.orient++) {
+          if (!ownsedge(&triangleloop)) {
+            continue;
+          }
+          org(triangleloop, torg);
+          dest(triangleloop, tdest);
+          if (slist != (int *) NULL) {
+            /* The edge leaves the triangle across `torg'-`tdest'. */
+            slist[coordindex] = vertexmark(tdest) - b->firstnumber;
+            slist[coordindex + 1] = vertexmark(torg) - b->firstnumber;
+          }
+          sym(triangleloop, trisym);
+          if (trisym.tri == m->dummytri) {
+            /* An infinite ray, the normal vector of the hull edge. */
+            elist[coordindex] = p1;
+            normlist[coordindex++] = tdest[1] - torg[1];
+            elist[coordindex] = -1;
+            normlist[coordindex++] = torg[0] - tdest[0];
+          } else {
+            elist[coordindex] = p1;
+            normlist[coordindex++] = 0.0;
+            elist[coordindex] = * (int *) (trisym.tri + 6);
+            normlist[coordindex++] = 0.0;
+          }
+        }
+      }
+    }
+  });
+
+  /* Give the triangles their subsegment pointers back. */
+  tpp::parallelFor(blockcount, b->threads, [&](long firstblock, long lastblock) {
+    triangle *tri;
+    long block, vnodenumber;
+    int j;
+
+    for (block = firstblock; block < lastblock; block++) {
+      vnodenumber = firstvnode[block];
+      for (j = 0; j < blockcounts[block]; j++) {
+        tri = (triangle *) ((char *) blockitems[block] +
+                            j * m->triangles.itembytes);
+        if (!deadtri(tri)) {
+          tri[6] = savedslots[vnodenumber++];
+        }
+      }
+    }
+  });
+
+  return firstvedge[blockcount];
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  clipconvex()   Clip a polygon by a convex one (Sutherland-Hodgman).     */
+/*                                                                           */
+/*  `polygon' holds the x- and y-coordinates of the corners, it's replaced   */
+/*  by the clipped polygon, which is empty if nothing is left.  The          */
+/*  `clipcorners' corners of `clip' must be in counterclockwise order.       */
+/*  Added mrkkrj.                                                            */
+/*                                                                           */
+/*****************************************************************************/
+
+void clipconvex(std::vector<REAL> &polygon, REAL *clip, int clipcorners,
+                std::vector<REAL> &scratch)
+{
+  REAL *c0, *c1, *p, *q;
+  REAL ex, ey, pside, qside, t;
+  size_t corners, i;
+  int k;
+  bool inside;
+
+  /* Most polygons lie completely inside, nothing to do then. */
+  inside = true;
+  for (k = 0; (k < clipcorners) && inside; k++) {
+    c0 = &clip[2 * k];
+    c1 = &clip[2 * ((k + 1) % clipcorners)];
+    for (i = 0; (i < polygon.size()) && inside; i += 2) {
+      inside = (c1[0] - c0[0]) * (polygon[i + 1] - c0[1]) -
+               (c1[1] - c0[1]) * (polygon[i] - c0[0]) >= 0.0;
+    }
+  }
+  if (inside) {
+    return;
+  }
+
+  for (k = 0; (k < clipcorners) && !polygon.empty(); k++) {
+    c0 = &clip[2 * k];
+    c1 = &clip[2 * ((k + 1) % clipcorners)];
+    ex = c1[0] - c0[0];
+    ey = c1[1] - c0[1];
+    scratch.clear();
+    corners = polygon.size() / 2;
+    for (i = 0; i < corners; i++) {
+      p = &polygon[2 * i];
+      q = &polygon[2 * ((i + 1) % corners)];
+      /* Positive on the inner (left) side of the clip edge. */
+      pside = ex * (p[1] - c0[1]) - ey * (p[0] - c0[0]);
+      qside = ex * (q[1] - c0[1]) - ey * (q[0] - c0[0]);
+      if (pside >= 0.0) {
+        scratch.push_back(p[0]);
+        scratch.push_back(p[1]);
+      }
+      if (((pside > 0.0) && (qside < 0.0)) ||
+          ((pside < 0.0) && (qside > 0.0))) {
+        t = pside / (pside - qside);
+        scratch.push_back(p[0] + t * (q[0] - p[0]));
+        scratch.push_back(p[1] + t * (q[1] - p[1]));
+      }
+    }
+    polygon.swap(scratch);
+  }
+  if (polygon.size() < 6) {
+    polygon.clear();
+  }
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  numbertriangles()   Number the living triangles in traversal order,      */
+/*                      using `b->threads' threads.                          */
+/*                                                                           */
+/*  Each triangle's number is stored in place of its third subsegment        */
+/*  pointer, as writevoronoi() does, thus it can be looked up via any        */
+/*  neighbor.  The overwritten pointers are kept in `savedslots' for         */
+/*  restoretriangles(), which must be called before the mesh is used again.  */
+/*  Returns the number of triangles.  Added mrkkrj.                          */
+/*                                                                           */
+/*****************************************************************************/
+
+long numbertriangles(struct mesh *m, struct behavior *b,
+                     std::vector<triangle> &savedslots)
+{
+  long slicecount;
+  long i;
+
+  slicecount = 4 * b->threads;
+  std::vector<long> slicestarts(slicecount + 1, 0l);
+
+  /* Count the living triangles of each slice, then number them. */
+  traverseparallel(&m->triangles, b->threads, slicecount,
+                   [&](long slice, VOID *item) {
+    if (!deadtri((triangle *) item)) {
+      slicestarts[slice + 1]++;
+    }
+  });
+  for (i = 0; i < slicecount; i++) {
+    slicestarts[i + 1] += slicestarts[i];
+  }
+  savedslots.resize(slicestarts[slicecount]);
+
+  traverseparallel(&m->triangles, b->threads, slicecount,
+                   [&](long slice, VOID *item) {
+    triangle *tri = (triangle *) item;
+
+    if (!deadtri(tri)) {
+      savedslots[slicestarts[slice]] = tri[6];
+      * (int *) (tri + 6) = (int) slicestarts[slice]++;
+    }
+  });
+  return (long) savedslots.size();
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  restoretriangles()   Undo numbertriangles().  Added mrkkrj.              */
+/*                                                                           */
+/*****************************************************************************/
+
+void restoretriangles(struct mesh *m, struct behavior *b,
+                      std::vector<triangle> &savedslots)
+{
+  traverseparallel(&m->triangles, b->threads, 4 * b->threads,
+                   [&](long, VOID *item) {
+    triangle *tri = (triangle *) item;
+
+    if (!deadtri(tri)) {
+      tri[6] = savedslots[* (int *) (tri + 6)];
+    }
+  });
+}
 
-#ifndef TRILIBRARY
-  finishfile(outfile, argc, argv);
-#endif /* not TRILIBRARY */
+/*****************************************************************************/
+/*                                                                           */
+/*  findcellstarts()   Find a triangle of each vertex's Voronoi cell.        */
+/*                                                                           */
+/*  For the vertex numbered `v' (by numbernodes()), `startris[v]' is an      */
+/*  encoded triangle with the vertex as its origin, for a boundary vertex    */
+/*  the one preceding the boundary clockwise, thus a counterclockwise walk   */
+/*  by walkcell() covers all of its triangles.  `degrees[v]' counts the      */
+/*  vertex's triangles and `openings[v]' its boundary edges.  Vertices not   */
+/*  in the mesh get a NULL start.  Added mrkkrj.                             */
+/*                                                                           */
+/*****************************************************************************/
 
-#ifdef TRILIBRARY
-  if (!b->quiet) {
-    printf("Writing Voronoi edges.\n");
-  }
-  /* Allocate memory for output Voronoi edges if necessary. */
-  if (*vedgelist == (int *) NULL) {
-    *vedgelist = (int *) trimalloc((int) (m->edges * 2 * sizeof(int)));
-  }
-  *vedgemarkerlist = (int *) NULL;
-  /* Allocate memory for output Voronoi norms if necessary. */
-  if (*vnormlist == (REAL *) NULL) {
-    *vnormlist = (REAL *) trimalloc((int) (m->edges * 2 * sizeof(REAL)));
-  }
-  elist = *vedgelist;
-  normlist = *vnormlist;
-  coordindex = 0;
-#else /* not TRILIBRARY */
-  if (!b->quiet) {
-    printf("Writing %s.\n", vedgefilename);
-  }
-  outfile = fopen(vedgefilename, "w");
-  if (outfile == (FILE *) NULL) {
-    printf("  Error:  Cannot create file %s.\n", vedgefilename);
-    triexit(1);
-  }
-  /* Number of edges, zero boundary markers. */
-  fprintf(outfile, "%ld  %d\n", m->edges, 0);
-#endif /* not TRILIBRARY */
+void findcellstarts(struct mesh *m, struct behavior *b,
+                    std::vector<triangle> &startris,
+                    std::vector<int> &degrees, std::vector<int> &openings)
+{
+  struct otri triangleloop, trisym;
+  vertex torg;
+  long cellcount;
+  long v;
+  triangle ptr;                         /* Temporary variable used by sym(). */
 
+  cellcount = m->vertices.items;
+  startris.assign(cellcount, (triangle) NULL);
+  degrees.assign(cellcount, 0);
+  openings.assign(cellcount, 0);
   traversalinit(&m->triangles);
   triangleloop.tri = triangletraverse(m);
-  vedgenumber = b->firstnumber;
-  /* To loop over the set of edges, loop over all triangles, and look at   */
-  /*   the three edges of each triangle.  If there isn't another triangle  */
-  /*   adjacent to the edge, operate on the edge.  If there is another     */
-  /*   adjacent triangle, operate on the edge only if the current triangle */
-  /*   has a smaller pointer than its neighbor.  This way, each edge is    */
-  /*   considered only once.                                               */
   while (triangleloop.tri != (triangle *) NULL) {
     for (triangleloop.orient = 0; triangleloop.orient < 3;
          triangleloop.orient++) {
+      org(triangleloop, torg);
+      v = vertexmark(torg) - b->firstnumber;
+      if ((v < 0) || (v >= cellcount)) {
+        continue;
+      }
+      degrees[v]++;
       sym(triangleloop, trisym);
-      if ((triangleloop.tri < trisym.tri) || (trisym.tri == m->dummytri)) {
-        /* Find the number of this triangle (and Voronoi vertex). */
-        p1 = * (int *) (triangleloop.tri + 6);
-        if (trisym.tri == m->dummytri) {
-          org(triangleloop, torg);
-          dest(triangleloop, tdest);
-#ifdef TRILIBRARY
-          /* Copy an infinite ray.  Index of one endpoint, and -1. */
-          elist[coordindex] = p1;
-          normlist[coordindex++] = tdest[1] - torg[1];
-          elist[coordindex] = -1;
-          normlist[coordindex++] = torg[0] - tdest[0];
-#else /* not TRILIBRARY */
-          /* Write an infinite ray.  Edge number, index of one endpoint, -1, */
-          /*   and x and y coordinates of a vector representing the          */
-          /*   direction of the ray.                                         */
-          fprintf(outfile, "%4ld   %d  %d   %.17g  %.17g\n", vedgenumber,
-                  p1, -1, tdest[1] - torg[1], torg[0] - tdest[0]);
-#endif /* not TRILIBRARY */
+      if (trisym.tri == m->dummytri) {
+        openings[v]++;
+        startris[v] = encode(triangleloop);
+      } else if (startris[v] == (triangle) NULL) {
+        startris[v] = encode(triangleloop);
+      }
+    }
+    triangleloop.tri = triangletraverse(m);
+  }
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  walkcell()   Walk counterclockwise around the origin of `starttri',      */
+/*               calling `func(tri)' for each triangle.                      */
+/*                                                                           */
+/*  Returns true if the walk came back to `starttri', i.e. the cell is       */
+/*  closed, false if it stopped at the boundary.  Added mrkkrj.              */
+/*                                                                           */
+/*****************************************************************************/
+
+template <class Func>
+bool walkcell(struct mesh *m, triangle starttri, Func func)
+{
+  struct otri walktri, firsttri;
+  triangle ptr;                         /* Temporary variable used by sym(). */
+
+  decode(starttri, firsttri);
+  otricopy(firsttri, walktri);
+  do {
+    func(&walktri);
+    onextself(walktri);
+  } while ((walktri.tri != m->dummytri) && (walktri.tri != firsttri.tri));
+  return walktri.tri != m->dummytri;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  clipextent()   Find the center of a clip polygon's corners, and their    */
+/*                 largest distance from it, which is returned.              */
+/*                                                                           */
+/*  Both are zero if `clipcorners' is zero.  Added mrkkrj.                   */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+REAL clipextent(REAL *clippolygon, int clipcorners, REAL *clipcenter)
+#else /* not ANSI_DECLARATORS */
+REAL clipextent(clippolygon, clipcorners, clipcenter)
+REAL *clippolygon;
+int clipcorners;
+REAL *clipcenter;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  REAL clipradius;
+  int i;
+
+  clipcenter[0] = clipcenter[1] = clipradius = 0.0;
+  for (i = 0; i < clipcorners; i++) {
+    clipcenter[0] += clippolygon[2 * i] / clipcorners;
+    clipcenter[1] += clippolygon[2 * i + 1] / clipcorners;
+  }
+  for (i = 0; i < clipcorners; i++) {
+    clipradius = std::max(clipradius,
+                          std::hypot(clippolygon[2 * i] - clipcenter[0],
+                                     clippolygon[2 * i + 1] - clipcenter[1]));
+  }
+  return clipradius;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  closecell()   Close an unbounded Voronoi cell beyond a clip polygon.     */
+/*                                                                           */
+/*  `polygon' holds the cell's Voronoi vertices, counterclockwise around     */
+/*  the boundary vertex `tsite', from the one of its first triangle (whose   */
+/*  boundary edge leads to `tdest') to the one of its last triangle (whose   */
+/*  boundary edge comes from `tapex').  The rays leave along the outer       */
+/*  normals of the boundary edges; the cell is closed by three points beyond */
+/*  the clip polygon given by clipextent(), the middle one halfway around    */
+/*  from the last ray to the first.  Added mrkkrj.                           */
+/*                                                                           */
+/*****************************************************************************/
+
+void closecell(std::vector<REAL> &polygon, vertex tsite, vertex tapex,
+               vertex tdest, REAL *clipcenter, REAL clipradius)
+{
+  REAL first[2], prev[2];
+  REAL raya[2], rayb[2], raym[2];
+  REAL length, angle, reach;
+  size_t corner;
+
+  first[0] = polygon[0];
+  first[1] = polygon[1];
+  prev[0] = polygon[polygon.size() - 2];
+  prev[1] = polygon[polygon.size() - 1];
+  raya[0] = tsite[1] - tapex[1];
+  raya[1] = tapex[0] - tsite[0];
+  rayb[0] = tdest[1] - tsite[1];
+  rayb[1] = tsite[0] - tdest[0];
+  length = std::hypot(raya[0], raya[1]);
+  raya[0] /= length;
+  raya[1] /= length;
+  length = std::hypot(rayb[0], rayb[1]);
+  rayb[0] /= length;
+  rayb[1] /= length;
+  angle = atan2(raya[0] * rayb[1] - raya[1] * rayb[0],
+                raya[0] * rayb[0] + raya[1] * rayb[1]);
+  if (angle < 0.0) {
+    angle += 2.0 * PI;
+  }
+  raym[0] = raya[0] * cos(0.5 * angle) - raya[1] * sin(0.5 * angle);
+  raym[1] = raya[0] * sin(0.5 * angle) + raya[1] * cos(0.5 * angle);
+
+  reach = clipradius;
+  for (corner = 0; corner < polygon.size(); corner += 2) {
+    reach = std::max(reach, std::hypot(polygon[corner] - clipcenter[0],
+                                       polygon[corner + 1] - clipcenter[1]));
+  }
+  reach *= 8.0;
+  polygon.push_back(prev[0] + reach * raya[0]);
+  polygon.push_back(prev[1] + reach * raya[1]);
+  polygon.push_back(tsite[0] + 2.0 * reach * raym[0]);
+  polygon.push_back(tsite[1] + 2.0 * reach * raym[1]);
+  polygon.push_back(first[0] + reach * rayb[0]);
+  polygon.push_back(first[1] + reach * rayb[1]);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  buildvoronoicells()   Collect the Voronoi cell of each vertex, using     */
+/*                        `b->threads' threads.                              */
+/*                                                                           */
+/*  The cell of the vertex numbered `v' (by numbernodes()) is given by the   */
+/*  entries `celloffsets[v]' to `celloffsets[v + 1] - 1' of `cellvertices'   */
+/*  and `cellneighbors':  the Voronoi vertices (numbered as by               */
+/*  buildvoronoi()) in counterclockwise order, and for each of them the      */
+/*  neighbor vertex across the cell's edge to the next one.  The Voronoi     */
+/*  vertices are computed again, exactly as by buildvoronoi(), for the areas */
+/*  and the clipping.  The cell of a vertex on the boundary of the mesh is   */
+/*  unbounded, it's closed by a -1 entry (the vertex at infinity) and gets   */
+/*  an area of HUGE_VAL.  The cells of vertices not in the mesh are empty.   */
+/*                                                                           */
+/*  If `clipcorners' > 0, the cells are also clipped by the convex polygon   */
+/*  `clippolygon' (counterclockwise), in the same pass:  the corners of the  */
+/*  clipped cell `v' are the points `clipoffsets[v]' to                      */
+/*  `clipoffsets[v + 1] - 1' of `clippoints', and `cellareas' are the areas  */
+/*  of the clipped cells.  Unbounded cells are closed far enough outside of  */
+/*  the clip polygon before.                                                 */
+/*                                                                           */
+/*  The start triangle of each cell is found in a serial traversal, the      */
+/*  cells themselves are walked concurrently.  If a vertex's triangles don't */
+/*  form a single fan (a vertex where two holes meet), only one fan is       */
+/*  used.  The lists are allocated with trimalloc().  Added mrkkrj.          */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void buildvoronoicells(struct mesh *m, struct behavior *b,
+                       int **celloffsets, int **cellvertices,
+                       int **cellneighbors, REAL **cellareas,
+                       REAL *clippolygon, int clipcorners,
+                       int **clipoffsets, REAL **clippoints)
+#else /* not ANSI_DECLARATORS */
+void buildvoronoicells(m, b, celloffsets, cellvertices, cellneighbors,
+                       cellareas, clippolygon, clipcorners, clipoffsets,
+                       clippoints)
+struct mesh *m;
+struct behavior *b;
+int **celloffsets;
+int **cellvertices;
+int **cellneighbors;
+REAL **cellareas;
+REAL *clippolygon;
+int clipcorners;
+int **clipoffsets;
+REAL **clippoints;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  int *offsets;
+  int *vlist;
+  int *nlist;
+  REAL *areas;
+  int *clipoffs;
+  REAL *clippts;
+  REAL clipcenter[2];
+  REAL clipradius;
+  long cellcount;
+  long slicecount, slicesize;
+  long v;
+
+  cellcount = m->vertices.items;
+  std::vector<triangle> savedslots;
+  numbertriangles(m, b, savedslots);
+
+  std::vector<triangle> startris;
+  std::vector<int> degrees;
+  std::vector<int> openings;
+  findcellstarts(m, b, startris, degrees, openings);
+
+  *celloffsets = (int *) trimalloc((int) ((cellcount + 1) * sizeof(int)));
+  *cellareas = (REAL *) trimalloc((int) (cellcount * sizeof(REAL)));
+  offsets = *celloffsets;
+  areas = *cellareas;
+
+  /* Count the entries of each cell, a walk is needed only if there are */
+  /*   several fans.                                                     */
+  offsets[0] = 0;
+  tpp::parallelFor(cellcount, b->threads, [&](long firstcell, long lastcell) {
+    long cell;
+    int entries;
+
+    for (cell = firstcell; cell < lastcell; cell++) {
+      if (openings[cell] <= 1) {
+        offsets[cell + 1] = degrees[cell] + openings[cell];
+        continue;
+      }
+      entries = 1;
+      walkcell(m, startris[cell], [&](struct otri *) { entries++; });
+      offsets[cell + 1] = entries;
+    }
+  });
+  for (v = 0; v < cellcount; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+
+  *cellvertices = (int *) trimalloc((int) (offsets[cellcount] * sizeof(int)));
+  *cellneighbors = (int *) trimalloc((int) (offsets[cellcount] *
+                                            sizeof(int)));
+  vlist = *cellvertices;
+  nlist = *cellneighbors;
+
+  /* The clipped cells are collected per slice of the cells, in order. */
+  slicecount = 4 * b->threads;
+  slicesize = cellcount / slicecount + 1;
+  std::vector<std::vector<REAL> > slicepoints(slicecount);
+  std::vector<int> clipcounts;
+  clipradius = clipextent(clippolygon, clipcorners, clipcenter);
+  if (clipcorners > 0) {
+    clipcounts.resize(cellcount + 1, 0);
+  }
+
+  /* Fill in the cells, and sum up their areas. */
+  tpp::parallelFor(slicecount, b->threads, [&](long firstslice,
+                                               long lastslice) {
+    struct otri firsttri, centertri;
+    vertex tapex, tdest, tsite;
+    vertex corg, cdest, capex;
+    REAL first[2], prev[2], next[2];
+    REAL *nextcorner;
+    REAL area;
+    long slice, cell;
+    int entry;
+    size_t corner;
+    bool closed;
+    std::vector<REAL> polygon, scratch;
+
+    for (slice = firstslice; slice < lastslice; slice++) {
+      for (cell = slice * slicesize;
+           (cell < (slice + 1) * slicesize) && (cell < cellcount); cell++) {
+        areas[cell] = 0.0;
+        if (startris[cell] == (triangle) NULL) {
+          continue;
+        }
+        entry = offsets[cell];
+        area = 0.0;
+        polygon.clear();
+        closed = walkcell(m, startris[cell], [&](struct otri *walktri) {
+          vlist[entry] = * (int *) (walktri->tri + 6);
+          apex(*walktri, tapex);
+          nlist[entry] = vertexmark(tapex) - b->firstnumber;
+          /* The same orientation as in buildvoronoi(), for equal results. */
+          centertri.tri = walktri->tri;
+          centertri.orient = 0;
+          org(centertri, corg);
+          dest(centertri, cdest);
+          apex(centertri, capex);
+          voronoicenter(b, corg, cdest, capex, next);
+          if (entry == offsets[cell]) {
+            first[0] = next[0];
+            first[1] = next[1];
+          } else {
+            area += prev[0] * next[1] - prev[1] * next[0];
+          }
+          if (clipcorners > 0) {
+            polygon.push_back(next[0]);
+            polygon.push_back(next[1]);
+          }
+          prev[0] = next[0];
+          prev[1] = next[1];
+          entry++;
+        });
+        decode(startris[cell], firsttri);
+        if (closed) {
+          area += prev[0] * first[1] - prev[1] * first[0];
+          areas[cell] = 0.5 * area;
         } else {
-          /* Find the number of the adjacent triangle (and Voronoi vertex). */
-          p2 = * (int *) (trisym.tri + 6);
-          /* Finite edge.  Write indices of two endpoints. */
-#ifdef TRILIBRARY
-          elist[coordindex] = p1;
-          normlist[coordindex++] = 0.0;
-          elist[coordindex] = p2;
-          normlist[coordindex++] = 0.0;
-#else /* not TRILIBRARY */
-          fprintf(outfile, "%4ld   %d  %d\n", vedgenumber, p1, p2);
-#endif /* not TRILIBRARY */
+          /* Closed at infinity, across the boundary edge of the start. */
+          dest(firsttri, tdest);
+          vlist[entry] = -1;
+          nlist[entry] = vertexmark(tdest) - b->firstnumber;
+          areas[cell] = HUGE_VAL;
         }
-        vedgenumber++;
+        if (clipcorners == 0) {
+          continue;
+        }
+
+        if (!closed) {
+          org(firsttri, tsite);
+          closecell(polygon, tsite, tapex, tdest, clipcenter, clipradius);
+        }
+
+        clipconvex(polygon, clippolygon, clipcorners, scratch);
+        area = 0.0;
+        for (corner = 0; corner < polygon.size(); corner += 2) {
+          nextcorner = &polygon[(corner + 2) % polygon.size()];
+          area += polygon[corner] * nextcorner[1] -
+                  polygon[corner + 1] * nextcorner[0];
+        }
+        areas[cell] = 0.5 * area;
+        slicepoints[slice].insert(slicepoints[slice].end(), polygon.begin(),
+                                  polygon.end());
+        clipcounts[cell + 1] = (int) (polygon.size() / 2);
       }
     }
-    triangleloop.tri = triangletraverse(m);
+  });
+
+  if (clipcorners > 0) {
+    /* Pack the clipped cells. */
+    for (v = 0; v < cellcount; v++) {
+      clipcounts[v + 1] += clipcounts[v];
+    }
+    *clipoffsets = (int *) trimalloc((int) ((cellcount + 1) * sizeof(int)));
+    *clippoints = (REAL *) trimalloc((int) (2 * clipcounts[cellcount] *
+                                            sizeof(REAL)));
+    clipoffs = *clipoffsets;
+    clippts = *clippoints;
+    std::copy(clipcounts.begin(), clipcounts.end(), clipoffs);
+    tpp::parallelFor(slicecount, b->threads, [&](long firstslice,
+                                                 long lastslice) {
+      long slice;
+
+      for (slice = firstslice; slice < lastslice; slice++) {
+        std::copy(slicepoints[slice].begin(), slicepoints[slice].end(),
+                  clippts + 2 * clipoffs[std::min(slice * slicesize,
+                                                  cellcount)]);
+      }
+    });
   }
 
-#ifndef TRILIBRARY
-  finishfile(outfile, argc, argv);
-#endif /* not TRILIBRARY */
+  restoretriangles(m, b, savedslots);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  buildcellcentroids()   Find the centroid of each vertex's Voronoi cell,  */
+/*                         clipped by a convex polygon, using `b->threads'   */
+/*                         threads.                                          */
+/*                                                                           */
+/*  The cell of the vertex numbered `v' (by numbernodes()) is clipped by the */
+/*  `clipcorners' corners of `clippolygon' (counterclockwise) as in          */
+/*  buildvoronoicells(), but its Voronoi vertices are computed on the fly    */
+/*  and nothing is stored.  Its centroid is written to `centroids[2v]' and   */
+/*  `centroids[2v + 1]', the second moment of the clipped cell about the     */
+/*  vertex to `moments[v]'.  If nothing is left of the cell, the centroid    */
+/*  isn't written and the moment is zero.  Added mrkkrj.                     */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void buildcellcentroids(struct mesh *m, struct behavior *b,
+                        REAL *clippolygon, int clipcorners,
+                        REAL *centroids, REAL *moments)
+#else /* not ANSI_DECLARATORS */
+void buildcellcentroids(m, b, clippolygon, clipcorners, centroids, moments)
+struct mesh *m;
+struct behavior *b;
+REAL *clippolygon;
+int clipcorners;
+REAL *centroids;
+REAL *moments;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  REAL clipcenter[2];
+  REAL clipradius;
+  long cellcount;
+
+  cellcount = m->vertices.items;
+  std::vector<triangle> startris;
+  std::vector<int> degrees;
+  std::vector<int> openings;
+  findcellstarts(m, b, startris, degrees, openings);
+  clipradius = clipextent(clippolygon, clipcorners, clipcenter);
+
+  tpp::parallelFor(cellcount, b->threads, [&](long firstcell, long lastcell) {
+    struct otri firsttri;
+    vertex torg, tdest, tapex;
+    vertex tsite;
+    REAL center[2];
+    REAL ax, ay, bx, by;
+    REAL area, triarea, cx, cy, moment;
+    long cell;
+    size_t corner;
+    bool closed;
+    std::vector<REAL> polygon, scratch;
+
+    for (cell = firstcell; cell < lastcell; cell++) {
+      moments[cell] = 0.0;
+      if (startris[cell] == (triangle) NULL) {
+        continue;
+      }
+      polygon.clear();
+      closed = walkcell(m, startris[cell], [&](struct otri *walktri) {
+        org(*walktri, torg);
+        dest(*walktri, tdest);
+        apex(*walktri, tapex);
+        voronoicenter(b, torg, tdest, tapex, center);
+        polygon.push_back(center[0]);
+        polygon.push_back(center[1]);
+      });
+      decode(startris[cell], firsttri);
+      org(firsttri, tsite);
+      if (!closed) {
+        dest(firsttri, tdest);
+        closecell(polygon, tsite, tapex, tdest, clipcenter, clipradius);
+      }
+      clipconvex(polygon, clippolygon, clipcorners, scratch);
+
+      /* Sum up the triangles of a fan from the vertex, relative to it. */
+      area = cx = cy = moment = 0.0;
+      for (corner = 0; corner < polygon.size(); corner += 2) {
+        ax = polygon[corner] - tsite[0];
+        ay = polygon[corner + 1] - tsite[1];
+        bx = polygon[(corner + 2) % polygon.size()] - tsite[0];
+        by = polygon[(corner + 3) % polygon.size()] - tsite[1];
+        triarea = 0.5 * (ax * by - ay * bx);
+        area += triarea;
+        cx += triarea * (ax + bx) / 3.0;
+        cy += triarea * (ay + by) / 3.0;
+        moment += triarea * (ax * ax + ay * ay + bx * bx + by * by +
+                             ax * bx + ay * by) / 6.0;
+      }
+      if (area > 0.0) {
+        centroids[2 * cell] = tsite[0] + cx / area;
+        centroids[2 * cell + 1] = tsite[1] + cy / area;
+        moments[cell] = moment;
+      }
+    }
+  });
 }
 
+#endif /* TRILIBRARY */
+
 #ifdef TRILIBRARY
 
 #ifdef ANSI_DECLARATORS
@@ -15996,53 +19354,47 @@ char **argv;
 
 /*****************************************************************************/
 /*                                                                           */
-/*  quality_statistics()   Print statistics about the quality of the mesh.   */
+/*  computequalitystats()   Measure the quality of the mesh, using           */
+/*                          `threads' threads.                               */
+/*                                                                           */
+/*  Computes the numbers printed by quality_statistics(), and counts the     */
+/*  triangles violating the angle, area and user constraints of the quality  */
+/*  switches (small input angles that can't be fixed included).  Uses no     */
+/*  exact arithmetic.  Neither the mesh nor the switches are changed.        */
+/*  Added mrkkrj.                                                            */
 /*                                                                           */
 /*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-void quality_statistics(struct mesh *m, struct behavior *b)
+void computequalitystats(struct mesh *m, struct behavior *b, int threads,
+                         struct qualitystats *stats)
 #else /* not ANSI_DECLARATORS */
-void quality_statistics(m, b)
+void computequalitystats(m, b, threads, stats)
 struct mesh *m;
 struct behavior *b;
+int threads;
+struct qualitystats *stats;
 #endif /* not ANSI_DECLARATORS */
 
 {
-  struct otri triangleloop;
-  vertex p[3];
+  /* The per-slice values, lengths squared and angles as cosines squared. */
+  struct slicestats {
+    struct qualitystats stats;
+    int acutebiggest;
+  };
   REAL cossquaretable[8];
   REAL ratiotable[16];
-  REAL dx[3], dy[3];
-  REAL edgelength[3];
-  REAL dotproduct;
-  REAL cossquare;
-  REAL triarea;
-  REAL shortest, longest;
-  REAL trilongest2;
-  REAL smallestarea, biggestarea;
-  REAL triminaltitude2;
-  REAL minaltitude;
-  REAL triaspect2;
-  REAL worstaspect;
-  REAL smallestangle, biggestangle;
   REAL radconst, degconst;
-  int angletable[18];
-  int aspecttable[16];
-  int aspectindex;
-  int tendegree;
-  int acutebiggest;
-  int i, ii, j, k;
+  REAL minaltitude;
+  long slicecount;
+  long i;
+  int j;
 
-  printf("Mesh quality statistics:\n\n");
   radconst = PI / 18.0;
   degconst = 180.0 / PI;
-  for (i = 0; i < 8; i++) {
-    cossquaretable[i] = cos(radconst * (REAL) (i + 1));
-    cossquaretable[i] = cossquaretable[i] * cossquaretable[i];
-  }
-  for (i = 0; i < 18; i++) {
-    angletable[i] = 0;
+  for (j = 0; j < 8; j++) {
+    cossquaretable[j] = cos(radconst * (REAL) (j + 1));
+    cossquaretable[j] = cossquaretable[j] * cossquaretable[j];
   }
 
   ratiotable[0]  =      1.5;      ratiotable[1]  =     2.0;
@@ -16053,29 +19405,48 @@ struct behavior *b;
   ratiotable[10] =    100.0;      ratiotable[11] =   300.0;
   ratiotable[12] =   1000.0;      ratiotable[13] = 10000.0;
   ratiotable[14] = 100000.0;      ratiotable[15] =     0.0;
-  for (i = 0; i < 16; i++) {
-    aspecttable[i] = 0;
-  }
 
-  worstaspect = 0.0;
   minaltitude = m->xmax - m->xmin + m->ymax - m->ymin;
   minaltitude = minaltitude * minaltitude;
-  shortest = minaltitude;
-  longest = 0.0;
-  smallestarea = minaltitude;
-  biggestarea = 0.0;
-  worstaspect = 0.0;
-  smallestangle = 0.0;
-  biggestangle = 2.0;
-  acutebiggest = 1;
 
-  traversalinit(&m->triangles);
-  triangleloop.tri = triangletraverse(m);
-  triangleloop.orient = 0;
-  while (triangleloop.tri != (triangle *) NULL) {
+  slicecount = 4 * threads;
+  std::vector<struct slicestats> slices(slicecount);
+  for (i = 0; i < slicecount; i++) {
+    struct qualitystats *slice = &slices[i].stats;
+    memset(slice, 0, sizeof(struct qualitystats));
+    slice->minaltitude = minaltitude;
+    slice->shortest = minaltitude;
+    slice->smallestarea = minaltitude;
+    slice->biggestangle = 2.0;
+    slices[i].acutebiggest = 1;
+  }
+
+  traverseparallel(&m->triangles, threads, slicecount,
+                   [&](long slicenumber, VOID *item) {
+    struct qualitystats *slice = &slices[slicenumber].stats;
+    struct otri triangleloop;
+    vertex p[3];
+    REAL dx[3], dy[3];
+    REAL edgelength[3];
+    REAL dotproduct;
+    REAL cossquare, trismallestangle;
+    REAL triarea, area;
+    REAL trilongest2;
+    REAL triminaltitude2;
+    REAL triaspect2;
+    int aspectindex;
+    int tendegree;
+    int i, ii, j, k;
+
+    triangleloop.tri = (triangle *) item;
+    triangleloop.orient = 0;
+    if (deadtri(triangleloop.tri)) {
+      return;
+    }
     org(triangleloop, p[0]);
     dest(triangleloop, p[1]);
     apex(triangleloop, p[2]);
+    slice->triangles++;
     trilongest2 = 0.0;
 
     for (i = 0; i < 3; i++) {
@@ -16087,36 +19458,38 @@ struct behavior *b;
       if (edgelength[i] > trilongest2) {
         trilongest2 = edgelength[i];
       }
-      if (edgelength[i] > longest) {
-        longest = edgelength[i];
+      if (edgelength[i] > slice->longest) {
+        slice->longest = edgelength[i];
       }
-      if (edgelength[i] < shortest) {
-        shortest = edgelength[i];
+      if (edgelength[i] < slice->shortest) {
+        slice->shortest = edgelength[i];
       }
     }
 
-    triarea = counterclockwise(m, b, p[0], p[1], p[2]);
-    if (triarea < smallestarea) {
-      smallestarea = triarea;
+    triarea = (p[0][0] - p[2][0]) * (p[1][1] - p[2][1]) -
+              (p[0][1] - p[2][1]) * (p[1][0] - p[2][0]);
+    if (triarea < slice->smallestarea) {
+      slice->smallestarea = triarea;
     }
-    if (triarea > biggestarea) {
-      biggestarea = triarea;
+    if (triarea > slice->biggestarea) {
+      slice->biggestarea = triarea;
     }
     triminaltitude2 = triarea * triarea / trilongest2;
-    if (triminaltitude2 < minaltitude) {
-      minaltitude = triminaltitude2;
+    if (triminaltitude2 < slice->minaltitude) {
+      slice->minaltitude = triminaltitude2;
     }
     triaspect2 = trilongest2 / triminaltitude2;
-    if (triaspect2 > worstaspect) {
-      worstaspect = triaspect2;
+    if (triaspect2 > slice->worstaspect) {
+      slice->worstaspect = triaspect2;
     }
     aspectindex = 0;
     while ((triaspect2 > ratiotable[aspectindex] * ratiotable[aspectindex])
            && (aspectindex < 15)) {
       aspectindex++;
     }
-    aspecttable[aspectindex]++;
+    slice->aspecttable[aspectindex]++;
 
+    trismallestangle = 0.0;
     for (i = 0; i < 3; i++) {
       j = plus1mod3[i];
       k = minus1mod3[i];
@@ -16129,44 +19502,159 @@ struct behavior *b;
         }
       }
       if (dotproduct <= 0.0) {
-        angletable[tendegree]++;
-        if (cossquare > smallestangle) {
-          smallestangle = cossquare;
+        slice->angletable[tendegree]++;
+        if (cossquare > slice->smallestangle) {
+          slice->smallestangle = cossquare;
         }
-        if (acutebiggest && (cossquare < biggestangle)) {
-          biggestangle = cossquare;
+        if (cossquare > trismallestangle) {
+          trismallestangle = cossquare;
+        }
+        if (slices[slicenumber].acutebiggest &&
+            (cossquare < slice->biggestangle)) {
+          slice->biggestangle = cossquare;
         }
       } else {
-        angletable[17 - tendegree]++;
-        if (acutebiggest || (cossquare > biggestangle)) {
-          biggestangle = cossquare;
-          acutebiggest = 0;
+        slice->angletable[17 - tendegree]++;
+        if (slices[slicenumber].acutebiggest ||
+            (cossquare > slice->biggestangle)) {
+          slice->biggestangle = cossquare;
+          slices[slicenumber].acutebiggest = 0;
         }
       }
     }
-    triangleloop.tri = triangletraverse(m);
-  }
 
-  shortest = sqrt(shortest);
-  longest = sqrt(longest);
-  minaltitude = sqrt(minaltitude);
-  worstaspect = sqrt(worstaspect);
-  smallestarea *= 0.5;
-  biggestarea *= 0.5;
-  if (smallestangle >= 1.0) {
-    smallestangle = 0.0;
+    /* Check the triangle against the quality switches. */
+    if (!b->quality) {
+      return;
+    }
+    if ((b->minangle > 0.0) && (trismallestangle > b->goodangle)) {
+      slice->badangles++;
+    }
+    area = 0.5 * triarea;
+    if ((b->fixedarea && (area > b->maxarea)) ||
+        (b->vararea && (areabound(triangleloop) > 0.0) &&
+         (area > areabound(triangleloop))) ||
+        ((b->sizingfield.areas != (REAL *) NULL) &&
+         (area > sizingfieldarea(b, (p[0][0] + p[1][0] + p[2][0]) / 3.0,
+                                 (p[0][1] + p[1][1] + p[2][1]) / 3.0)))) {
+      slice->badareas++;
+    }
+    if (b->usertest &&
+        ((b->usertestfunc != NULL) ?
+         b->usertestfunc(p[0], p[1], p[2], area, b->usertestcontext) :
+         triunsuitable(p[0], p[1], p[2], area))) {
+      slice->badusertests++;
+    }
+  });
+
+  /* Merge the slices, the biggest angle as in quality_statistics(). */
+  *stats = slices[0].stats;
+  int acutebiggest = slices[0].acutebiggest;
+  for (i = 1; i < slicecount; i++) {
+    struct qualitystats *slice = &slices[i].stats;
+    stats->triangles += slice->triangles;
+    for (j = 0; j < 18; j++) {
+      stats->angletable[j] += slice->angletable[j];
+    }
+    for (j = 0; j < 16; j++) {
+      stats->aspecttable[j] += slice->aspecttable[j];
+    }
+    stats->smallestangle = std::max(stats->smallestangle,
+                                    slice->smallestangle);
+    if (slice->triangles > 0) {
+      if (slices[i].acutebiggest) {
+        if (acutebiggest) {
+          stats->biggestangle = std::min(stats->biggestangle,
+                                         slice->biggestangle);
+        }
+      } else {
+        if (acutebiggest || (slice->biggestangle > stats->biggestangle)) {
+          stats->biggestangle = slice->biggestangle;
+        }
+        acutebiggest = 0;
+      }
+    }
+    stats->shortest = std::min(stats->shortest, slice->shortest);
+    stats->longest = std::max(stats->longest, slice->longest);
+    stats->minaltitude = std::min(stats->minaltitude, slice->minaltitude);
+    stats->worstaspect = std::max(stats->worstaspect, slice->worstaspect);
+    stats->smallestarea = std::min(stats->smallestarea, slice->smallestarea);
+    stats->biggestarea = std::max(stats->biggestarea, slice->biggestarea);
+    stats->badangles += slice->badangles;
+    stats->badareas += slice->badareas;
+    stats->badusertests += slice->badusertests;
+  }
+
+  stats->shortest = sqrt(stats->shortest);
+  stats->longest = sqrt(stats->longest);
+  stats->minaltitude = sqrt(stats->minaltitude);
+  stats->worstaspect = sqrt(stats->worstaspect);
+  stats->smallestarea *= 0.5;
+  stats->biggestarea *= 0.5;
+  if (stats->smallestangle >= 1.0) {
+    stats->smallestangle = 0.0;
   } else {
-    smallestangle = degconst * acos(sqrt(smallestangle));
+    stats->smallestangle = degconst * acos(sqrt(stats->smallestangle));
   }
-  if (biggestangle >= 1.0) {
-    biggestangle = 180.0;
+  if (stats->biggestangle >= 1.0) {
+    stats->biggestangle = 180.0;
   } else {
     if (acutebiggest) {
-      biggestangle = degconst * acos(sqrt(biggestangle));
+      stats->biggestangle = degconst * acos(sqrt(stats->biggestangle));
     } else {
-      biggestangle = 180.0 - degconst * acos(sqrt(biggestangle));
+      stats->biggestangle = 180.0 - degconst * acos(sqrt(stats->biggestangle));
     }
   }
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  quality_statistics()   Print statistics about the quality of the mesh.   */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifdef ANSI_DECLARATORS
+void quality_statistics(struct mesh *m, struct behavior *b)
+#else /* not ANSI_DECLARATORS */
+void quality_statistics(m, b)
+struct mesh *m;
+struct behavior *b;
+#endif /* not ANSI_DECLARATORS */
+
+{
+  struct qualitystats stats;
+  REAL ratiotable[16];
+  int *angletable;
+  int *aspecttable;
+  REAL shortest, longest;
+  REAL smallestarea, biggestarea;
+  REAL minaltitude;
+  REAL worstaspect;
+  REAL smallestangle, biggestangle;
+  int i;
+
+  printf("Mesh quality statistics:\n\n");
+  computequalitystats(m, b, b->threads, &stats);
+
+  ratiotable[0]  =      1.5;      ratiotable[1]  =     2.0;
+  ratiotable[2]  =      2.5;      ratiotable[3]  =     3.0;
+  ratiotable[4]  =      4.0;      ratiotable[5]  =     6.0;
+  ratiotable[6]  =     10.0;      ratiotable[7]  =    15.0;
+  ratiotable[8]  =     25.0;      ratiotable[9]  =    50.0;
+  ratiotable[10] =    100.0;      ratiotable[11] =   300.0;
+  ratiotable[12] =   1000.0;      ratiotable[13] = 10000.0;
+  ratiotable[14] = 100000.0;      ratiotable[15] =     0.0;
+
+  angletable = stats.angletable;
+  aspecttable = stats.aspecttable;
+  shortest = stats.shortest;
+  longest = stats.longest;
+  smallestarea = stats.smallestarea;
+  biggestarea = stats.biggestarea;
+  minaltitude = stats.minaltitude;
+  worstaspect = stats.worstaspect;
+  smallestangle = stats.smallestangle;
+  biggestangle = stats.biggestangle;
 
   printf("  Smallest area: %16.5g   |  Largest area: %16.5g\n",
          smallestarea, biggestarea);
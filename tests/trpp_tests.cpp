@@ -16,6 +16,10 @@
 #endif
 #include <algorithm>
 #include <set>
+#include <tuple>
+#include <cmath>
+#include <thread>
+#include <atomic>
 
 // debug support
 #define DEBUG_OUTPUT_STDOUT false 
@@ -187,6 +191,137 @@ namespace {
         pslgSegments.push_back(Delaunay::Point(2.4, 1.5));
         pslgSegments.push_back(Delaunay::Point(1.6, 1.5));
     }
+
+
+    // pseudo-random test data, the same sequence on all platforms (unlike std::rand())
+
+    class RandomSequence
+    {
+    public:
+        explicit RandomSequence(unsigned seed) : m_seed(seed) {}
+
+        // in [0, range), in steps of range / steps
+        double next(double range = 100, int steps = 10000)
+        {
+            m_seed = m_seed * 1103515245u + 12345u;
+            return (m_seed >> 8) % steps / (steps / range);
+        }
+
+    private:
+        unsigned m_seed;
+    };
+
+    std::vector<Delaunay::Point> makeRandomPoints(int count, unsigned seed)
+    {
+        std::vector<Delaunay::Point> points;
+        RandomSequence random(seed);
+
+        for (int i = 0; i < count; ++i)
+        {
+            double x = random.next();
+            double y = random.next();
+            points.push_back(Delaunay::Point(x, y));
+        }
+
+        return points;
+    }
+
+    // the corners of the square [0, 100] x [0, 100], then the points inside of it
+    std::vector<Delaunay::Point> makeRandomSquareInput(int count, unsigned seed)
+    {
+        std::vector<Delaunay::Point> points = {
+            Delaunay::Point(0, 0), Delaunay::Point(100, 0), Delaunay::Point(100, 100), Delaunay::Point(0, 100) };
+        RandomSequence random(seed);
+
+        for (int i = 0; i < count; ++i)
+        {
+            double x = 1 + random.next(98, 9800);
+            double y = 1 + random.next(98, 9800);
+            points.push_back(Delaunay::Point(x, y));
+        }
+
+        return points;
+    }
+
+
+    // mesh checks
+
+    // the triangles as sets of their vertex indexes
+    std::set<std::vector<int>> collectTriangles(Delaunay& triGen)
+    {
+        std::set<std::vector<int>> triangles;
+
+        for (const auto& f : triGen.faces())
+        {
+            std::vector<int> tri = { f.Org(), f.Dest(), f.Apex() };
+            std::sort(tri.begin(), tri.end());
+            triangles.insert(tri);
+        }
+
+        return triangles;
+    }
+
+    // the oriented triangles, starting at their smallest vertex index
+    std::vector<std::tuple<int, int, int>> sortedTriangles(Delaunay& triGen)
+    {
+        std::vector<std::tuple<int, int, int>> triangles;
+
+        for (FaceIterator fit = triGen.fbegin(); fit != triGen.fend(); ++fit)
+        {
+            int corners[3] = { fit.Org(), fit.Dest(), fit.Apex() };
+            std::rotate(corners, std::min_element(corners, corners + 3), corners + 3);
+            triangles.push_back(std::make_tuple(corners[0], corners[1], corners[2]));
+        }
+
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    double minMeshAngle(Delaunay& triGen)
+    {
+        double minAngle = 180;
+
+        for (const auto& f : triGen.faces())
+        {
+            Delaunay::Point p[3];
+            f.Org(&p[0]);
+            f.Dest(&p[1]);
+            f.Apex(&p[2]);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                const auto& a = p[i];
+                const auto& b = p[(i + 1) % 3];
+                const auto& c = p[(i + 2) % 3];
+
+                double ux = b[0] - a[0], uy = b[1] - a[1];
+                double vx = c[0] - a[0], vy = c[1] - a[1];
+                double angle = std::atan2(std::abs(ux * vy - uy * vx), ux * vx + uy * vy) * 180 / 3.14159265358979;
+
+                minAngle = std::min(minAngle, angle);
+            }
+        }
+
+        return minAngle;
+    }
+
+    // no degenerate triangles, none larger than maxArea (if > 0), and together they cover the given area
+    void checkMeshCoversArea(Delaunay& triGen, double area, double maxArea = 0)
+    {
+        double totalArea = 0;
+
+        for (const auto& f : triGen.faces())
+        {
+            REQUIRE(f.area() > 0);
+            if (maxArea > 0)
+            {
+                REQUIRE(f.area() <= maxArea * (1 + 1e-9));
+            }
+            totalArea += f.area();
+        }
+
+        REQUIRE(std::abs(totalArea - area) < 1e-6);
+    }
 }
 
 
@@ -1585,6 +1720,2977 @@ TEST_CASE("Different triangulation algorithms", "[trpp]")
 }
 
 
+TEST_CASE("Vertex ordering in the memory pool", "[trpp]")
+{
+   // pseudo-random points, no cocircular quadruples
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(500, 12345);
+
+   Delaunay triGen(delaunayInput);
+   triGen.Triangulate();
+   auto reference = collectTriangles(triGen);
+
+   SECTION("TEST 14.1: lexicographic and Hilbert order yield the same triangulation")
+   {
+      for (auto order : { Lexicographic, Hilbert })
+      {
+         for (auto alg : { DivideConquer, Incremental, Sweepline })
+         {
+            Delaunay orderedGen(delaunayInput);
+            orderedGen.setVertexOrdering(order);
+            orderedGen.setAlgorithm(alg);
+            orderedGen.Triangulate();
+
+            REQUIRE(orderedGen.triangleCount() == triGen.triangleCount());
+            REQUIRE(collectTriangles(orderedGen) == reference);
+         }
+      }
+   }
+
+   SECTION("TEST 14.2: vertex indexes refer to the input points")
+   {
+      Delaunay orderedGen(delaunayInput);
+      orderedGen.setVertexOrdering(Hilbert);
+      orderedGen.Triangulate(true);
+
+      int steinerCt = 0;
+
+      for (const auto& f : orderedGen.faces())
+      {
+         Delaunay::Point pt;
+         int idx = f.Org(&pt);
+
+         if (idx < 0)
+         {
+            ++steinerCt;
+            continue;
+         }
+
+         REQUIRE(pt[0] == delaunayInput[idx][0]);
+         REQUIRE(pt[1] == delaunayInput[idx][1]);
+      }
+
+      REQUIRE(orderedGen.verticeCount() > (int)delaunayInput.size());
+      REQUIRE(steinerCt > 0);
+   }
+
+   SECTION("TEST 14.3: segments connect the input points with a spatial ordering")
+   {
+      // horizontal, non-crossing segments across the point cloud
+      std::vector<Delaunay::Point> segmentInput = delaunayInput;
+      std::vector<int> segments;
+
+      for (int i = 0; i < 10; ++i)
+      {
+         double y = 5.005 + 10 * i;
+         segments.push_back((int)segmentInput.size());
+         segmentInput.push_back(Delaunay::Point(0.505, y));
+         segments.push_back((int)segmentInput.size());
+         segmentInput.push_back(Delaunay::Point(99.505, y));
+      }
+
+      Delaunay cdtGen(segmentInput);
+      cdtGen.setSegmentConstraint(segments);
+      cdtGen.useConvexHullWithSegments(true);
+      cdtGen.Triangulate();
+      auto cdtReference = collectTriangles(cdtGen);
+
+      for (auto order : { Lexicographic, Hilbert })
+      {
+         Delaunay orderedGen(segmentInput);
+         orderedGen.setSegmentConstraint(segments);
+         orderedGen.useConvexHullWithSegments(true);
+         orderedGen.setVertexOrdering(order);
+         orderedGen.Triangulate();
+
+         std::set<std::pair<int, int>> edges;
+         for (const auto& f : orderedGen.faces())
+         {
+            int corners[3] = { f.Org(), f.Dest(), f.Apex() };
+            for (int i = 0; i < 3; ++i)
+            {
+               int a = corners[i], b = corners[(i + 1) % 3];
+               edges.insert({ std::min(a, b), std::max(a, b) });
+            }
+         }
+
+         for (size_t i = 0; i < segments.size(); i += 2)
+         {
+            REQUIRE(edges.count({ segments[i], segments[i + 1] }) == 1);
+         }
+
+         REQUIRE(collectTriangles(orderedGen) == cdtReference);
+      }
+   }
+}
+
+
+TEST_CASE("User-defined triangle test", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput;
+
+   delaunayInput.push_back(Delaunay::Point(0, 0));
+   delaunayInput.push_back(Delaunay::Point(10, 0));
+   delaunayInput.push_back(Delaunay::Point(10, 10));
+   delaunayInput.push_back(Delaunay::Point(0, 10));
+   delaunayInput.push_back(Delaunay::Point(4, 6));
+
+   // refine near a feature point
+   const Delaunay::Point feature(2, 2);
+
+   auto tooBigNearFeature = [feature](const Delaunay::Point& org, const Delaunay::Point& dest,
+                                      const Delaunay::Point& apex, double area)
+   {
+      double cx = (org[0] + dest[0] + apex[0]) / 3;
+      double cy = (org[1] + dest[1] + apex[1]) / 3;
+      double dist2 = (cx - feature[0]) * (cx - feature[0]) + (cy - feature[1]) * (cy - feature[1]);
+
+      return dist2 < 16 && area > 0.2;
+   };
+
+   auto checkTriangles = [&](Delaunay& triGen)
+   {
+      for (const auto& f : triGen.faces())
+      {
+         Delaunay::Point p0, p1, p2;
+         f.Org(&p0);
+         f.Dest(&p1);
+         f.Apex(&p2);
+
+         REQUIRE_FALSE(tooBigNearFeature(p0, p1, p2, f.area()));
+      }
+   };
+
+   Delaunay triGen(delaunayInput);
+   triGen.Triangulate(true);
+   int referenceCt = triGen.triangleCount();
+
+   SECTION("TEST 16.1: function object")
+   {
+      int callCt = 0;
+      triGen.setUserConstraint([&](const Delaunay::Point& org, const Delaunay::Point& dest, 
+                                   const Delaunay::Point& apex, double area) 
+                               { 
+                                  ++callCt;
+                                  return tooBigNearFeature(org, dest, apex, area); 
+                               });
+      triGen.Triangulate(true);
+
+      REQUIRE(callCt > 0);
+      REQUIRE(triGen.triangleCount() > referenceCt);
+      checkTriangles(triGen);
+
+      // not used without quality constraints
+      callCt = 0;
+      triGen.Triangulate(false);
+
+      REQUIRE(callCt == 0);
+
+      // ... and removed
+      triGen.removeUserConstraint();
+      triGen.Triangulate(true);
+
+      REQUIRE(callCt == 0);
+      REQUIRE(triGen.triangleCount() == referenceCt);
+   }
+
+   SECTION("TEST 16.2: std::function and function object give the same result")
+   {
+      triGen.setUserConstraint(tooBigNearFeature);
+      triGen.Triangulate(true);
+      int functorCt = triGen.triangleCount();
+
+      std::function<bool(const Delaunay::Point&, const Delaunay::Point&, const Delaunay::Point&, double)> test = tooBigNearFeature;
+      triGen.setUserConstraint(test);
+      triGen.Triangulate(true);
+
+      REQUIRE(triGen.triangleCount() == functorCt);
+      checkTriangles(triGen);
+   }
+}
+
+
+TEST_CASE("Sizing field", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput;
+
+   delaunayInput.push_back(Delaunay::Point(0, 0));
+   delaunayInput.push_back(Delaunay::Point(10, 0));
+   delaunayInput.push_back(Delaunay::Point(10, 10));
+   delaunayInput.push_back(Delaunay::Point(0, 10));
+
+   const double sqrt3by4 = 0.4330127018922193;
+
+   auto countTriangles = [](Delaunay& triGen, double maxCentroidX)
+   {
+      int count = 0;
+
+      for (const auto& f : triGen.faces())
+      {
+         Delaunay::Point p0, p1, p2;
+         f.Org(&p0);
+         f.Dest(&p1);
+         f.Apex(&p2);
+
+         if ((p0[0] + p1[0] + p2[0]) / 3 < maxCentroidX)
+            ++count;
+      }
+
+      return count;
+   };
+
+   Delaunay triGen(delaunayInput);
+
+   SECTION("TEST 17.1: sizing field on a regular grid")
+   {
+      // fine on the left side, coarse on the right
+      Delaunay::SizingField field;
+      field.cellSize = 1;
+      field.columns = 11;
+      field.rows = 11;
+
+      for (int row = 0; row < field.rows; ++row)
+         for (int col = 0; col < field.columns; ++col)
+            field.edgeLengths.push_back(col <= 5 ? 0.25 : 2.0);
+
+      REQUIRE(triGen.setSizingField(field));
+      triGen.Triangulate(true);
+
+      for (const auto& f : triGen.faces())
+      {
+         Delaunay::Point p0, p1, p2;
+         f.Org(&p0);
+         f.Dest(&p1);
+         f.Apex(&p2);
+
+         if ((p0[0] + p1[0] + p2[0]) / 3 < 5)
+         {
+            REQUIRE(f.area() <= sqrt3by4 * 0.25 * 0.25);
+         }
+      }
+
+      int leftCt = countTriangles(triGen, 5);
+      REQUIRE(leftCt > 4 * (triGen.triangleCount() - leftCt));
+
+      // not used without quality constraints
+      triGen.Triangulate(false);
+      REQUIRE(triGen.triangleCount() == 2);
+
+      triGen.removeSizingField();
+      triGen.Triangulate(true);
+      REQUIRE(triGen.triangleCount() == 2);
+   }
+
+   SECTION("TEST 17.2: sizing field from a background triangulation")
+   {
+      std::vector<Delaunay::Point> background = delaunayInput;
+      std::vector<double> edgeLengths = { 0.2, 3, 3, 3 };
+
+      REQUIRE(triGen.setSizingField(background, edgeLengths, 0.5));
+      triGen.Triangulate(true);
+
+      // refined near the origin
+      int nearOriginCt = 0;
+      for (const auto& f : triGen.faces())
+      {
+         Delaunay::Point p0;
+         f.Org(&p0);
+
+         if (p0[0] + p0[1] < 2)
+            ++nearOriginCt;
+      }
+
+      REQUIRE(nearOriginCt > 10);
+      REQUIRE(triGen.triangleCount() > 30);
+   }
+
+   SECTION("TEST 17.3: invalid sizing fields")
+   {
+      Delaunay::SizingField field;
+      field.cellSize = 1;
+      field.columns = 2;
+      field.rows = 2;
+      field.edgeLengths = { 1, 1, 1 };
+
+      REQUIRE_FALSE(triGen.setSizingField(field));
+
+      field.edgeLengths = { 1, 1, 1, 0 };
+      REQUIRE_FALSE(triGen.setSizingField(field));
+
+      REQUIRE_FALSE(triGen.setSizingField(delaunayInput, { 1, 1 }, 0.5));
+   }
+
+   SECTION("TEST 17.4: grid nodes outside of the background triangulation")
+   {
+      // the upper right half of the square isn't covered by the background triangle
+      std::vector<Delaunay::Point> background = { delaunayInput[0], delaunayInput[1], delaunayInput[3] };
+      std::vector<double> edgeLengths = { 1, 1, 1 };
+
+      for (double cellSize : { 0.5, 20.0 })
+      {
+         REQUIRE(triGen.setSizingField(background, edgeLengths, cellSize));
+         triGen.Triangulate(true);
+
+         for (const auto& f : triGen.faces())
+         {
+            REQUIRE(f.area() <= sqrt3by4 * 1.0001);
+         }
+      }
+   }
+}
+
+
+TEST_CASE("Refinement budget", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomSquareInput(300, 815);
+
+   const int inputCt = (int)delaunayInput.size();
+
+   auto checkValidMesh = [](Delaunay& triGen)
+   {
+      for (const auto& f : triGen.faces())
+      {
+         REQUIRE(f.area() > 0);
+      }
+   };
+
+   Delaunay triGen(delaunayInput);
+   triGen.setMinAngle(30);
+   triGen.Triangulate(true);
+
+   REQUIRE(triGen.refinementCompleted());
+   const int fullVerticeCt = triGen.verticeCount();
+
+   SECTION("TEST 18.1: limit the Steiner points")
+   {
+      Delaunay::RefinementBudget budget;
+      budget.maxSteinerPoints = 20;
+
+      triGen.setRefinementBudget(budget);
+      triGen.Triangulate(true);
+
+      REQUIRE(triGen.verticeCount() <= inputCt + 20);
+      REQUIRE_FALSE(triGen.refinementCompleted());
+      checkValidMesh(triGen);
+
+      triGen.removeRefinementBudget();
+      triGen.Triangulate(true);
+
+      REQUIRE(triGen.verticeCount() == fullVerticeCt);
+      REQUIRE(triGen.refinementCompleted());
+   }
+
+   SECTION("TEST 18.2: progress callback and cancellation")
+   {
+      int callCt = 0;
+      int lastSteinerCt = 0;
+
+      Delaunay::RefinementBudget budget;
+      budget.progressInterval = 10;
+      budget.progress = [&](int steinerPoints, int badTriangles) 
+      {
+         REQUIRE(steinerPoints >= lastSteinerCt);
+         REQUIRE(badTriangles > 0);
+         lastSteinerCt = steinerPoints;
+
+         return ++callCt < 3;
+      };
+
+      triGen.setRefinementBudget(budget);
+      triGen.Triangulate(true);
+
+      REQUIRE(callCt == 3);
+      REQUIRE(lastSteinerCt >= 20);
+      REQUIRE(triGen.verticeCount() < fullVerticeCt);
+      REQUIRE_FALSE(triGen.refinementCompleted());
+      checkValidMesh(triGen);
+   }
+
+   SECTION("TEST 18.3: time limit")
+   {
+      Delaunay::RefinementBudget budget;
+      budget.maxSeconds = 1e-9;
+
+      triGen.setRefinementBudget(budget);
+      triGen.Triangulate(true);
+
+      REQUIRE(triGen.verticeCount() < fullVerticeCt);
+      REQUIRE_FALSE(triGen.refinementCompleted());
+      checkValidMesh(triGen);
+   }
+
+   SECTION("TEST 18.4: worst triangles first, the quality guarantees still hold")
+   {
+      Delaunay::RefinementBudget budget;
+      budget.worstFirst = true;
+
+      triGen.setRefinementBudget(budget);
+      triGen.Triangulate(true);
+
+      REQUIRE(triGen.refinementCompleted());
+      REQUIRE(minMeshAngle(triGen) >= 30 - 1e-6);
+   }
+
+   SECTION("TEST 18.5: no worst-first order after the budget was removed")
+   {
+      auto meshPoints = [](Delaunay& gen)
+      {
+         std::vector<std::pair<double, double>> points;
+         for (VertexIterator vit = gen.vbegin(); vit != gen.vend(); ++vit)
+         {
+            points.push_back({ vit.x(), vit.y() });
+         }
+         return points;
+      };
+
+      Delaunay::RefinementBudget budget;
+      budget.worstFirst = true;
+
+      Delaunay removedGen(delaunayInput);
+      removedGen.setRefinementBudget(budget);
+      removedGen.Triangulate(true);
+      removedGen.removeRefinementBudget();
+      removedGen.refine(30, 20);
+
+      // the same, but refined in the default order within a budget
+      Delaunay fifoGen(delaunayInput);
+      fifoGen.setRefinementBudget(budget);
+      fifoGen.Triangulate(true);
+      budget.worstFirst = false;
+      fifoGen.setRefinementBudget(budget);
+      fifoGen.refine(30, 20);
+
+      REQUIRE(removedGen.verticeCount() == fifoGen.verticeCount());
+      REQUIRE(meshPoints(removedGen) == meshPoints(fifoGen));
+   }
+}
+
+
+TEST_CASE("Progressive refinement", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomSquareInput(200, 4711);
+
+   auto checkMesh = [&delaunayInput](Delaunay& triGen, double maxArea)
+   {
+      checkMeshCoversArea(triGen, 100 * 100, maxArea);
+
+      for (const auto& f : triGen.faces())
+      {
+         Delaunay::Point p;
+         int idx = f.Org(&p);
+         if (idx >= 0)
+         {
+            REQUIRE(p == delaunayInput[idx]);
+         }
+      }
+   };
+
+   SECTION("TEST 19.1: coarse to fine chain")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.setQualityConstraints(20, 400);
+      triGen.Triangulate(true);
+
+      int lastTriangleCt = triGen.triangleCount();
+      checkMesh(triGen, 400);
+
+      for (float area : { 100.0f, 25.0f, 5.0f })
+      {
+         triGen.refine(25, area);
+
+         REQUIRE(triGen.refinementCompleted());
+         REQUIRE(triGen.triangleCount() > lastTriangleCt);
+         REQUIRE(triGen.edgeCount() > 0);
+         checkMesh(triGen, area);
+
+         lastTriangleCt = triGen.triangleCount();
+      }
+
+      // a fresh triangulation of the finest level isn't much smaller
+      Delaunay freshGen(delaunayInput);
+      freshGen.setQualityConstraints(25, 5);
+      freshGen.Triangulate(true);
+
+      REQUIRE(lastTriangleCt < 2 * freshGen.triangleCount());
+
+      // looser constraints don't change anything
+      triGen.refine(20, 400);
+      REQUIRE(triGen.triangleCount() == lastTriangleCt);
+   }
+
+   SECTION("TEST 19.2: refine a plain Delaunay triangulation")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.Triangulate();
+
+      REQUIRE(triGen.verticeCount() == (int)delaunayInput.size());
+
+      triGen.refine(30, 10);
+
+      REQUIRE(triGen.refinementCompleted());
+      REQUIRE(triGen.verticeCount() > (int)delaunayInput.size());
+      checkMesh(triGen, 10);
+   }
+
+   SECTION("TEST 19.3: refine with spatially ordered vertices")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.setVertexOrdering(Hilbert);
+      triGen.setQualityConstraints(20, 100);
+      triGen.Triangulate(true);
+
+      triGen.refine(30, 10);
+
+      REQUIRE(triGen.refinementCompleted());
+      checkMesh(triGen, 10);
+   }
+}
+
+
+TEST_CASE("Cached base triangulation", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput;
+   RandomSequence random(1234);
+
+   delaunayInput.push_back(Delaunay::Point(0, 0));
+   delaunayInput.push_back(Delaunay::Point(100, 0));
+   delaunayInput.push_back(Delaunay::Point(100, 100));
+   delaunayInput.push_back(Delaunay::Point(0, 100));
+   delaunayInput.push_back(Delaunay::Point(40, 40));
+   delaunayInput.push_back(Delaunay::Point(60, 40));
+   delaunayInput.push_back(Delaunay::Point(60, 60));
+   delaunayInput.push_back(Delaunay::Point(40, 60));
+
+   for (int i = 0; i < 300; ++i)
+   {
+      double x = 1 + random.next(98, 9800);
+      double y = 1 + random.next(98, 9800);
+
+      if (x > 38 && x < 62 && y > 38 && y < 62)
+      {
+         continue;
+      }
+
+      delaunayInput.push_back(Delaunay::Point(x, y));
+   }
+
+   delaunayInput.push_back(delaunayInput[10]); // a duplicate
+
+   std::vector<Delaunay::Point> segments = {
+      delaunayInput[0], delaunayInput[1], delaunayInput[1], delaunayInput[2], 
+      delaunayInput[2], delaunayInput[3], delaunayInput[3], delaunayInput[0], 
+      delaunayInput[4], delaunayInput[5], delaunayInput[5], delaunayInput[6], 
+      delaunayInput[6], delaunayInput[7], delaunayInput[7], delaunayInput[4] };
+
+   std::vector<Delaunay::Point> holes = { Delaunay::Point(50, 50) };
+
+   auto checkSameAsUncached = [&](Delaunay& triGen, bool quality, bool constrained, 
+                                  AlgorithmType alg = DivideConquer, VertexOrdering order = InputOrder)
+   {
+      // note: the inner square's corners are cocircular, thus use the same algorithm and order!
+      Delaunay uncachedGen(delaunayInput);
+      uncachedGen.enableBaseTriangulationCache(false);
+      uncachedGen.setAlgorithm(alg);
+      uncachedGen.setVertexOrdering(order);
+      uncachedGen.setQualityConstraints(30, 20);
+
+      if (constrained)
+      {
+         uncachedGen.setSegmentConstraint(segments);
+         uncachedGen.setHolesConstraint(holes);
+      }
+
+      uncachedGen.Triangulate(quality);
+
+      REQUIRE(triGen.verticeCount() == uncachedGen.verticeCount());
+      REQUIRE(triGen.triangleCount() == uncachedGen.triangleCount());
+      REQUIRE(triGen.edgeCount() == uncachedGen.edgeCount());
+      REQUIRE(triGen.hullSize() == uncachedGen.hullSize());
+
+      if (!quality)
+      {
+         // no Steiner points, thus the same triangles
+         REQUIRE(sortedTriangles(triGen) == sortedTriangles(uncachedGen));
+      }
+   };
+
+   Delaunay triGen(delaunayInput);
+   triGen.enableBaseTriangulationCache(true);
+   triGen.setQualityConstraints(30, 20);
+   triGen.Triangulate();
+
+   checkSameAsUncached(triGen, false, false);
+
+   SECTION("TEST 20.1: switch constraints on and off")
+   {
+      triGen.setSegmentConstraint(segments);
+      triGen.setHolesConstraint(holes);
+      triGen.Triangulate();
+      checkSameAsUncached(triGen, false, true);
+
+      triGen.Triangulate(true);
+      REQUIRE(triGen.refinementCompleted());
+      for (const auto& f : triGen.faces())
+      {
+         REQUIRE(f.area() > 0);
+         REQUIRE(f.area() <= 20 * (1 + 1e-9));
+      }
+
+      triGen.setHolesConstraint(std::vector<Delaunay::Point>());
+      triGen.setSegmentConstraint(std::vector<Delaunay::Point>());
+      triGen.Triangulate();
+      checkSameAsUncached(triGen, false, false);
+   }
+
+   SECTION("TEST 20.2: changed points, algorithm and ordering")
+   {
+      triGen.setAlgorithm(Incremental);
+      triGen.Triangulate();
+      checkSameAsUncached(triGen, false, false, Incremental);
+
+      triGen.setVertexOrdering(Hilbert);
+      triGen.Triangulate();
+      triGen.Triangulate();
+      checkSameAsUncached(triGen, false, false, Incremental, Hilbert);
+
+      triGen.enableBaseTriangulationCache(false);
+      triGen.Triangulate();
+      checkSameAsUncached(triGen, false, false, Incremental, Hilbert);
+   }
+}
+
+
+TEST_CASE("Mesh smoothing", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomSquareInput(100, 2024);
+
+   auto meanBin = [](const std::vector<int>& histogram)
+   {
+      double sum = 0, count = 0;
+      for (size_t i = 0; i < histogram.size(); ++i)
+      {
+         sum += i * histogram[i];
+         count += histogram[i];
+      }
+      return sum / count;
+   };
+
+   auto checkSmoothedMesh = [&](Delaunay& triGen, const Delaunay::SmoothingResult& result, double minAngleBefore)
+   {
+      REQUIRE(result.minAngleHistogramBefore.size() == 12);
+      REQUIRE(result.minAngleHistogramAfter.size() == 12);
+      REQUIRE(result.movedVertices > 0);
+
+      int countAfter = 0;
+      for (int ct : result.minAngleHistogramAfter)
+      {
+         countAfter += ct;
+      }
+      REQUIRE(countAfter == triGen.triangleCount());
+      REQUIRE(meanBin(result.minAngleHistogramAfter) >= meanBin(result.minAngleHistogramBefore));
+
+      REQUIRE(minMeshAngle(triGen) >= minAngleBefore - 1e-6);
+
+      checkMeshCoversArea(triGen, 100 * 100, 10);
+
+      // the input vertices stay in place
+      for (tpp::VertexIterator it = triGen.vbegin(); it != triGen.vend(); ++it)
+      {
+         int idx = it.vertexId();
+
+         if (idx >= 0 && idx < (int)delaunayInput.size())
+         {
+            REQUIRE(*it == delaunayInput[idx]);
+         }
+      }
+   };
+
+   Delaunay triGen(delaunayInput);
+   triGen.setQualityConstraints(25, 10);
+   triGen.Triangulate(true);
+
+   const double minAngleBefore = minMeshAngle(triGen);
+   const int triangleCt = triGen.triangleCount();
+
+   REQUIRE(minAngleBefore >= 25 - 1e-6);
+
+   SECTION("TEST 21.1: ODT smoothing")
+   {
+      auto result = triGen.smooth(3, OptimalDelaunay);
+
+      int countBefore = 0;
+      for (int ct : result.minAngleHistogramBefore)
+      {
+         countBefore += ct;
+      }
+      REQUIRE(countBefore == triangleCt);
+
+      checkSmoothedMesh(triGen, result, minAngleBefore);
+   }
+
+   SECTION("TEST 21.2: Laplacian smoothing on several threads")
+   {
+      triGen.setThreadCount(4);
+      auto result = triGen.smooth(3, Laplacian);
+
+      checkSmoothedMesh(triGen, result, minAngleBefore);
+   }
+
+   SECTION("TEST 21.3: the smoothed mesh is Delaunay again")
+   {
+      // no area constraints, thus no flip is refused
+      Delaunay angleGen(delaunayInput);
+      angleGen.setMinAngle(25);
+      angleGen.Triangulate(true);
+
+      for (auto method : { OptimalDelaunay, Laplacian })
+      {
+         auto result = angleGen.smooth(2, method);
+         REQUIRE(result.movedVertices > 0);
+
+         std::vector<Delaunay::Point> vertices;
+         for (VertexIterator vit = angleGen.vbegin(); vit != angleGen.vend(); ++vit)
+         {
+            vertices.push_back(*vit);
+         }
+
+         // empty circumcircles
+         int violations = 0;
+         for (const auto& f : angleGen.faces())
+         {
+            Delaunay::Point a, b, c;
+            f.Org(&a);
+            f.Dest(&b);
+            f.Apex(&c);
+
+            for (const auto& d : vertices)
+            {
+               double adx = a[0] - d[0], ady = a[1] - d[1];
+               double bdx = b[0] - d[0], bdy = b[1] - d[1];
+               double cdx = c[0] - d[0], cdy = c[1] - d[1];
+               double det = (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) -
+                            (bdx * bdx + bdy * bdy) * (adx * cdy - cdx * ady) +
+                            (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+
+               violations += det > 1e-6 ? 1 : 0;
+            }
+         }
+
+         REQUIRE(violations == 0);
+      }
+   }
+}
+
+
+TEST_CASE("Quality statistics", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomSquareInput(200, 31337);
+
+   Delaunay triGen(delaunayInput);
+
+   REQUIRE(triGen.qualityStats().triangleCount == 0);
+
+   SECTION("TEST 22.1: same values as computed from the faces")
+   {
+      triGen.Triangulate();
+      auto stats = triGen.qualityStats();
+
+      double minAngle = 180, maxAngle = 0;
+      double minArea = 1e10, maxArea = 0;
+      double shortest = 1e10, longest = 0;
+
+      for (const auto& f : triGen.faces())
+      {
+         Delaunay::Point p[3];
+         f.Org(&p[0]);
+         f.Dest(&p[1]);
+         f.Apex(&p[2]);
+
+         for (int i = 0; i < 3; ++i)
+         {
+            const auto& a = p[i];
+            const auto& b = p[(i + 1) % 3];
+            const auto& c = p[(i + 2) % 3];
+
+            double ux = b[0] - a[0], uy = b[1] - a[1];
+            double vx = c[0] - a[0], vy = c[1] - a[1];
+            double angle = std::atan2(std::abs(ux * vy - uy * vx), ux * vx + uy * vy) * 180 / 3.14159265358979;
+
+            minAngle = std::min(minAngle, angle);
+            maxAngle = std::max(maxAngle, angle);
+            shortest = std::min(shortest, std::sqrt(ux * ux + uy * uy));
+            longest = std::max(longest, std::sqrt(ux * ux + uy * uy));
+         }
+
+         minArea = std::min(minArea, f.area());
+         maxArea = std::max(maxArea, f.area());
+      }
+
+      REQUIRE(stats.triangleCount == triGen.triangleCount());
+      REQUIRE(std::abs(stats.minAngle - minAngle) < 1e-6);
+      REQUIRE(std::abs(stats.maxAngle - maxAngle) < 1e-6);
+      REQUIRE(std::abs(stats.minArea - minArea) < 1e-9);
+      REQUIRE(std::abs(stats.maxArea - maxArea) < 1e-9);
+      REQUIRE(std::abs(stats.shortestEdge - shortest) < 1e-9);
+      REQUIRE(std::abs(stats.longestEdge - longest) < 1e-9);
+      REQUIRE(stats.maxAspectRatio >= 2 / std::sqrt(3.0) - 1e-9);
+
+      REQUIRE(stats.angleHistogram.size() == 18);
+      REQUIRE(stats.aspectRatioHistogram.size() == stats.aspectRatioBounds.size() + 1);
+
+      int angleCt = 0, aspectCt = 0;
+      for (int ct : stats.angleHistogram) angleCt += ct;
+      for (int ct : stats.aspectRatioHistogram) aspectCt += ct;
+
+      REQUIRE(angleCt == 3 * stats.triangleCount);
+      REQUIRE(aspectCt == stats.triangleCount);
+
+      // not a quality triangulation
+      REQUIRE(stats.smallAngleCount == 0);
+      REQUIRE(stats.largeAreaCount == 0);
+
+      // multi-threaded
+      triGen.setThreadCount(4);
+      auto statsMt = triGen.qualityStats();
+
+      REQUIRE(statsMt.minAngle == stats.minAngle);
+      REQUIRE(statsMt.maxAngle == stats.maxAngle);
+      REQUIRE(statsMt.angleHistogram == stats.angleHistogram);
+      REQUIRE(statsMt.aspectRatioHistogram == stats.aspectRatioHistogram);
+      REQUIRE(statsMt.maxAspectRatio == stats.maxAspectRatio);
+   }
+
+   SECTION("TEST 22.2: violated constraints")
+   {
+      triGen.setQualityConstraints(30, 5);
+      triGen.Triangulate(true);
+
+      auto stats = triGen.qualityStats();
+
+      REQUIRE(stats.minAngle >= 30 - 1e-6);
+      REQUIRE(stats.maxArea <= 5 * (1 + 1e-9));
+      REQUIRE(stats.smallAngleCount == 0);
+      REQUIRE(stats.largeAreaCount == 0);
+
+      Delaunay::RefinementBudget budget;
+      budget.maxSteinerPoints = 50;
+      triGen.setRefinementBudget(budget);
+      triGen.Triangulate(true);
+
+      stats = triGen.qualityStats();
+
+      REQUIRE_FALSE(triGen.refinementCompleted());
+      REQUIRE(stats.smallAngleCount + stats.largeAreaCount > 0);
+      REQUIRE(stats.largeAreaCount > 0);
+   }
+}
+
+
+TEST_CASE("Batch segment insertion", "[trpp]")
+{
+   // pseudo-random points, connected by monotone polylines in 10 horizontal bands
+   std::vector<Delaunay::Point> delaunayInput = { 
+      Delaunay::Point(-1, -1), Delaunay::Point(101, -1), Delaunay::Point(101, 101), Delaunay::Point(-1, 101) };
+   RandomSequence random(4321);
+
+   for (int i = 0; i < 600; ++i)
+   {
+      double x = random.next();
+      double y = random.next();
+
+      delaunayInput.push_back(Delaunay::Point(x, y));
+   }
+
+   std::vector<std::vector<int>> bands(10);
+   for (int i = 4; i < (int)delaunayInput.size(); ++i)
+   {
+      bands[(int)(delaunayInput[i][1] / 10)].push_back(i);
+   }
+
+   std::vector<int> segments;
+   for (auto& band : bands)
+   {
+      std::sort(band.begin(), band.end(), 
+                [&](int lhs, int rhs) { return delaunayInput[lhs][0] < delaunayInput[rhs][0]; });
+
+      for (size_t i = 1; i < band.size(); ++i)
+      {
+         segments.push_back(band[i - 1]);
+         segments.push_back(band[i]);
+      }
+   }
+
+   // scatter the segments
+   std::vector<int> scattered;
+   size_t segmentCount = segments.size() / 2;
+   for (size_t i = 0; i < segmentCount; ++i)
+   {
+      size_t j = (i * 7919) % segmentCount;
+      scattered.push_back(segments[2 * j]);
+      scattered.push_back(segments[2 * j + 1]);
+   }
+   REQUIRE(segmentCount == 590);
+
+   auto hasAllSegments = [&](Delaunay& triGen)
+   {
+      std::set<std::pair<int, int>> edges;
+
+      for (const auto& f : triGen.faces())
+      {
+         int v[3] = { f.Org(), f.Dest(), f.Apex() };
+
+         for (int k = 0; k < 3; ++k)
+         {
+            edges.insert(std::make_pair(std::min(v[k], v[(k + 1) % 3]), std::max(v[k], v[(k + 1) % 3])));
+         }
+      }
+
+      for (size_t i = 0; i < segmentCount; ++i)
+      {
+         auto edge = std::make_pair(std::min(segments[2 * i], segments[2 * i + 1]), 
+                                    std::max(segments[2 * i], segments[2 * i + 1]));
+         if (edges.count(edge) == 0)
+         {
+            return false;
+         }
+      }
+
+      return true;
+   };
+
+   Delaunay triGen(delaunayInput);
+   triGen.setSegmentConstraint(scattered);
+   triGen.useConvexHullWithSegments(true);
+   triGen.Triangulate();
+
+   auto reference = collectTriangles(triGen);
+   REQUIRE(hasAllSegments(triGen));
+
+   SECTION("TEST 23.1: batch insertion yields the same constrained triangulation")
+   {
+      for (auto alg : { DivideConquer, Incremental })
+      {
+         Delaunay batchGen(delaunayInput);
+         batchGen.setSegmentConstraint(scattered);
+         batchGen.useConvexHullWithSegments(true);
+         batchGen.enableSegmentBatchInsertion(true);
+         batchGen.setAlgorithm(alg);
+         batchGen.Triangulate();
+
+         REQUIRE(batchGen.triangleCount() == triGen.triangleCount());
+         REQUIRE(collectTriangles(batchGen) == reference);
+      }
+   }
+
+   SECTION("TEST 23.2: segments connect the input points with spatial vertex ordering")
+   {
+      for (bool batch : { false, true })
+      {
+         Delaunay orderedGen(delaunayInput);
+         orderedGen.setSegmentConstraint(scattered);
+         orderedGen.useConvexHullWithSegments(true);
+         orderedGen.enableSegmentBatchInsertion(batch);
+         orderedGen.setVertexOrdering(Hilbert);
+         orderedGen.Triangulate();
+
+         REQUIRE(hasAllSegments(orderedGen));
+         REQUIRE(collectTriangles(orderedGen) == reference);
+      }
+   }
+
+   SECTION("TEST 23.3: segment recovery with several threads")
+   {
+      for (int threads : { 2, 3, 0 })
+      {
+         for (bool batch : { false, true })
+         {
+            Delaunay parallelGen(delaunayInput);
+            parallelGen.setSegmentConstraint(scattered);
+            parallelGen.useConvexHullWithSegments(true);
+            parallelGen.enableSegmentBatchInsertion(batch);
+            parallelGen.setThreadCount(threads);
+            parallelGen.Triangulate();
+
+            REQUIRE(hasAllSegments(parallelGen));
+            REQUIRE(collectTriangles(parallelGen) == reference);
+         }
+      }
+   }
+}
+
+
+TEST_CASE("Segment intersections", "[trpp]")
+{
+   auto hasSegment = [](Delaunay& triGen, int from, int to)
+   {
+      for (const auto& f : triGen.faces())
+      {
+         int v[3] = { f.Org(), f.Dest(), f.Apex() };
+
+         for (int k = 0; k < 3; ++k)
+         {
+            if ((v[k] == from && v[(k + 1) % 3] == to) || (v[k] == to && v[(k + 1) % 3] == from))
+            {
+               return true;
+            }
+         }
+      }
+
+      return false;
+   };
+
+   SECTION("TEST 24.1: crossing segments are split up front")
+   {
+      // 5 horizontal and 5 vertical segments
+      std::vector<Delaunay::Point> delaunayInput;
+      std::vector<int> segments;
+
+      for (int i = 0; i < 5; ++i)
+      {
+         double pos = 10 + 20 * i;
+
+         delaunayInput.push_back(Delaunay::Point(0, pos));
+         delaunayInput.push_back(Delaunay::Point(100, pos));
+         delaunayInput.push_back(Delaunay::Point(pos, 0));
+         delaunayInput.push_back(Delaunay::Point(pos, 100));
+      }
+
+      for (int i = 0; i < 20; ++i)
+      {
+         segments.push_back(i);
+      }
+
+      Delaunay triGen(delaunayInput);
+      triGen.setSegmentConstraint(segments);
+      triGen.useConvexHullWithSegments(true);
+
+      auto report = triGen.resolveSegmentIntersections();
+
+      REQUIRE(report.crossingCount == 25);
+      REQUIRE(report.touchingCount == 0);
+      REQUIRE(report.splitSegmentCount == 10);
+      REQUIRE(report.removedSegmentCount == 0);
+      REQUIRE(report.addedPoints.size() == 25);
+      REQUIRE(report.addedPoints.front() == 20);
+      REQUIRE(report.addedPoints.back() == 44);
+
+      for (int idx : report.addedPoints)
+      {
+         Delaunay::Point pt = triGen.pointAtVertexId(idx);
+
+         REQUIRE(std::fmod(pt[0] - 10, 20) == 0);
+         REQUIRE(std::fmod(pt[1] - 10, 20) == 0);
+      }
+
+      triGen.Triangulate();
+
+      // no vertices added by TriLib
+      REQUIRE(triGen.verticeCount() == 45);
+
+      // a horizontal segment, split in 6 parts
+      int first = 0;
+      int last = 1;
+      std::vector<int> parts = { first };
+
+      for (int idx : report.addedPoints)
+      {
+         if (triGen.pointAtVertexId(idx)[1] == 10)
+         {
+            parts.push_back(idx);
+         }
+      }
+      parts.push_back(last);
+
+      std::sort(parts.begin(), parts.end(), 
+                [&](int lhs, int rhs) { return triGen.pointAtVertexId(lhs)[0] < triGen.pointAtVertexId(rhs)[0]; });
+      REQUIRE(parts.size() == 7);
+
+      for (size_t i = 1; i < parts.size(); ++i)
+      {
+         REQUIRE(hasSegment(triGen, parts[i - 1], parts[i]));
+      }
+   }
+
+   SECTION("TEST 24.2: touching and overlapping segments")
+   {
+      std::vector<Delaunay::Point> delaunayInput = { 
+         Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(5, 0), 
+         Delaunay::Point(5, 5), Delaunay::Point(15, 0), Delaunay::Point(5, -5) };
+
+      std::vector<int> segments = { 
+         0, 1,   // split by 2
+         2, 3,   // T-junction
+         2, 4,   // overlapping the first segment between 2 and 1
+         1, 0 }; // duplicate
+
+      Delaunay triGen(delaunayInput);
+      triGen.setSegmentConstraint(segments);
+      triGen.useConvexHullWithSegments(true);
+
+      auto report = triGen.resolveSegmentIntersections();
+
+      REQUIRE(report.crossingCount == 0);
+      REQUIRE(report.touchingCount == 6);
+      REQUIRE(report.splitSegmentCount == 3);
+      REQUIRE(report.removedSegmentCount == 3);
+      REQUIRE(report.addedPoints.empty());
+
+      triGen.Triangulate();
+
+      REQUIRE(hasSegment(triGen, 0, 2));
+      REQUIRE(hasSegment(triGen, 2, 1));
+      REQUIRE(hasSegment(triGen, 2, 3));
+      REQUIRE(hasSegment(triGen, 1, 4));
+      REQUIRE(!hasSegment(triGen, 0, 1));
+   }
+
+   SECTION("TEST 24.3: all crossings of random segments are found")
+   {
+      std::vector<Delaunay::Point> delaunayInput;
+      std::vector<int> segments;
+      RandomSequence random(777);
+
+      for (int i = 0; i < 300; ++i)
+      {
+         double x = random.next(), y = random.next();
+         double dx = (random.next() - 50) / 5, dy = (random.next() - 50) / 5;
+
+         delaunayInput.push_back(Delaunay::Point(x, y));
+         delaunayInput.push_back(Delaunay::Point(x + dx, y + dy));
+         segments.push_back(2 * i);
+         segments.push_back(2 * i + 1);
+      }
+
+      auto orientation = [](const Delaunay::Point& a, const Delaunay::Point& b, const Delaunay::Point& c)
+      {
+         return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+      };
+
+      int expected = 0;
+      for (int i = 0; i < 300; ++i)
+      {
+         for (int j = i + 1; j < 300; ++j)
+         {
+            const auto& a0 = delaunayInput[2 * i];
+            const auto& a1 = delaunayInput[2 * i + 1];
+            const auto& b0 = delaunayInput[2 * j];
+            const auto& b1 = delaunayInput[2 * j + 1];
+
+            if (orientation(a0, a1, b0) * orientation(a0, a1, b1) < 0 && 
+                orientation(b0, b1, a0) * orientation(b0, b1, a1) < 0)
+            {
+               ++expected;
+            }
+         }
+      }
+      REQUIRE(expected > 50);
+
+      for (int threads : { 1, 3 })
+      {
+         Delaunay triGen(delaunayInput);
+         triGen.setSegmentConstraint(segments);
+         triGen.useConvexHullWithSegments(true);
+         triGen.setThreadCount(threads);
+
+         auto report = triGen.resolveSegmentIntersections();
+
+         REQUIRE(report.crossingCount == expected);
+         REQUIRE((int)report.addedPoints.size() == expected);
+         REQUIRE(report.addedPoints.back() == 600 + expected - 1);
+
+         triGen.Triangulate();
+         REQUIRE(triGen.triangleCount() > 0);
+      }
+   }
+
+   SECTION("TEST 24.4: long segments across a cluster of short ones")
+   {
+      std::vector<Delaunay::Point> delaunayInput;
+      std::vector<int> segments;
+      RandomSequence random(4242);
+
+      auto addSegment = [&](const Delaunay::Point& from, const Delaunay::Point& to)
+      {
+         delaunayInput.push_back(from);
+         delaunayInput.push_back(to);
+         segments.push_back((int)delaunayInput.size() - 2);
+         segments.push_back((int)delaunayInput.size() - 1);
+      };
+
+      for (int i = 0; i < 400; ++i)
+      {
+         double x = 40 + random.next() / 10, y = 40 + random.next() / 10;
+         addSegment(Delaunay::Point(x, y), Delaunay::Point(x + (random.next() - 50) / 100, y + (random.next() - 50) / 100));
+      }
+      for (int i = 0; i < 30; ++i)
+      {
+         addSegment(Delaunay::Point(random.next(), 0), Delaunay::Point(random.next(), 100));
+      }
+
+      // short segments starting on a long one
+      addSegment(Delaunay::Point(0, 45.0005), Delaunay::Point(100, 45.0005));
+      for (int i = 0; i < 10; ++i)
+      {
+         addSegment(Delaunay::Point(40.5 + i, 45.0005), Delaunay::Point(40.5 + i, 45.5));
+      }
+
+      auto orientation = [](const Delaunay::Point& a, const Delaunay::Point& b, const Delaunay::Point& c)
+      {
+         return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+      };
+
+      int segmentCount = (int)segments.size() / 2;
+      int expected = 0;
+
+      for (int i = 0; i < segmentCount; ++i)
+      {
+         for (int j = i + 1; j < segmentCount; ++j)
+         {
+            const auto& a0 = delaunayInput[2 * i];
+            const auto& a1 = delaunayInput[2 * i + 1];
+            const auto& b0 = delaunayInput[2 * j];
+            const auto& b1 = delaunayInput[2 * j + 1];
+
+            if (orientation(a0, a1, b0) * orientation(a0, a1, b1) < 0 && 
+                orientation(b0, b1, a0) * orientation(b0, b1, a1) < 0)
+            {
+               ++expected;
+            }
+         }
+      }
+      REQUIRE(expected > 100);
+
+      for (int threads : { 1, 3 })
+      {
+         Delaunay triGen(delaunayInput);
+         triGen.setSegmentConstraint(segments);
+         triGen.setThreadCount(threads);
+
+         auto report = triGen.resolveSegmentIntersections();
+
+         REQUIRE(report.crossingCount == expected);
+         REQUIRE(report.touchingCount == 10);
+      }
+   }
+}
+
+
+TEST_CASE("Merging of near-duplicate points", "[trpp]")
+{
+   SECTION("TEST 25.1: exact duplicates")
+   {
+      std::vector<Delaunay::Point> delaunayInput = {
+         Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(10, 10), Delaunay::Point(0, 10),
+         Delaunay::Point(10, 0), Delaunay::Point(5, 5), Delaunay::Point(-0.0, 0), Delaunay::Point(5, 5) };
+
+      std::vector<Delaunay::Point> segments = { 
+         Delaunay::Point(10, 10), Delaunay::Point(0, 10), Delaunay::Point(0, 10), Delaunay::Point(5, 5) };
+
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.setSegmentConstraint(segments));
+
+      auto remap = triGen.mergeDuplicatePoints();
+      REQUIRE(remap == std::vector<int>({ 0, 1, 2, 3, 1, 4, 0, 4 }));
+
+      triGen.useConvexHullWithSegments(true);
+      triGen.Triangulate();
+
+      REQUIRE(triGen.verticeCount() == 5);
+      REQUIRE(triGen.triangleCount() == 4);
+      REQUIRE(triGen.pointAtVertexId(4)[0] == 5);
+
+      // setting segments by indexes merges the exact duplicates already
+      Delaunay indexGen(delaunayInput);
+      REQUIRE(indexGen.setSegmentConstraint(std::vector<int>{ 0, 4, 4, 2, 2, 3, 3, 6, 5, 7 }));
+      REQUIRE(indexGen.mergeDuplicatePoints() == std::vector<int>({ 0, 1, 2, 3, 4 }));
+   }
+
+   SECTION("TEST 25.2: snapping within a tolerance")
+   {
+      std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(2000, 99);
+
+      const double tolerance = 1.5;
+
+      // brute force: each point is merged into the first kept point within the tolerance
+      std::vector<int> expected(delaunayInput.size());
+      std::vector<int> keptPoints;
+
+      for (size_t i = 0; i < delaunayInput.size(); ++i)
+      {
+         expected[i] = -1;
+
+         for (size_t k = 0; k < keptPoints.size(); ++k)
+         {
+            const auto& kept = delaunayInput[keptPoints[k]];
+            double dx = kept[0] - delaunayInput[i][0];
+            double dy = kept[1] - delaunayInput[i][1];
+
+            if (dx * dx + dy * dy <= tolerance * tolerance)
+            {
+               expected[i] = (int)k;
+               break;
+            }
+         }
+
+         if (expected[i] < 0)
+         {
+            expected[i] = (int)keptPoints.size();
+            keptPoints.push_back((int)i);
+         }
+      }
+      REQUIRE(keptPoints.size() < delaunayInput.size());
+
+      Delaunay triGen(delaunayInput);
+      auto remap = triGen.mergeDuplicatePoints(tolerance);
+
+      REQUIRE(remap == expected);
+
+      triGen.Triangulate();
+      REQUIRE(triGen.verticeCount() == (int)keptPoints.size());
+
+      for (size_t k = 0; k < keptPoints.size(); ++k)
+      {
+         REQUIRE(triGen.pointAtVertexId((int)k)[0] == delaunayInput[keptPoints[k]][0]);
+         REQUIRE(triGen.pointAtVertexId((int)k)[1] == delaunayInput[keptPoints[k]][1]);
+      }
+   }
+}
+
+
+TEST_CASE("Polylines and rings", "[trpp]")
+{
+   // outer square with a square hole, plus a polyline inside
+   std::vector<Delaunay::Point> delaunayInput = {
+      Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(10, 10), Delaunay::Point(0, 10),
+      Delaunay::Point(4, 4), Delaunay::Point(6, 4), Delaunay::Point(6, 6), Delaunay::Point(4, 6),
+      Delaunay::Point(1, 1), Delaunay::Point(2, 3), Delaunay::Point(1, 5) };
+
+   std::vector<Delaunay::Point> outerRing = { 
+      Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(10, 10), Delaunay::Point(0, 10) };
+   std::vector<Delaunay::Point> holeRing = {
+      Delaunay::Point(4, 4), Delaunay::Point(6, 4), Delaunay::Point(6, 6), Delaunay::Point(4, 6), Delaunay::Point(4, 4) };
+   std::vector<Delaunay::Point> polyline = { 
+      Delaunay::Point(1, 1), Delaunay::Point(2, 3), Delaunay::Point(1, 5) };
+
+   SECTION("TEST 26.1: same as explicit segments")
+   {
+      Delaunay triGen(delaunayInput);
+
+      REQUIRE(triGen.addRing(outerRing));
+      REQUIRE(triGen.addRing(holeRing));
+      REQUIRE(triGen.addPolyline(polyline));
+
+      triGen.setHolesConstraint({ Delaunay::Point(5, 5) });
+      triGen.Triangulate();
+
+      std::vector<int> segments = { 0, 1, 1, 2, 2, 3, 3, 0, 4, 5, 5, 6, 6, 7, 7, 4, 8, 9, 9, 10 };
+
+      Delaunay indexGen(delaunayInput);
+      REQUIRE(indexGen.setSegmentConstraint(segments));
+      indexGen.setHolesConstraint({ Delaunay::Point(5, 5) });
+      indexGen.Triangulate();
+
+      REQUIRE(triGen.triangleCount() > 0);
+      REQUIRE(triGen.triangleCount() == indexGen.triangleCount());
+      REQUIRE(triGen.edgeCount() == indexGen.edgeCount());
+      REQUIRE(triGen.holeCount() == 1);
+   }
+
+   SECTION("TEST 26.2: invalid points")
+   {
+      Delaunay triGen(delaunayInput);
+
+      REQUIRE(triGen.addRing(outerRing));
+      REQUIRE_FALSE(triGen.addPolyline({ Delaunay::Point(1, 1), Delaunay::Point(3, 3) }));
+      REQUIRE_FALSE(triGen.addRing({ Delaunay::Point(1, 1), Delaunay::Point(2, 3), Delaunay::Point(-1, 0) }));
+
+      triGen.Triangulate();
+
+      // the outer ring only
+      Delaunay ringGen(delaunayInput);
+      REQUIRE(ringGen.setSegmentConstraint(std::vector<int>{ 0, 1, 1, 2, 2, 3, 3, 0 }));
+      ringGen.Triangulate();
+
+      REQUIRE(triGen.triangleCount() == ringGen.triangleCount());
+   }
+
+   SECTION("TEST 26.3: index follows the point changes")
+   {
+      std::vector<Delaunay::Point> duplicateInput(delaunayInput);
+      duplicateInput.insert(duplicateInput.begin(), Delaunay::Point(6, 6));
+
+      Delaunay triGen(duplicateInput);
+      REQUIRE(triGen.addRing(outerRing));
+
+      auto remap = triGen.mergeDuplicatePoints();
+      REQUIRE(remap[7] == 0);
+
+      REQUIRE(triGen.addRing(holeRing));
+      triGen.setHolesConstraint({ Delaunay::Point(5, 5) });
+      triGen.Triangulate();
+
+      Delaunay indexGen(delaunayInput);
+      REQUIRE(indexGen.setSegmentConstraint(std::vector<int>{ 0, 1, 1, 2, 2, 3, 3, 0, 4, 5, 5, 6, 6, 7, 7, 4 }));
+      indexGen.setHolesConstraint({ Delaunay::Point(5, 5) });
+      indexGen.Triangulate();
+
+      REQUIRE(triGen.triangleCount() == indexGen.triangleCount());
+
+      // crossing points are appended to the input points
+      Delaunay crossGen(delaunayInput);
+      REQUIRE(crossGen.addPolyline({ Delaunay::Point(0, 0), Delaunay::Point(10, 10) }));
+      REQUIRE(crossGen.addPolyline({ Delaunay::Point(10, 0), Delaunay::Point(0, 10) }));
+      REQUIRE(crossGen.addPolyline({ Delaunay::Point(2, 3), Delaunay::Point(1, 5) }));
+
+      REQUIRE_FALSE(crossGen.addPolyline({ Delaunay::Point(5, 5), Delaunay::Point(2, 3) }));
+      auto report = crossGen.resolveSegmentIntersections();
+      REQUIRE(report.addedPoints.size() == 1);
+      REQUIRE(crossGen.addPolyline({ Delaunay::Point(5, 5), Delaunay::Point(2, 3) }));
+   }
+}
+
+
+TEST_CASE("Hole rings", "[trpp]")
+{
+   auto square = [](double x, double y, double size)
+   {
+      return std::vector<Delaunay::Point>{ 
+         Delaunay::Point(x, y), Delaunay::Point(x + size, y), Delaunay::Point(x + size, y + size), Delaunay::Point(x, y + size) };
+   };
+
+   auto area = [](Delaunay& triGen)
+   {
+      double sum = 0;
+      for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f)
+      {
+         sum += std::fabs(f.area());
+      }
+      return sum;
+   };
+
+   SECTION("TEST 27.1: same as hole points")
+   {
+      auto outer = square(0, 0, 10);
+      auto hole = square(3, 3, 4);
+
+      std::vector<Delaunay::Point> delaunayInput(outer);
+      delaunayInput.insert(delaunayInput.end(), hole.begin(), hole.end());
+      delaunayInput.push_back(Delaunay::Point(1, 5));
+
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.addRing(outer));
+      REQUIRE(triGen.addHoleRing(hole));
+      triGen.Triangulate();
+
+      Delaunay seedGen(delaunayInput);
+      REQUIRE(seedGen.addRing(outer));
+      REQUIRE(seedGen.addRing(hole));
+      seedGen.setHolesConstraint({ Delaunay::Point(5, 5) });
+      seedGen.Triangulate();
+
+      REQUIRE(triGen.triangleCount() == seedGen.triangleCount());
+      REQUIRE(area(triGen) == Approx(100 - 16));
+
+      // the convex hull instead of an outer ring
+      Delaunay hullGen(delaunayInput);
+      REQUIRE(hullGen.addHoleRing(hole));
+      hullGen.useConvexHullWithSegments(true);
+      hullGen.Triangulate();
+
+      REQUIRE(area(hullGen) == Approx(100 - 16));
+
+      REQUIRE_FALSE(triGen.addHoleRing({ Delaunay::Point(3, 3), Delaunay::Point(7, 3) }));
+      REQUIRE_FALSE(triGen.addHoleRing({ Delaunay::Point(3, 3), Delaunay::Point(7, 3), Delaunay::Point(8, 8) }));
+   }
+
+   SECTION("TEST 27.2: nested and adjacent rings")
+   {
+      auto outer = square(0, 0, 20);
+      auto hole = square(2, 2, 10);
+      auto island = square(4, 4, 4);
+      auto left = square(14, 2, 2);
+      auto right = square(16, 2, 2); // shares an edge with the left one
+
+      std::vector<Delaunay::Point> delaunayInput;
+      for (auto* ring : { &outer, &hole, &island, &left, &right })
+      {
+         for (auto& pt : *ring)
+         {
+            delaunayInput.push_back(pt);
+         }
+      }
+
+      Delaunay triGen(delaunayInput);
+      triGen.mergeDuplicatePoints();
+
+      REQUIRE(triGen.addRing(outer));
+      REQUIRE(triGen.addHoleRing(hole));
+      REQUIRE(triGen.addHoleRing(island));
+      REQUIRE(triGen.addHoleRing(left));
+      REQUIRE(triGen.addHoleRing(right));
+      triGen.Triangulate();
+
+      REQUIRE(area(triGen) == Approx(400 - 100 + 16 - 4 - 4));
+
+      triGen.clearHoleRings();
+      triGen.Triangulate();
+
+      REQUIRE(area(triGen) == Approx(400));
+   }
+
+   SECTION("TEST 27.3: many holes")
+   {
+      std::vector<Delaunay::Point> delaunayInput = square(0, 0, 100);
+      std::vector<Delaunay::Point> holeSeeds;
+
+      for (int i = 0; i < 20; ++i)
+      {
+         for (int j = 0; j < 20; ++j)
+         {
+            auto hole = square(i * 5 + 1, j * 5 + 1, 2 + (i + j) % 3);
+            delaunayInput.insert(delaunayInput.end(), hole.begin(), hole.end());
+            holeSeeds.push_back(Delaunay::Point(i * 5 + 2, j * 5 + 2));
+         }
+      }
+
+      Delaunay triGen(delaunayInput);
+      Delaunay seedGen(delaunayInput);
+      REQUIRE(triGen.addRing(square(0, 0, 100)));
+      REQUIRE(seedGen.addRing(square(0, 0, 100)));
+
+      double holesArea = 0;
+
+      for (int i = 0; i < 20; ++i)
+      {
+         for (int j = 0; j < 20; ++j)
+         {
+            double size = 2 + (i + j) % 3;
+            auto hole = square(i * 5 + 1, j * 5 + 1, size);
+
+            REQUIRE(triGen.addHoleRing(hole));
+            REQUIRE(seedGen.addRing(hole));
+            holesArea += size * size;
+         }
+      }
+
+      seedGen.setHolesConstraint(holeSeeds);
+
+      triGen.enableSegmentBatchInsertion(true); // the ring markers are reordered with the segments
+      triGen.Triangulate(true);
+      seedGen.Triangulate(true);
+
+      REQUIRE(triGen.triangleCount() == seedGen.triangleCount());
+      REQUIRE(area(triGen) == Approx(10000 - holesArea));
+   }
+}
+
+
+TEST_CASE("Region labels", "[trpp]")
+{
+   // a square split in 3 vertical strips
+   std::vector<Delaunay::Point> delaunayInput = {
+      Delaunay::Point(0, 0), Delaunay::Point(3, 0), Delaunay::Point(6, 0), Delaunay::Point(9, 0),
+      Delaunay::Point(0, 3), Delaunay::Point(3, 3), Delaunay::Point(6, 3), Delaunay::Point(9, 3) };
+   std::vector<int> segments = { 0, 3, 3, 7, 7, 4, 4, 0, 1, 5, 2, 6 };
+
+   auto stripOf = [](const FaceIterator& f)
+   {
+      Delaunay::Point a, b, c;
+      f.Org(&a);
+      f.Dest(&b);
+      f.Apex(&c);
+      return (int)((a[0] + b[0] + c[0]) / 3 / 3);
+   };
+
+   SECTION("TEST 28.1: labels and area constraints")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.setSegmentConstraint(segments);
+      triGen.setRegionsConstraint({ Delaunay::Point(1, 1), Delaunay::Point(8, 2) }, { 0.05f, 0.5f });
+
+      triGen.Triangulate();
+      REQUIRE(triGen.triangleCount() == 6);
+
+      for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f)
+      {
+         int expected[] = { 0, -1, 1 };
+         REQUIRE(f.regionId() == expected[stripOf(f)]);
+      }
+
+      triGen.Triangulate(true);
+      REQUIRE(triGen.triangleCount() > 6);
+
+      for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f)
+      {
+         int expected[] = { 0, -1, 1 };
+         REQUIRE(f.regionId() == expected[stripOf(f)]);
+
+         if (f.regionId() == 0)
+         {
+            REQUIRE(f.area() <= 0.05 + 1e-9);
+         }
+         else if (f.regionId() == 1)
+         {
+            REQUIRE(f.area() <= 0.5 + 1e-9);
+         }
+      }
+
+      // no regions
+      Delaunay plainGen(delaunayInput);
+      plainGen.setSegmentConstraint(segments);
+      plainGen.Triangulate();
+
+      for (FaceIterator f = plainGen.fbegin(); f != plainGen.fend(); ++f)
+      {
+         REQUIRE(f.regionId() == -1);
+      }
+   }
+
+   SECTION("TEST 28.2: the last region point wins")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.setSegmentConstraint(segments);
+      triGen.setRegionsConstraint({ Delaunay::Point(4, 1), Delaunay::Point(1, 1), Delaunay::Point(5, 2) }, { 1, 1, 1 });
+      triGen.Triangulate();
+
+      for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f)
+      {
+         int expected[] = { 1, 2, -1 };
+         REQUIRE(f.regionId() == expected[stripOf(f)]);
+      }
+   }
+
+   SECTION("TEST 28.3: many regions")
+   {
+      const int cells = 30;
+      std::vector<Delaunay::Point> gridInput;
+      std::vector<int> gridSegments;
+      std::vector<Delaunay::Point> regions;
+      std::vector<float> areas;
+
+      for (int i = 0; i <= cells; ++i)
+      {
+         for (int j = 0; j <= cells; ++j)
+         {
+            gridInput.push_back(Delaunay::Point(i, j));
+
+            if (i < cells)
+            {
+               gridSegments.insert(gridSegments.end(), { i * (cells + 1) + j, (i + 1) * (cells + 1) + j });
+            }
+            if (j < cells)
+            {
+               gridSegments.insert(gridSegments.end(), { i * (cells + 1) + j, i * (cells + 1) + j + 1 });
+            }
+            if (i < cells && j < cells && (i + j) % 2 == 0)
+            {
+               regions.push_back(Delaunay::Point(i + 0.3, j + 0.6));
+               areas.push_back(0.1f);
+            }
+         }
+      }
+
+      Delaunay triGen(gridInput);
+      triGen.setSegmentConstraint(gridSegments);
+      triGen.setRegionsConstraint(regions, areas);
+      triGen.Triangulate(true);
+
+      for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f)
+      {
+         Delaunay::Point a, b, c;
+         f.Org(&a);
+         f.Dest(&b);
+         f.Apex(&c);
+
+         int i = (int)((a[0] + b[0] + c[0]) / 3);
+         int j = (int)((a[1] + b[1] + c[1]) / 3);
+
+         if ((i + j) % 2 == 0)
+         {
+            int regionId = f.regionId();
+            REQUIRE(regionId >= 0);
+            REQUIRE((int)regions[regionId][0] == i);
+            REQUIRE((int)regions[regionId][1] == j);
+         }
+         else
+         {
+            REQUIRE(f.regionId() == -1);
+         }
+      }
+   }
+
+   SECTION("TEST 28.4: refine() keeps the regional area constraints")
+   {
+      auto checkRegions = [&stripOf](Delaunay& triGen)
+      {
+         for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f)
+         {
+            int expected[] = { 0, -1, 1 };
+            REQUIRE(f.regionId() == expected[stripOf(f)]);
+
+            if (f.regionId() == 0)
+            {
+               REQUIRE(f.area() <= 0.05 + 1e-9);
+            }
+            else if (f.regionId() == 1)
+            {
+               REQUIRE(f.area() <= 0.5 + 1e-9);
+            }
+         }
+      };
+
+      // areas set by a quality triangulation
+      Delaunay triGen(delaunayInput);
+      triGen.setSegmentConstraint(segments);
+      triGen.setRegionsConstraint({ Delaunay::Point(1, 1), Delaunay::Point(8, 2) }, { 0.05f, 0.5f });
+      triGen.Triangulate(true);
+
+      int lastTriangleCt = triGen.triangleCount();
+      triGen.refine(30, 2);
+
+      REQUIRE(triGen.refinementCompleted());
+      REQUIRE(triGen.triangleCount() >= lastTriangleCt);
+      checkRegions(triGen);
+
+      // no areas stored in the triangles yet
+      Delaunay plainGen(delaunayInput);
+      plainGen.setSegmentConstraint(segments);
+      plainGen.setRegionsConstraint({ Delaunay::Point(1, 1), Delaunay::Point(8, 2) }, { 0.05f, 0.5f });
+      plainGen.Triangulate();
+      REQUIRE(plainGen.triangleCount() == 6);
+
+      plainGen.refine(30, 2);
+
+      REQUIRE(plainGen.refinementCompleted());
+      checkRegions(plainGen);
+   }
+}
+
+
+TEST_CASE("Lazy Voronoi diagram", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(2000, 17);
+
+   struct VoronoiData
+   {
+      std::vector<double> points;
+      std::vector<std::tuple<int, int, double, double>> edges; // sorted, the edges' order depends on memory addresses
+   };
+
+   auto readVoronoi = [](Delaunay& triGen)
+   {
+      VoronoiData data;
+
+      for (VoronoiVertexIterator vit = triGen.vvbegin(); vit != triGen.vvend(); ++vit)
+      {
+         data.points.push_back((*vit)[0]);
+         data.points.push_back((*vit)[1]);
+      }
+
+      for (VoronoiEdgeIterator eit = triGen.vebegin(); eit != triGen.veend(); ++eit)
+      {
+         Delaunay::Point normal;
+         int a = eit.startPointId();
+         int b = eit.endPointId(normal);
+         data.edges.push_back(std::make_tuple(std::min(a, b), std::max(a, b), normal[0], normal[1]));
+      }
+
+      std::sort(data.edges.begin(), data.edges.end());
+      return data;
+   };
+
+   SECTION("TEST 29.1: built from an existing triangulation")
+   {
+      Delaunay tessGen(delaunayInput);
+      tessGen.Tesselate();
+      VoronoiData expected = readVoronoi(tessGen);
+
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.vvbegin() == triGen.vvend());
+      REQUIRE(triGen.vebegin() == triGen.veend());
+      REQUIRE(triGen.voronoiPointCount() == 0);
+
+      triGen.Triangulate();
+
+      // known before it's built
+      REQUIRE(triGen.voronoiPointCount() == triGen.triangleCount());
+      REQUIRE(triGen.voronoiEdgeCount() == triGen.edgeCount());
+
+      VoronoiData lazy = readVoronoi(triGen);
+
+      REQUIRE(lazy.points.size() == 2 * (size_t)triGen.triangleCount());
+      REQUIRE(lazy.edges.size() == (size_t)triGen.edgeCount());
+      REQUIRE(lazy.points == expected.points);
+      REQUIRE(lazy.edges == expected.edges);
+
+      // from scratch again
+      triGen.Triangulate();
+      REQUIRE(readVoronoi(triGen).points == expected.points);
+   }
+
+   SECTION("TEST 29.2: rebuilt after the mesh was changed")
+   {
+      std::vector<int> segments = { 0, 1, 2, 3 };
+
+      Delaunay triGen(delaunayInput);
+      triGen.setSegmentConstraint(segments);
+      triGen.useConvexHullWithSegments(true);
+      triGen.Triangulate();
+
+      int before = (int)readVoronoi(triGen).points.size() / 2;
+      REQUIRE(before == triGen.triangleCount());
+
+      // needs the subsegments, which were overwritten while building the diagram
+      triGen.refine(30, 5);
+      REQUIRE(triGen.triangleCount() > before);
+
+      VoronoiData refined = readVoronoi(triGen);
+      REQUIRE(refined.points.size() == 2 * (size_t)triGen.triangleCount());
+      REQUIRE(triGen.voronoiPointCount() == triGen.triangleCount());
+
+      // each Voronoi vertex is the circumcenter of its triangle
+      int i = 0;
+      for (FaceIterator f = triGen.fbegin(); f != triGen.fend(); ++f, ++i)
+      {
+         Delaunay::Point a, b;
+         f.Org(&a);
+         f.Dest(&b);
+         Delaunay::Point center(refined.points[2 * i], refined.points[2 * i + 1]);
+         double ra = std::hypot(center[0] - a[0], center[1] - a[1]);
+         double rb = std::hypot(center[0] - b[0], center[1] - b[1]);
+         REQUIRE(std::abs(ra - rb) <= 1e-6 * ra);
+      }
+
+      triGen.smooth();
+      REQUIRE(readVoronoi(triGen).points.size() == 2 * (size_t)triGen.triangleCount());
+   }
+
+   SECTION("TEST 29.3: same result with several threads")
+   {
+      Delaunay serialGen(delaunayInput);
+      serialGen.Triangulate(true);
+      VoronoiData serial = readVoronoi(serialGen);
+
+      Delaunay parallelGen(delaunayInput);
+      parallelGen.setThreadCount(4);
+      parallelGen.Triangulate(true);
+      VoronoiData parallel = readVoronoi(parallelGen);
+
+      REQUIRE(parallel.points == serial.points);
+      REQUIRE(parallel.edges == serial.edges);
+   }
+}
+
+
+TEST_CASE("Voronoi cells", "[trpp]")
+{
+   SECTION("TEST 30.1: cells of a grid")
+   {
+      std::vector<Delaunay::Point> delaunayInput;
+      for (int y = 0; y < 5; ++y)
+      {
+         for (int x = 0; x < 5; ++x)
+         {
+            delaunayInput.push_back(Delaunay::Point(x, y));
+         }
+      }
+
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.voronoiCells().cellCount() == 0);
+
+      triGen.Triangulate();
+      Delaunay::VoronoiCells cells = triGen.voronoiCells();
+
+      REQUIRE(cells.cellCount() == 25);
+      REQUIRE(cells.offsets.size() == 26);
+      REQUIRE(cells.offsets.back() == (int)cells.vertices.size());
+
+      for (int i = 0; i < 25; ++i)
+      {
+         int x = i % 5;
+         int y = i / 5;
+         bool inner = x > 0 && x < 4 && y > 0 && y < 4;
+
+         if (inner)
+         {
+            REQUIRE(cells.areas[i] == Approx(1.0));
+         }
+         else
+         {
+            REQUIRE(std::isinf(cells.areas[i]));
+            REQUIRE(std::count(cells.vertices.begin() + cells.offsets[i], cells.vertices.begin() + cells.offsets[i + 1], -1) == 1);
+         }
+
+         // the 4 direct neighbors are always there
+         std::vector<int> neighbors(cells.neighbors.begin() + cells.offsets[i], cells.neighbors.begin() + cells.offsets[i + 1]);
+         if (x > 0) REQUIRE(std::count(neighbors.begin(), neighbors.end(), i - 1) == 1);
+         if (x < 4) REQUIRE(std::count(neighbors.begin(), neighbors.end(), i + 1) == 1);
+         if (y > 0) REQUIRE(std::count(neighbors.begin(), neighbors.end(), i - 5) == 1);
+         if (y < 4) REQUIRE(std::count(neighbors.begin(), neighbors.end(), i + 5) == 1);
+      }
+   }
+
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(3000, 31);
+
+   SECTION("TEST 30.2: cells match the Voronoi diagram")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.Triangulate(true);
+      Delaunay::VoronoiCells cells = triGen.voronoiCells();
+
+      REQUIRE(cells.cellCount() == triGen.verticeCount());
+
+      std::vector<Delaunay::Point> vpoints;
+      for (VoronoiVertexIterator vit = triGen.vvbegin(); vit != triGen.vvend(); ++vit)
+      {
+         vpoints.push_back(*vit);
+      }
+
+      std::set<std::pair<int, int>> vedges;
+      for (VoronoiEdgeIterator eit = triGen.vebegin(); eit != triGen.veend(); ++eit)
+      {
+         Delaunay::Point normal;
+         int a = eit.startPointId();
+         int b = eit.endPointId(normal);
+         vedges.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+      }
+
+      double boundedArea = 0;
+      int unbounded = 0;
+
+      for (int i = 0; i < cells.cellCount(); ++i)
+      {
+         int first = cells.offsets[i];
+         int count = cells.offsets[i + 1] - first;
+         REQUIRE(count >= 3);
+
+         double area = 0;
+
+         for (int j = 0; j < count; ++j)
+         {
+            int a = cells.vertices[first + j];
+            int b = cells.vertices[first + (j + 1) % count];
+            int n = cells.neighbors[first + j];
+
+            // each cell edge is a Voronoi edge, the same one is in the neighbor's cell
+            REQUIRE(vedges.count(std::make_pair(std::min(a, b), std::max(a, b))) == 1);
+
+            std::vector<int> across(cells.vertices.begin() + cells.offsets[n], cells.vertices.begin() + cells.offsets[n + 1]);
+            REQUIRE(std::find(across.begin(), across.end(), std::max(a, b)) != across.end());
+
+            if (a >= 0 && b >= 0)
+            {
+               area += vpoints[a][0] * vpoints[b][1] - vpoints[a][1] * vpoints[b][0];
+            }
+         }
+
+         if (std::isinf(cells.areas[i]))
+         {
+            ++unbounded;
+         }
+         else
+         {
+            REQUIRE(cells.areas[i] > 0);
+            REQUIRE(cells.areas[i] == Approx(area / 2));
+            boundedArea += cells.areas[i];
+         }
+      }
+
+      REQUIRE(unbounded == triGen.hullSize());
+      REQUIRE(boundedArea < 100 * 100);
+   }
+
+   SECTION("TEST 30.3: same result with several threads, duplicates")
+   {
+      std::vector<Delaunay::Point> withDuplicate = delaunayInput;
+      withDuplicate.push_back(delaunayInput[10]);
+
+      Delaunay serialGen(withDuplicate);
+      serialGen.Triangulate();
+      Delaunay::VoronoiCells serial = serialGen.voronoiCells();
+
+      Delaunay parallelGen(withDuplicate);
+      parallelGen.setThreadCount(4);
+      parallelGen.Triangulate();
+      Delaunay::VoronoiCells parallel = parallelGen.voronoiCells();
+
+      // one of the duplicates isn't in the mesh
+      int last = (int)withDuplicate.size() - 1;
+      int dropped = (serial.offsets[last] == serial.offsets[last + 1]) ? last : 10;
+      REQUIRE(serial.offsets[dropped] == serial.offsets[dropped + 1]);
+      REQUIRE(serial.areas[dropped] == 0);
+      REQUIRE(serial.offsets[last + 10 - dropped] < serial.offsets[last + 10 - dropped + 1]);
+
+      REQUIRE(parallel.offsets == serial.offsets);
+      REQUIRE(parallel.vertices == serial.vertices);
+      REQUIRE(parallel.neighbors == serial.neighbors);
+      REQUIRE(parallel.areas == serial.areas);
+   }
+}
+
+
+TEST_CASE("Clipped Voronoi cells", "[trpp]")
+{
+   auto clippedArea = [](const Delaunay::VoronoiCells& cells)
+   {
+      double area = 0;
+      for (int i = 0; i < cells.cellCount(); ++i)
+      {
+         REQUIRE(std::isfinite(cells.areas[i]));
+         area += cells.areas[i];
+      }
+      return area;
+   };
+
+   SECTION("TEST 31.1: cells of a grid clipped to a rectangle")
+   {
+      std::vector<Delaunay::Point> delaunayInput;
+      for (int y = 0; y < 5; ++y)
+      {
+         for (int x = 0; x < 5; ++x)
+         {
+            delaunayInput.push_back(Delaunay::Point(x, y));
+         }
+      }
+
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.setVoronoiClipRegion(Delaunay::Point(-0.5, -0.5), Delaunay::Point(4.5, 4.5)));
+
+      triGen.Tesselate();
+      Delaunay::VoronoiCells cells = triGen.voronoiCells();
+
+      REQUIRE(cells.clippedOffsets.size() == 26);
+      REQUIRE(cells.clippedOffsets.back() == (int)cells.clippedPoints.size());
+
+      for (int i = 0; i < 25; ++i)
+      {
+         REQUIRE(cells.areas[i] == Approx(1.0));
+
+         for (int j = cells.clippedOffsets[i]; j < cells.clippedOffsets[i + 1]; ++j)
+         {
+            const Delaunay::Point& corner = cells.clippedPoints[j];
+            REQUIRE(std::abs(corner[0] - delaunayInput[i][0]) <= 0.5 + 1e-9);
+            REQUIRE(std::abs(corner[1] - delaunayInput[i][1]) <= 0.5 + 1e-9);
+         }
+      }
+
+      triGen.removeVoronoiClipRegion();
+      cells = triGen.voronoiCells();
+
+      REQUIRE(cells.clippedOffsets.empty());
+      REQUIRE(std::isinf(cells.areas[0]));
+   }
+
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(3000, 41);
+
+   SECTION("TEST 31.2: clipped cells cover the clip region")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.Triangulate();
+
+      REQUIRE(triGen.setVoronoiClipRegion(Delaunay::Point(0, 0), Delaunay::Point(100, 100)));
+      REQUIRE(clippedArea(triGen.voronoiCells()) == Approx(100 * 100));
+
+      // larger than the hull, clockwise
+      std::vector<Delaunay::Point> hexagon;
+      for (int i = 0; i < 6; ++i)
+      {
+         double angle = -i * std::acos(-1.0) / 3;
+         hexagon.push_back(Delaunay::Point(50 + 200 * std::cos(angle), 50 + 200 * std::sin(angle)));
+      }
+
+      REQUIRE(triGen.setVoronoiClipRegion(hexagon));
+      REQUIRE(clippedArea(triGen.voronoiCells()) == Approx(1.5 * std::sqrt(3.0) * 200 * 200));
+
+      // invalid ones are rejected, the last one is kept
+      REQUIRE(!triGen.setVoronoiClipRegion({ Delaunay::Point(0, 0), Delaunay::Point(1, 1) }));
+      REQUIRE(!triGen.setVoronoiClipRegion({ Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(5, 1), 
+                                             Delaunay::Point(10, 10), Delaunay::Point(0, 10) }));
+      REQUIRE(!triGen.setVoronoiClipRegion({ Delaunay::Point(0, 0), Delaunay::Point(1, 1), Delaunay::Point(2, 2) }));
+
+      // a pentagram turns the same way at every corner, but twice around
+      std::vector<Delaunay::Point> pentagram;
+      for (int i = 0; i < 5; ++i)
+      {
+         double angle = i * 4 * std::acos(-1.0) / 5;
+         pentagram.push_back(Delaunay::Point(50 + 200 * std::cos(angle), 50 + 200 * std::sin(angle)));
+      }
+
+      REQUIRE(!triGen.setVoronoiClipRegion(pentagram));
+
+      // duplicate corners and spikes
+      REQUIRE(!triGen.setVoronoiClipRegion({ Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(10, 0), 
+                                             Delaunay::Point(10, 10), Delaunay::Point(0, 10) }));
+      REQUIRE(!triGen.setVoronoiClipRegion({ Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(10, 10), 
+                                             Delaunay::Point(10, 5), Delaunay::Point(0, 10) }));
+
+      // collinear corners are fine
+      REQUIRE(triGen.setVoronoiClipRegion({ Delaunay::Point(-100, -100), Delaunay::Point(50, -100), 
+                                            Delaunay::Point(200, -100), Delaunay::Point(200, 200), 
+                                            Delaunay::Point(-100, 200) }));
+      REQUIRE(clippedArea(triGen.voronoiCells()) == Approx(300 * 300));
+      REQUIRE(triGen.setVoronoiClipRegion(hexagon));
+      REQUIRE(clippedArea(triGen.voronoiCells()) == Approx(1.5 * std::sqrt(3.0) * 200 * 200));
+   }
+
+   SECTION("TEST 31.3: same result with several threads")
+   {
+      Delaunay serialGen(delaunayInput);
+      serialGen.setVoronoiClipRegion(Delaunay::Point(10, 20), Delaunay::Point(70, 60));
+      serialGen.Triangulate();
+      Delaunay::VoronoiCells serial = serialGen.voronoiCells();
+
+      Delaunay parallelGen(delaunayInput);
+      parallelGen.setThreadCount(4);
+      parallelGen.setVoronoiClipRegion(Delaunay::Point(10, 20), Delaunay::Point(70, 60));
+      parallelGen.Triangulate();
+      Delaunay::VoronoiCells parallel = parallelGen.voronoiCells();
+
+      REQUIRE(clippedArea(serial) == Approx(60 * 40));
+      REQUIRE(parallel.areas == serial.areas);
+      REQUIRE(parallel.clippedOffsets == serial.clippedOffsets);
+      REQUIRE(parallel.clippedPoints.size() == serial.clippedPoints.size());
+
+      for (size_t i = 0; i < serial.clippedPoints.size(); ++i)
+      {
+         REQUIRE(parallel.clippedPoints[i] == serial.clippedPoints[i]);
+      }
+   }
+}
+
+
+TEST_CASE("Weighted triangulation", "[trpp]")
+{
+   auto lifted = [](const Delaunay::Point& p, double weight)
+   {
+      return p[0] * p[0] + p[1] * p[1] - weight;
+   };
+
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(400, 43);
+   std::vector<double> weights;
+   RandomSequence random(44);
+
+   for (int i = 0; i < 400; ++i)
+   {
+      weights.push_back(random.next(100, 1000));
+   }
+
+   SECTION("TEST 32.1: zero weights give the Delaunay triangulation")
+   {
+      Delaunay delaunayGen(delaunayInput);
+      delaunayGen.setAlgorithm(Incremental);
+      delaunayGen.Triangulate();
+
+      Delaunay weightedGen(delaunayInput);
+      REQUIRE(weightedGen.setPointWeights(std::vector<double>(delaunayInput.size(), 0.0)));
+      weightedGen.Tesselate();
+
+      REQUIRE(weightedGen.triangleCount() == delaunayGen.triangleCount());
+      REQUIRE(sortedTriangles(weightedGen) == sortedTriangles(delaunayGen));
+
+      REQUIRE(!weightedGen.setPointWeights({ 1.0, 2.0 }));
+   }
+
+   SECTION("TEST 32.2: no lifted point lies below a lifted triangle")
+   {
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.setPointWeights(weights));
+      triGen.Tesselate();
+
+      auto triangles = sortedTriangles(triGen);
+      std::vector<bool> used(delaunayInput.size(), false);
+      int violations = 0;
+      REQUIRE(!triangles.empty());
+
+      for (const auto& tri : triangles)
+      {
+         int idx[3] = { std::get<0>(tri), std::get<1>(tri), std::get<2>(tri) };
+         const Delaunay::Point& a = delaunayInput[idx[0]];
+         const Delaunay::Point& b = delaunayInput[idx[1]];
+         const Delaunay::Point& c = delaunayInput[idx[2]];
+
+         // plane through the lifted corners: z = u * x + v * y + w
+         double det = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+         REQUIRE(det > 0);
+
+         double za = lifted(a, weights[idx[0]]);
+         double zb = lifted(b, weights[idx[1]]);
+         double zc = lifted(c, weights[idx[2]]);
+         double u = ((zb - za) * (c[1] - a[1]) - (zc - za) * (b[1] - a[1])) / det;
+         double v = ((b[0] - a[0]) * (zc - za) - (c[0] - a[0]) * (zb - za)) / det;
+
+         for (size_t i = 0; i < delaunayInput.size(); ++i)
+         {
+            const Delaunay::Point& p = delaunayInput[i];
+            double plane = za + u * (p[0] - a[0]) + v * (p[1] - a[1]);
+
+            if (lifted(p, weights[i]) < plane - 1e-6)
+            {
+               ++violations;
+            }
+         }
+
+         for (int i : idx)
+         {
+            used[i] = true;
+         }
+      }
+
+      REQUIRE(violations == 0);
+
+      // the redundant points aren't in the triangulation
+      int redundantCount = (int)std::count(used.begin(), used.end(), false);
+      REQUIRE(redundantCount > 0);
+
+      Delaunay::VoronoiCells cells = triGen.voronoiCells();
+
+      for (size_t i = 0; i < delaunayInput.size(); ++i)
+      {
+         bool emptyCell = cells.offsets[i] == cells.offsets[i + 1];
+         REQUIRE(emptyCell == !used[i]);
+      }
+   }
+
+   SECTION("TEST 32.3: power cells")
+   {
+      std::vector<Delaunay::Point> square = { Delaunay::Point(0, 0), Delaunay::Point(4, 0), Delaunay::Point(4, 4), 
+                                              Delaunay::Point(0, 4), Delaunay::Point(2, 2) };
+      Delaunay triGen(square);
+      REQUIRE(triGen.setVoronoiClipRegion(Delaunay::Point(-2, -2), Delaunay::Point(6, 6)));
+
+      // a light center point is redundant
+      REQUIRE(triGen.setPointWeights({ 0, 0, 0, 0, -10 }));
+      triGen.Tesselate();
+
+      REQUIRE(triGen.triangleCount() == 2);
+      REQUIRE(triGen.voronoiCells().areas[4] == 0.0);
+
+      // a heavy one gets a larger cell: the bisectors move by weight / (2 * distance)
+      REQUIRE(triGen.setPointWeights({ 0, 0, 0, 0, 4 }));
+      triGen.Tesselate();
+
+      Delaunay::VoronoiCells cells = triGen.voronoiCells();
+      double half = std::sqrt(8.0) / 2 + 4 / (2 * std::sqrt(8.0));
+
+      REQUIRE(triGen.triangleCount() == 4);
+      REQUIRE(cells.areas[4] == Approx(4 * half * half));
+
+      // equal weights give the Voronoi cells
+      Delaunay voronoiGen(delaunayInput);
+      voronoiGen.setVoronoiClipRegion(Delaunay::Point(0, 0), Delaunay::Point(100, 100));
+      voronoiGen.Tesselate();
+      Delaunay::VoronoiCells voronoiCells = voronoiGen.voronoiCells();
+
+      Delaunay powerGen(delaunayInput);
+      powerGen.setVoronoiClipRegion(Delaunay::Point(0, 0), Delaunay::Point(100, 100));
+      powerGen.setPointWeights(std::vector<double>(delaunayInput.size(), 5.0));
+      powerGen.Tesselate();
+      Delaunay::VoronoiCells powerCells = powerGen.voronoiCells();
+
+      for (size_t i = 0; i < delaunayInput.size(); ++i)
+      {
+         REQUIRE(powerCells.areas[i] == Approx(voronoiCells.areas[i]).margin(1e-9));
+      }
+
+      // the power cells cover the clip region
+      powerGen.setPointWeights(weights);
+      powerGen.Tesselate();
+      powerCells = powerGen.voronoiCells();
+
+      double area = 0;
+      for (double cellArea : powerCells.areas)
+      {
+         area += cellArea;
+      }
+      REQUIRE(area == Approx(100 * 100));
+   }
+
+   SECTION("TEST 32.4: mesh indexing and constraints")
+   {
+      // the mesh indexes are stored after the weights
+      Delaunay indexedGen(delaunayInput, true);
+      indexedGen.setPointWeights(weights);
+      indexedGen.Tesselate();
+
+      Delaunay powerGen(delaunayInput);
+      powerGen.setPointWeights(weights);
+      powerGen.Tesselate();
+
+      for (FaceIterator fit = indexedGen.fbegin(); fit != indexedGen.fend(); ++fit)
+      {
+         Delaunay::Point p0;
+         int meshIdx = -1;
+         fit.Org(p0, meshIdx);
+
+         REQUIRE(meshIdx >= 0);
+         REQUIRE(meshIdx < (int)delaunayInput.size());
+      }
+
+      REQUIRE(indexedGen.voronoiCells().areas == powerGen.voronoiCells().areas);
+
+      // weights are ignored with quality constraints
+      Delaunay delaunayGen(delaunayInput);
+      delaunayGen.Triangulate(true);
+
+      Delaunay weightedGen(delaunayInput);
+      weightedGen.setPointWeights(weights);
+      weightedGen.Triangulate(true);
+
+      REQUIRE(sortedTriangles(weightedGen) == sortedTriangles(delaunayGen));
+   }
+
+   SECTION("TEST 32.5: weights follow merged and added points")
+   {
+      // the low-weighted point inside the square is redundant
+      std::vector<Delaunay::Point> squareInput = {
+         Delaunay::Point(0, 0), Delaunay::Point(10, 0), Delaunay::Point(10, 10), Delaunay::Point(0, 10),
+         Delaunay::Point(5, 2), Delaunay::Point(5, 2) };
+
+      Delaunay mergedGen(squareInput);
+      REQUIRE(mergedGen.setPointWeights({ 0, 0, 0, 0, -100, -50 }));
+      std::vector<int> remap = mergedGen.mergeDuplicatePoints();
+      REQUIRE(remap[5] == 4);
+
+      mergedGen.Tesselate();
+      REQUIRE(mergedGen.triangleCount() == 2);
+
+      // the diagonals cross at (5, 5), the added point is weighted 0 and thus not redundant
+      squareInput.pop_back();
+      Delaunay crossingGen(squareInput);
+      REQUIRE(crossingGen.setPointWeights({ 0, 0, 0, 0, -100 }));
+      crossingGen.setSegmentConstraint(std::vector<int>{ 0, 2, 1, 3 });
+      REQUIRE(crossingGen.resolveSegmentIntersections().addedPoints.size() == 1);
+
+      crossingGen.setSegmentConstraint(std::vector<Delaunay::Point>());
+      crossingGen.Tesselate();
+      REQUIRE(crossingGen.triangleCount() == 4);
+   }
+}
+
+
+TEST_CASE("Lloyd relaxation", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(500, 46);
+
+   Delaunay::Point minCorner(0, 0);
+   Delaunay::Point maxCorner(100, 100);
+
+   SECTION("TEST 33.1: the energy decreases, the mesh stays Delaunay")
+   {
+      Delaunay triGen(delaunayInput);
+      triGen.Triangulate();
+
+      auto stats = triGen.lloyd(20, minCorner, maxCorner);
+      REQUIRE(stats.size() == 20);
+
+      int rebuilds = 0;
+      for (size_t i = 0; i < stats.size(); ++i)
+      {
+         REQUIRE(stats[i].maxMove >= stats[i].meanMove);
+         if (i > 0)
+         {
+            REQUIRE(stats[i].energy <= stats[i - 1].energy * (1 + 1e-12));
+         }
+         rebuilds += stats[i].rebuilt ? 1 : 0;
+      }
+      REQUIRE(stats.back().maxMove < stats.front().maxMove);
+      REQUIRE(rebuilds < (int)stats.size());
+
+      // the moved points, all inside of the bounds, are triangulated like from scratch
+      std::vector<Delaunay::Point> moved;
+      for (size_t i = 0; i < delaunayInput.size(); ++i)
+      {
+         const Delaunay::Point& p = triGen.pointAtVertexId((int)i);
+         REQUIRE(p[0] >= 0);
+         REQUIRE(p[0] <= 100);
+         REQUIRE(p[1] >= 0);
+         REQUIRE(p[1] <= 100);
+         moved.push_back(p);
+      }
+
+      Delaunay freshGen(moved);
+      freshGen.Triangulate();
+
+      REQUIRE(triGen.triangleCount() == freshGen.triangleCount());
+      REQUIRE(sortedTriangles(triGen) == sortedTriangles(freshGen));
+
+      // the energy of the last move is reported by the next iteration
+      auto next = freshGen.lloyd(1, minCorner, maxCorner);
+      auto more = triGen.lloyd(1, minCorner, maxCorner);
+      REQUIRE(more.size() == 1);
+      REQUIRE(more[0].energy == Approx(next[0].energy));
+      REQUIRE(more[0].energy <= stats.back().energy);
+   }
+
+   SECTION("TEST 33.2: tolerance and threads")
+   {
+      Delaunay triGen(delaunayInput);
+      auto stats = triGen.lloyd(1000, minCorner, maxCorner, 0.01);
+
+      REQUIRE(!stats.empty());
+      REQUIRE(stats.size() < 1000);
+      REQUIRE(stats.back().maxMove <= 0.01);
+
+      for (size_t i = 0; i + 1 < stats.size(); ++i)
+      {
+         REQUIRE(stats[i].maxMove > 0.01);
+      }
+
+      // the same with one thread
+      Delaunay serialGen(delaunayInput);
+      serialGen.setThreadCount(1);
+      auto serialStats = serialGen.lloyd(1000, minCorner, maxCorner, 0.01);
+
+      REQUIRE(serialStats.size() == stats.size());
+      REQUIRE(serialStats.back().energy == stats.back().energy);
+      REQUIRE(sortedTriangles(serialGen) == sortedTriangles(triGen));
+
+      for (size_t i = 0; i < delaunayInput.size(); ++i)
+      {
+         REQUIRE(serialGen.pointAtVertexId((int)i)[0] == triGen.pointAtVertexId((int)i)[0]);
+         REQUIRE(serialGen.pointAtVertexId((int)i)[1] == triGen.pointAtVertexId((int)i)[1]);
+      }
+   }
+
+   SECTION("TEST 33.3: invalid input")
+   {
+      Delaunay triGen(delaunayInput);
+      REQUIRE(triGen.setVoronoiClipRegion(Delaunay::Point(0, 0), Delaunay::Point(50, 50)));
+
+      // bounds not convex
+      std::vector<Delaunay::Point> notConvex = { Delaunay::Point(0, 0), Delaunay::Point(100, 0), Delaunay::Point(50, 10), 
+                                                 Delaunay::Point(100, 100), Delaunay::Point(0, 100) };
+      REQUIRE(triGen.lloyd(5, notConvex).empty());
+
+      // with constraints
+      Delaunay constrainedGen(delaunayInput);
+      REQUIRE(constrainedGen.setSegmentConstraint(std::vector<int>{ 0, 1 }));
+      REQUIRE(constrainedGen.lloyd(5, minCorner, maxCorner).empty());
+
+      // the user's clip region is kept
+      REQUIRE(triGen.lloyd(2, minCorner, maxCorner).size() == 2);
+
+      Delaunay::VoronoiCells cells = triGen.voronoiCells();
+      double area = 0;
+      for (double cellArea : cells.areas)
+      {
+         area += cellArea;
+      }
+      REQUIRE(area == Approx(50 * 50));
+   }
+
+   SECTION("TEST 33.4: the edge counts follow the repaired hull")
+   {
+      RandomSequence random(461);
+
+      for (int run = 0; run < 20; ++run)
+      {
+         std::vector<Delaunay::Point> unitInput;
+         for (int i = 0; i < 300; ++i)
+         {
+            double x = random.next(1);
+            double y = random.next(1);
+            unitInput.push_back(Delaunay::Point(x, y));
+         }
+
+         Delaunay triGen(unitInput);
+         triGen.Triangulate();
+
+         auto stats = triGen.lloyd(5, Delaunay::Point(0, 0), Delaunay::Point(1, 1));
+         REQUIRE(stats.size() == 5);
+
+         std::set<std::pair<int, int>> edges;
+         for (FaceIterator fit = triGen.fbegin(); fit != triGen.fend(); ++fit)
+         {
+            int corners[3] = { fit.Org(), fit.Dest(), fit.Apex() };
+            for (int i = 0; i < 3; ++i)
+            {
+               edges.insert(std::minmax(corners[i], corners[(i + 1) % 3]));
+            }
+         }
+
+         REQUIRE(triGen.edgeCount() == (int)edges.size());
+         REQUIRE(triGen.voronoiEdges().size() == edges.size());
+         REQUIRE(triGen.voronoiEdgeCount() == (int)edges.size());
+      }
+   }
+}
+
+
+TEST_CASE("Voronoi arrays", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(300, 47);
+
+   SECTION("TEST 34.1: same as the iterators")
+   {
+      Delaunay trGenerator(delaunayInput);
+      trGenerator.Triangulate();
+
+      auto points = trGenerator.voronoiPoints();
+      auto edges = trGenerator.voronoiEdges();
+      auto rays = trGenerator.voronoiRays();
+
+      REQUIRE((int)points.size() == trGenerator.voronoiPointCount());
+      REQUIRE((int)edges.size() == trGenerator.voronoiEdgeCount());
+      REQUIRE(rays.size() == edges.size());
+      REQUIRE(trGenerator.voronoiEdgeSites().size() == edges.size());
+
+      size_t i = 0;
+      for (auto iter = trGenerator.vvbegin(); iter != trGenerator.vvend(); ++iter, ++i)
+      {
+         REQUIRE(*iter == points[i]);
+      }
+      REQUIRE(i == points.size());
+
+      i = 0;
+      for (auto iter = trGenerator.vebegin(); iter != trGenerator.veend(); ++iter, ++i)
+      {
+         Delaunay::Point normvec;
+         bool finite = false;
+
+         REQUIRE(iter.startPointId() == edges[i].start);
+         REQUIRE(iter.endPointId(normvec) == edges[i].end);
+         REQUIRE(normvec == rays[i]);
+         REQUIRE(iter.Org() == points[edges[i].start]);
+
+         Delaunay::Point dest = iter.Dest(finite);
+         REQUIRE(finite == (edges[i].end != -1));
+         REQUIRE(dest == (finite ? points[edges[i].end] : rays[i]));
+      }
+      REQUIRE(i == edges.size());
+
+      // spans of an empty instance
+      Delaunay emptyGenerator(delaunayInput);
+      REQUIRE(emptyGenerator.voronoiPoints().empty());
+      REQUIRE(emptyGenerator.voronoiEdges().empty());
+      REQUIRE(emptyGenerator.voronoiRays().begin() == emptyGenerator.voronoiRays().end());
+   }
+
+   SECTION("TEST 34.2: the edges separate their sites")
+   {
+      Delaunay trGenerator(delaunayInput);
+      trGenerator.Triangulate();
+
+      auto points = trGenerator.voronoiPoints();
+      auto edges = trGenerator.voronoiEdges();
+      auto rays = trGenerator.voronoiRays();
+      auto sites = trGenerator.voronoiEdgeSites();
+      int rayCount = 0;
+
+      for (size_t i = 0; i < edges.size(); ++i)
+      {
+         const Delaunay::Point& left = delaunayInput[sites[i].left];
+         const Delaunay::Point& right = delaunayInput[sites[i].right];
+         const Delaunay::Point& start = points[edges[i].start];
+
+         // on the bisector of the sites, which are on its two sides
+         REQUIRE(sites[i].left != sites[i].right);
+         REQUIRE(std::hypot(start[0] - left[0], start[1] - left[1]) == 
+                 Approx(std::hypot(start[0] - right[0], start[1] - right[1])));
+
+         Delaunay::Point dir = rays[i];
+         if (edges[i].end != -1)
+         {
+            dir = Delaunay::Point(points[edges[i].end][0] - start[0], points[edges[i].end][1] - start[1]);
+         }
+         else
+         {
+            ++rayCount;
+         }
+
+         double leftSide = dir[0] * (left[1] - start[1]) - dir[1] * (left[0] - start[0]);
+         double rightSide = dir[0] * (right[1] - start[1]) - dir[1] * (right[0] - start[0]);
+         REQUIRE(leftSide >= 0);
+         REQUIRE(rightSide <= 0);
+      }
+
+      // a ray per hull edge
+      REQUIRE(rayCount == trGenerator.hullSize());
+   }
+}
+
+
+TEST_CASE("Concurrent traversals", "[trpp]")
+{
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(2000, 48);
+
+   Delaunay trGenerator(delaunayInput);
+   trGenerator.Triangulate();
+
+   int faceCount = trGenerator.triangleCount();
+   int vertexCount = 0;
+   for (VertexIterator vit = trGenerator.vbegin(); vit != trGenerator.vend(); ++vit)
+   {
+      ++vertexCount;
+   }
+   REQUIRE(vertexCount > 0);
+
+   SECTION("TEST 35.1: nested iterators")
+   {
+      int outerFaces = 0;
+      int innerFaces = 0;
+      int innerVertices = 0;
+
+      for (FaceIterator fit = trGenerator.fbegin(); fit != trGenerator.fend(); ++fit)
+      {
+         if (outerFaces++ % 100 == 0)
+         {
+            for (FaceIterator inner = trGenerator.fbegin(); inner != trGenerator.fend(); ++inner)
+            {
+               ++innerFaces;
+            }
+            for (VertexIterator vit = trGenerator.vbegin(); vit != trGenerator.vend(); ++vit)
+            {
+               ++innerVertices;
+            }
+         }
+      }
+
+      int innerLoops = (faceCount + 99) / 100;
+      REQUIRE(outerFaces == faceCount);
+      REQUIRE(innerFaces == innerLoops * faceCount);
+      REQUIRE(innerVertices == innerLoops * vertexCount);
+
+      // a copy continues on its own
+      FaceIterator fit = trGenerator.fbegin();
+      ++fit;
+      FaceIterator copy = fit;
+      ++fit;
+      ++fit;
+      ++copy;
+      ++copy;
+      REQUIRE(copy == fit);
+
+      // internal traversals, e.g. in voronoiCells(), don't disturb the iterators either
+      int faces = 0;
+      for (FaceIterator it = trGenerator.fbegin(); it != trGenerator.fend(); ++it)
+      {
+         if (faces++ == 10)
+         {
+            REQUIRE(trGenerator.voronoiCells().cellCount() == (int)delaunayInput.size());
+         }
+      }
+      REQUIRE(faces == faceCount);
+   }
+
+   SECTION("TEST 35.2: iterating in several threads")
+   {
+      double serialArea = 0;
+      for (FaceIterator fit = trGenerator.fbegin(); fit != trGenerator.fend(); ++fit)
+      {
+         serialArea += fit.area();
+      }
+
+      const int threadCount = 4;
+      std::vector<int> faces(threadCount, 0);
+      std::vector<int> vertices(threadCount, 0);
+      std::vector<double> areas(threadCount, 0.0);
+      std::vector<std::thread> threads;
+
+      for (int t = 0; t < threadCount; ++t)
+      {
+         threads.emplace_back([&, t]()
+         {
+            for (int round = 0; round < 10; ++round)
+            {
+               for (FaceIterator fit = trGenerator.fbegin(); fit != trGenerator.fend(); ++fit)
+               {
+                  ++faces[t];
+                  areas[t] += fit.area();
+               }
+               for (VertexIterator vit = trGenerator.vbegin(); vit != trGenerator.vend(); ++vit)
+               {
+                  ++vertices[t];
+               }
+            }
+         });
+      }
+
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+
+      for (int t = 0; t < threadCount; ++t)
+      {
+         REQUIRE(faces[t] == 10 * faceCount);
+         REQUIRE(vertices[t] == 10 * vertexCount);
+         REQUIRE(areas[t] == Approx(10 * serialArea));
+      }
+   }
+
+   SECTION("TEST 35.3: range loops over several memory blocks")
+   {
+      // inlined loops must see the position written by operator++() (TriLib's blocks hold 4092 triangles)
+      RandomSequence random(481);
+
+      for (int i = 0; i < 20000; ++i)
+      {
+         double x = random.next(100, 100000);
+         double y = random.next(100, 100000);
+         delaunayInput.push_back(Delaunay::Point(x, y));
+      }
+
+      Delaunay blocksGenerator(delaunayInput);
+      blocksGenerator.Triangulate();
+
+      int faces = 0;
+      double area = 0;
+      for (const auto& f : blocksGenerator.faces())
+      {
+         ++faces;
+         area += f.area();
+      }
+
+      int vertices = 0;
+      for (const auto& v : blocksGenerator.vertices())
+      {
+         vertices += v.vertexId() >= 0 ? 1 : 0;
+      }
+
+      REQUIRE(faces == blocksGenerator.triangleCount());
+      REQUIRE(vertices == blocksGenerator.verticeCount());
+      REQUIRE(area > 0);
+   }
+}
+
+
+TEST_CASE("Parallel face and vertex loops", "[trpp]")
+{
+   auto cornersOf = [](const FaceIterator& fit)
+   {
+      int corners[3] = { fit.Org(), fit.Dest(), fit.Apex() };
+      std::rotate(corners, std::min_element(corners, corners + 3), corners + 3);
+      return std::make_tuple(corners[0], corners[1], corners[2]);
+   };
+
+   std::vector<Delaunay::Point> delaunayInput = makeRandomPoints(5000, 49);
+
+   // no duplicates, the serial VertexIterator doesn't skip all of them
+   std::sort(delaunayInput.begin(), delaunayInput.end(), [](const Delaunay::Point& p, const Delaunay::Point& q)
+   {
+      return p[0] < q[0] || (p[0] == q[0] && p[1] < q[1]);
+   });
+   delaunayInput.erase(std::unique(delaunayInput.begin(), delaunayInput.end()), delaunayInput.end());
+
+   Delaunay trGenerator(delaunayInput);
+   trGenerator.Triangulate();
+
+   SECTION("TEST 36.1: each face once")
+   {
+      std::vector<std::tuple<int, int, int>> serialFaces;
+      double serialArea = 0;
+
+      for (FaceIterator fit = trGenerator.fbegin(); fit != trGenerator.fend(); ++fit)
+      {
+         serialFaces.push_back(cornersOf(fit));
+         serialArea += fit.area();
+      }
+      std::sort(serialFaces.begin(), serialFaces.end());
+
+      for (int threads : { 1, 3, 8 })
+      {
+         std::vector<std::vector<std::tuple<int, int, int>>> faces(threads);
+         std::vector<double> areas(threads, 0.0);
+         std::atomic<int> invalidWorkers(0);
+
+         trGenerator.parallelForEachFace([&](const FaceIterator& face, int worker)
+         {
+            if (worker < 0 || worker >= threads)
+            {
+               ++invalidWorkers;
+               return;
+            }
+            faces[worker].push_back(cornersOf(face));
+            areas[worker] += face.area();
+         }, threads);
+
+         REQUIRE(invalidWorkers == 0);
+
+         std::vector<std::tuple<int, int, int>> allFaces;
+         double area = 0;
+         for (int worker = 0; worker < threads; ++worker)
+         {
+            allFaces.insert(allFaces.end(), faces[worker].begin(), faces[worker].end());
+            area += areas[worker];
+         }
+         std::sort(allFaces.begin(), allFaces.end());
+
+         REQUIRE(allFaces == serialFaces);
+         REQUIRE(area == Approx(serialArea));
+      }
+
+      // the passed iterators can't be advanced
+      int advanced = 0;
+      trGenerator.parallelForEachFace([&](const FaceIterator& face, int)
+      {
+         FaceIterator next = face;
+         if (++next != trGenerator.fend())
+         {
+            ++advanced;
+         }
+      }, 1);
+      REQUIRE(advanced == 0);
+   }
+
+   SECTION("TEST 36.2: each vertex once, none without a triangulation")
+   {
+      std::vector<int> serialIds;
+      for (VertexIterator vit = trGenerator.vbegin(); vit != trGenerator.vend(); ++vit)
+      {
+         serialIds.push_back(vit.vertexId());
+      }
+      std::sort(serialIds.begin(), serialIds.end());
+
+      const int threads = 4;
+      std::vector<std::vector<int>> ids(threads);
+
+      trGenerator.parallelForEachVertex([&](const VertexIterator& vertex, int worker)
+      {
+         ids[worker].push_back(vertex.vertexId());
+      }, threads);
+
+      std::vector<int> allIds;
+      for (const auto& workerIds : ids)
+      {
+         allIds.insert(allIds.end(), workerIds.begin(), workerIds.end());
+      }
+      std::sort(allIds.begin(), allIds.end());
+
+      REQUIRE(allIds == serialIds);
+
+      Delaunay emptyGenerator(delaunayInput);
+      int calls = 0;
+      emptyGenerator.parallelForEachFace([&](const FaceIterator&, int) { ++calls; });
+      emptyGenerator.parallelForEachVertex([&](const VertexIterator&, int) { ++calls; });
+      REQUIRE(calls == 0);
+   }
+}
+
+
+TEST_CASE("Bulk mesh export", "[trpp]")
+{
+   // a square with an inner point, refined with quality constraints, i.e. with Steiner points
+   std::vector<Delaunay::Point> delaunayInput = 
+      { { 0, 0 }, { 10, 0 }, { 10, 10 }, { 0, 10 }, { 5, 5 } };
+
+   Delaunay trGenerator(delaunayInput);
+   trGenerator.setSegmentConstraint(std::vector<int>{ 0, 1, 1, 2, 2, 3, 3, 0 });
+   trGenerator.setMaxArea(0.5);
+   trGenerator.Triangulate(true);
+
+   const int vertexCount = trGenerator.verticeCount();
+   const int triangleCount = trGenerator.triangleCount();
+
+   REQUIRE(vertexCount > (int)delaunayInput.size());
+
+   std::vector<double> points(2 * vertexCount);
+   std::vector<int32_t> triangles(3 * triangleCount);
+   std::vector<int32_t> markers(vertexCount, -1);
+   std::vector<int32_t> inputIndexes(vertexCount, -2);
+
+   Delaunay::MeshBuffers buffers;
+   buffers.points = points.data();
+   buffers.triangles = triangles.data();
+   buffers.markers = markers.data();
+   buffers.inputIndexes = inputIndexes.data();
+   buffers.vertexCapacity = vertexCount;
+   buffers.triangleCapacity = triangleCount;
+
+   auto cornersOf = [](Delaunay::Point corners[3])
+   {
+      std::vector<std::pair<double, double>> ret;
+      for (int i = 0; i < 3; ++i)
+      {
+         ret.push_back({ corners[i][0], corners[i][1] });
+      }
+      std::rotate(ret.begin(), std::min_element(ret.begin(), ret.end()), ret.end());
+      return ret;
+   };
+
+   SECTION("TEST 37.1: same mesh as with the iterators")
+   {
+      std::vector<std::vector<std::pair<double, double>>> iteratedFaces;
+      for (FaceIterator fit = trGenerator.fbegin(); fit != trGenerator.fend(); ++fit)
+      {
+         Delaunay::Point corners[3];
+         fit.Org(&corners[0]);
+         fit.Dest(&corners[1]);
+         fit.Apex(&corners[2]);
+         iteratedFaces.push_back(cornersOf(corners));
+      }
+      std::sort(iteratedFaces.begin(), iteratedFaces.end());
+
+      for (int threads : { 1, 4 })
+      {
+         trGenerator.setThreadCount(threads);
+
+         REQUIRE(trGenerator.exportMesh(buffers));
+         REQUIRE(buffers.vertexCount == vertexCount);
+         REQUIRE(buffers.triangleCount == triangleCount);
+
+         std::vector<std::vector<std::pair<double, double>>> exportedFaces;
+         for (int t = 0; t < triangleCount; ++t)
+         {
+            Delaunay::Point corners[3];
+            for (int i = 0; i < 3; ++i)
+            {
+               int v = triangles[3 * t + i];
+               REQUIRE((v >= 0 && v < vertexCount));
+               corners[i] = Delaunay::Point(points[2 * v], points[2 * v + 1]);
+            }
+            exportedFaces.push_back(cornersOf(corners));
+         }
+         std::sort(exportedFaces.begin(), exportedFaces.end());
+
+         REQUIRE(exportedFaces == iteratedFaces);
+      }
+   }
+
+   SECTION("TEST 37.2: input indexes and markers")
+   {
+      REQUIRE(trGenerator.exportMesh(buffers));
+
+      for (int v = 0; v < vertexCount; ++v)
+      {
+         if (v < (int)delaunayInput.size())
+         {
+            REQUIRE(inputIndexes[v] == v);
+            REQUIRE(points[2 * v] == delaunayInput[v][0]);
+            REQUIRE(points[2 * v + 1] == delaunayInput[v][1]);
+         }
+         else
+         {
+            REQUIRE(inputIndexes[v] == -1);
+         }
+
+         // on the square's segments, or inside
+         double x = points[2 * v];
+         double y = points[2 * v + 1];
+         bool onBoundary = x == 0 || x == 10 || y == 0 || y == 10;
+         REQUIRE(markers[v] == (onBoundary ? 1 : 0));
+      }
+
+      REQUIRE(markers[4] == 0);
+
+      // the optional buffers can be left out
+      buffers.markers = nullptr;
+      buffers.inputIndexes = nullptr;
+      REQUIRE(trGenerator.exportMesh(buffers));
+   }
+
+   SECTION("TEST 37.3: too small buffers, no triangulation")
+   {
+      buffers.triangleCapacity = triangleCount - 1;
+      REQUIRE(!trGenerator.exportMesh(buffers));
+      REQUIRE(buffers.triangleCount == 0);
+
+      Delaunay emptyGenerator(delaunayInput);
+      buffers.triangleCapacity = triangleCount;
+      REQUIRE(!emptyGenerator.exportMesh(buffers));
+   }
+}
+
+
 TEST_CASE("regions and region-local constraints", "[trpp]")
 {
    // prepare input 